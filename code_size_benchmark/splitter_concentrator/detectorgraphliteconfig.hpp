@@ -44,6 +44,7 @@ enum DetectorGraphConfigEnum
     kMaxNumberOfOutEdges = 20,
     kMaxNumberOfInEdges = 20,
     kMaxNumberOfTopicStates = 1,
+    kMaxPendingInputsPerTopicState = 1,
     // TODO(DGRAPH-57): Using 0 for the two configs below causes a warning.
     kMaxNumberOfTimeouts = 1,
     kMaxNumberOfPeriodicTimers = 1,
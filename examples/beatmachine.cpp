@@ -228,9 +228,8 @@ public:
 
             if (minIt->first == mMetronomeId)
             {
+                // Re-arms the metronome for the next due beat.
                 MetronomeFired();
-                SetTimeout(mMetronomeTimerPeriod, mMetronomeId);
-                Start(mMetronomeId);
             }
             else
             {
@@ -261,11 +260,13 @@ protected:
     }
     void Start(const TimeoutPublisherHandle aTimerId) { }
     void Cancel(const TimeoutPublisherHandle aTimerId) { mTimerMap.erase(aTimerId); }
-    void StartMetronome(const TimeOffset aPeriodInMilliseconds)
+    void ArmMetronome(const TimeOffset aMillisecondsFromNow)
     {
-        mMetronomeId = GetUniqueTimerHandle();
-        mMetronomeTimerPeriod = aPeriodInMilliseconds;
-        SetTimeout(mMetronomeTimerPeriod, mMetronomeId);
+        if (mMetronomeId == kInvalidTimeoutPublisherHandle)
+        {
+            mMetronomeId = GetUniqueTimerHandle();
+        }
+        SetTimeout(aMillisecondsFromNow, mMetronomeId);
         Start(mMetronomeId);
     }
     void CancelMetronome() { Cancel(mMetronomeId); }
@@ -283,7 +284,6 @@ private:
 private:
     std::map<TimeoutPublisherHandle, TimeOffset> mTimerMap;
     TimeoutPublisherHandle mMetronomeId;
-    TimeOffset mMetronomeTimerPeriod;
 };
 
 struct RhytmBeats : public DetectorGraph::TopicState
@@ -98,7 +98,8 @@ digraph GraphAnalyzer {
 
  * `ResumeSnapshot` is then used to construct a `ResumeFromSnapshotTopicState`
  * which is then posted to the graph to allow Detectors to resume/initialize
- * their state.
+ * their state. It's built once as a `ptr::shared_ptr<const StateSnapshot>`
+ * so all resuming Detectors read that same instance instead of copies.
  @snippetlineno resuminggraph.cpp Evaluate-ResumeFromSnapshot
 
  * From then on `mStateStore` in `ResumingGraph` is continually updated
@@ -189,7 +190,7 @@ public:
     //![Evaluate-ResumeFromSnapshot]
     void Evaluate(const DetectorGraph::ResumeFromSnapshotTopicState& aResumeFrom)
     {
-        const auto previousEventCount = aResumeFrom.snapshot.GetState<EventCount>();
+        const auto previousEventCount = aResumeFrom.snapshot->GetState<EventCount>();
         if (previousEventCount)
         {
             mEventCount = *previousEventCount;
@@ -215,7 +216,7 @@ private:
 class ResumingGraph : public DetectorGraph::ProcessorContainer
 {
 public:
-    ResumingGraph(const DetectorGraph::StateSnapshot& aInitialSnapshot)
+    ResumingGraph(const ptr::shared_ptr<const DetectorGraph::StateSnapshot>& aInitialSnapshot)
     : mResumingCountDetector(&mGraph)
     {
         ProcessData(DetectorGraph::ResumeFromSnapshotTopicState(aInitialSnapshot));
@@ -283,7 +284,7 @@ void WriteSnapshot(const DetectorGraph::StateSnapshot& aSnapshot)
 //![Serialization]
 
 //![Deserialization]
-DetectorGraph::StateSnapshot ReadSnapshot(const DetectorGraph::StateSnapshot& primeSnapshot)
+ptr::shared_ptr<const DetectorGraph::StateSnapshot> ReadSnapshot(const DetectorGraph::StateSnapshot& primeSnapshot)
 {
     std::list< ptr::shared_ptr<const DetectorGraph::TopicState> > topicStatesList;
 
@@ -300,7 +301,8 @@ DetectorGraph::StateSnapshot ReadSnapshot(const DetectorGraph::StateSnapshot& pr
         // ... add deserialization of any other TopicStates of interest.
     }
 
-    return DetectorGraph::StateSnapshot(primeSnapshot, topicStatesList);
+    return ptr::shared_ptr<const DetectorGraph::StateSnapshot>(
+        new DetectorGraph::StateSnapshot(primeSnapshot, topicStatesList));
 }
 //![Deserialization]
 
@@ -308,7 +310,7 @@ DetectorGraph::StateSnapshot ReadSnapshot(const DetectorGraph::StateSnapshot& pr
 int main()
 {
     DetectorGraph::StateSnapshot primeSnapshot = GetPrimeSnapshot();
-    DetectorGraph::StateSnapshot resumeSnapshot = ReadSnapshot(primeSnapshot);
+    const auto resumeSnapshot = ReadSnapshot(primeSnapshot);
 
     ResumingGraph resumingGraph = ResumingGraph(resumeSnapshot);
     for (int i = 0; i < 7; ++i)
@@ -68,6 +68,10 @@ using std::endl;
  * That then enables things like:
  @snippetlineno trivialvendingmachine.cpp Inspecting Graph Output with Named TopicStates
  *
+ * Ending the enumeration with a `kNumberOfTopicStateIds` bound also lets
+ * [GraphStateStore](@ref DetectorGraph::GraphStateStore) keep its snapshots
+ * in a flat array indexed by TopicStateId (see `VendingMachine`'s constructor).
+ *
  * @section ex-tvm-dga GraphAnalyzer
  * Finally, this example also shows how to use DetectorGraph::GraphAnalyzer to
  * generate a GraphViz-compatible `.dot` representation of the graph:
@@ -110,7 +114,8 @@ struct BuyButtonClicked : public DetectorGraph::TopicState
 //![Application-Specific Enum for Named TopicStates]
 enum class VendingMachineTopicStateIds{
     kSaleCompleted = 0,
-    kBalance
+    kBalance,
+    kNumberOfTopicStateIds
 };
 //![Application-Specific Enum for Named TopicStates]
 
@@ -187,7 +192,8 @@ public:
     : mSaleDetector(&mGraph)
     , mSaleTopic(mGraph.ResolveTopic<SaleCompleted>())
     , mBalanceTopic(mGraph.ResolveTopic<Balance>())
-    , mStateStore()
+    , mStateStore(static_cast<size_t>(
+        VendingMachineTopicStateIds::kNumberOfTopicStateIds))
     {
     }
 
@@ -201,10 +207,10 @@ public:
     {
         // Now we can iterate exclusively through newly updated TopicStates
         // instead of checking through every Topic of interest.
-        for (const auto topicState : mGraph.GetOutputList())
+        for (const DetectorGraph::TopicState& topicState : mGraph.GetOutputView())
         {
             switch(static_cast<VendingMachineTopicStateIds>(
-                topicState->GetId()))
+                topicState.GetId()))
             {
                 case VendingMachineTopicStateIds::kSaleCompleted:
                     cout << "Sale Made" << endl;
@@ -212,13 +218,16 @@ public:
 
                 case VendingMachineTopicStateIds::kBalance:
                 {
-                    const std::shared_ptr<const Balance> balance =
-                        std::static_pointer_cast<const Balance>(topicState);
+                    const Balance& balance =
+                        static_cast<const Balance&>(topicState);
 
-                    cout << "Balance: " << balance->numberOfCoins;
+                    cout << "Balance: " << balance.numberOfCoins;
                     cout << " coins" << endl;
                 }
                 break;
+
+                case VendingMachineTopicStateIds::kNumberOfTopicStateIds:
+                break;
             }
         }
 
@@ -0,0 +1,222 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DETECTORGRAPH_INCLUDE_CONCURRENTINPUTQUEUE_HPP_
+#define DETECTORGRAPH_INCLUDE_CONCURRENTINPUTQUEUE_HPP_
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT)
+
+#include "inputqueuepolicy.hpp"
+#include "errortype.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace DetectorGraph
+{
+
+class Graph;
+
+/**
+ * @brief _Internal_ - Bounded lock-free queue of inputs pushed from other
+ * threads (see Graph::PushDataFromAnyThread)
+ *
+ * Any number of threads may Enqueue() concurrently; a single thread (the
+ * one evaluating the Graph) consumes. Producers claim a cell with a single
+ * CAS and never block or wait on each other or on the consumer (this is the
+ * bounded MPMC queue by D. Vyukov, with a simplified single consumer).
+ *
+ * Each cell holds a type-erased Record; records up to kInlineRecordSize
+ * bytes are constructed inside the cell, larger ones are heap-allocated by
+ * the producer.
+ *
+ * The consumer may block on WaitUntilNotEmpty(); producers only touch the
+ * mutex to wake it when it's actually waiting. Likewise, with kBlockProducer
+ * producers that find the queue full wait for the consumer, which only
+ * touches their mutex when some are waiting.
+ *
+ * Requires C++11 and is only available when
+ * BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT is defined.
+ */
+class ConcurrentInputQueue
+{
+public:
+    /**
+     * @brief A pending input waiting to be dispatched into the graph.
+     */
+    class Record
+    {
+    public:
+        virtual ~Record() {}
+
+        /**
+         * @brief Moves the input into \p aGraph's input queue (creating its
+         * Topic if needed); called on the consumer thread before the Graph
+         * is sorted for the evaluation.
+         */
+        virtual ErrorType Transfer(Graph& aGraph) = 0;
+    };
+
+    enum { kInlineRecordSize = 64 };
+
+    /**
+     * @brief Creates a queue for up to \p aCapacity pending inputs (rounded
+     * up to a power of two).
+     *
+     * \p aPolicy must be kRejectNewInput, kDropNewestInput or
+     * kBlockProducer.
+     */
+    ConcurrentInputQueue(unsigned aCapacity, InputOverflowPolicy aPolicy);
+
+    /**
+     * @brief Destroys all pending records without dispatching them.
+     */
+    ~ConcurrentInputQueue();
+
+    size_t GetCapacity() const;
+
+    /**
+     * @brief Constructs a TRecord from \p aArgs at the back of the queue
+     *
+     * Thread-safe & lock-free (unless waiting with kBlockProducer). If the
+     * queue is full nothing is constructed and it returns
+     * ErrorType_NoResource with kRejectNewInput.
+     */
+    template<class TRecord, typename... TArgs>
+    ErrorType Enqueue(TArgs&&... aArgs)
+    {
+        Cell* cell = ClaimCell();
+        if (cell == NULL)
+        {
+            cell = HandleOverflow();
+            if (cell == NULL)
+            {
+                return (mOverflowPolicy == kDropNewestInput) ? ErrorType_Success : ErrorType_NoResource;
+            }
+        }
+
+        cell->record = NewRecord<TRecord>(
+            cell, std::integral_constant<bool, sizeof(TRecord) <= kInlineRecordSize>(),
+            std::forward<TArgs>(aArgs)...);
+
+        PublishCell(cell);
+        return ErrorType_Success;
+    }
+
+    /**
+     * @brief Returns the oldest record or NULL if the queue is empty
+     *
+     * Consumer thread only.
+     */
+    Record* Front();
+
+    /**
+     * @brief Transfers the oldest record into \p aGraph and frees its cell
+     *
+     * Consumer thread only; the queue must not be empty. If the Graph
+     * rejects the input (ErrorType_NoResource) the record is kept at the
+     * front.
+     */
+    ErrorType TransferFront(Graph& aGraph);
+
+    /**
+     * @brief Consumer thread only.
+     */
+    bool IsEmpty();
+
+    /**
+     * @brief Blocks the consumer until the queue is not empty or
+     * \p aTimeoutMs elapse. Returns true if the queue is not empty.
+     */
+    bool WaitUntilNotEmpty(unsigned aTimeoutMs);
+
+    /**
+     * @brief Consumer thread only.
+     */
+    InputQueueStats GetStats() const;
+
+    /**
+     * @brief Consumer thread only.
+     */
+    void ResetStats();
+
+private:
+    // Not copyable.
+    ConcurrentInputQueue(const ConcurrentInputQueue&);
+    ConcurrentInputQueue& operator=(const ConcurrentInputQueue&);
+
+    struct Cell
+    {
+        /**
+         * @brief Position (in the queue's lifetime) this cell is ready for:
+         * == p when free for the producer of position p and == p + 1 once
+         * that producer has filled it.
+         */
+        std::atomic<size_t> sequence;
+        Record* record;
+        alignas(std::max_align_t) unsigned char storage[kInlineRecordSize];
+    };
+
+    template<class TRecord, typename... TArgs>
+    static Record* NewRecord(Cell* aCell, std::true_type /* fits inline */, TArgs&&... aArgs)
+    {
+        return new(aCell->storage) TRecord(std::forward<TArgs>(aArgs)...);
+    }
+
+    template<class TRecord, typename... TArgs>
+    static Record* NewRecord(Cell*, std::false_type /* fits inline */, TArgs&&... aArgs)
+    {
+        return new TRecord(std::forward<TArgs>(aArgs)...);
+    }
+
+    Cell* ClaimCell();
+    Cell* HandleOverflow();
+    void PublishCell(Cell* aCell);
+    void ReleaseFront();
+
+    std::vector<Cell> mCells;
+    const size_t mMask;
+
+    // Keeps the producers' and the consumer's positions on separate cache
+    // lines.
+    char mPadding0[64];
+    std::atomic<size_t> mEnqueuePosition;
+    char mPadding1[64];
+    size_t mDequeuePosition;
+
+    std::atomic<bool> mConsumerWaiting;
+    std::mutex mWaitMutex;
+    std::condition_variable mNotEmpty;
+
+    const InputOverflowPolicy mOverflowPolicy;
+    std::atomic<unsigned> mNumBlockedProducers;
+    std::mutex mBlockedProducersMutex;
+    std::condition_variable mNotFull;
+
+    std::atomic<unsigned long> mNumDropped;
+    std::atomic<unsigned long> mNumRejected;
+    size_t mHighWaterMark;
+};
+
+}
+
+#endif
+
+#endif // DETECTORGRAPH_INCLUDE_CONCURRENTINPUTQUEUE_HPP_
@@ -0,0 +1,90 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DETECTORGRAPH_INCLUDE_EVALUATIONWORKERPOOL_HPP_
+#define DETECTORGRAPH_INCLUDE_EVALUATIONWORKERPOOL_HPP_
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DetectorGraph
+{
+
+/**
+ * @brief A fixed set of threads that run batches of jobs for a Graph.
+ *
+ * Used by Graph to evaluate independent Detectors concurrently (see
+ * Graph::SetParallelEvaluation). A batch is a number of calls to the same
+ * function with different job indices; the calling thread takes jobs too and
+ * Run() only returns once all of them have completed.
+ *
+ * Requires C++11 and is only available when
+ * BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION is defined.
+ */
+class EvaluationWorkerPool
+{
+public:
+    typedef void (*Job)(void* aContext, unsigned aJobIndex);
+
+    /**
+     * @brief Starts \p aNumWorkers threads in addition to the caller's.
+     */
+    explicit EvaluationWorkerPool(unsigned aNumWorkers);
+
+    /**
+     * @brief Stops and joins all worker threads.
+     */
+    ~EvaluationWorkerPool();
+
+    unsigned GetNumWorkers() const;
+
+    /**
+     * @brief Calls \p aJob(aContext, i) for every i in [0, aNumJobs).
+     *
+     * Jobs may run in any order and on any thread. Not reentrant.
+     */
+    void Run(Job aJob, void* aContext, unsigned aNumJobs);
+
+private:
+    void WorkerLoop();
+    bool RunNextJob(Job aJob, void* aContext, unsigned aNumJobs);
+
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mMutex;
+    std::condition_variable mBatchStarted;
+    std::condition_variable mBatchDone;
+
+    // Guarded by mMutex
+    Job mJob;
+    void* mContext;
+    unsigned mNumJobs;
+    unsigned mPendingJobs;
+    unsigned mActiveWorkers;
+    unsigned long mBatchNumber;
+    bool mShutdown;
+
+    std::atomic<unsigned> mNextJob;
+};
+
+}
+
+#endif
+
+#endif // DETECTORGRAPH_INCLUDE_EVALUATIONWORKERPOOL_HPP_
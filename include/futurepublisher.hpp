@@ -80,6 +80,29 @@ public:
         mGraph->PushData<T>(aData);
     }
 
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+    /**
+     * @brief Publish a new version of T to the Graph for future evaluation
+     * by moving it in.
+     */
+    void PublishOnFutureEvaluation(T&& aData)
+    {
+        DG_ASSERT(mGraph);
+        mGraph->PushData<T>(std::move(aData));
+    }
+
+    /**
+     * @brief Publish a new version of T, constructed in place from \p aArgs,
+     * to the Graph for future evaluation.
+     */
+    template<typename... TArgs>
+    void PublishOnFutureEvaluationInPlace(TArgs&&... aArgs)
+    {
+        DG_ASSERT(mGraph);
+        mGraph->PushDataInPlace<T>(std::forward<TArgs>(aArgs)...);
+    }
+#endif
+
 protected:
     Graph* mGraph;
 };
@@ -36,7 +36,12 @@
 #else
 // FULL_BEGIN
 #include "sharedptr.hpp"
+#include "outputview.hpp"
+#include "evaluationworkerpool.hpp"
+#include "workstealingexecutor.hpp"
+#include "concurrentinputqueue.hpp"
 #include <list>
+#include <vector>
 #include <typeinfo>
 #include <limits>
 #include <stdint.h>
@@ -107,7 +112,7 @@ public:
  * Graph:
  * - Owns all vertices (Topics and Detectors)
  * - Provides the data input API (@ref PushData<T>) (into topics)
- * - Provides the data output API (@ref GetOutputList) (from topics)
+ * - Provides the data output API (@ref GetOutputView & @ref GetOutputList) (from topics)
  * - Provides an API for graph evaluation (@ref EvaluateGraph)
  * - Maintains the Graph's topological sort across graph changes topology changes
  * - Creates Topics as needed to satisfy all Detector's dependencies
@@ -116,8 +121,8 @@ public:
  * - External events/messages/inputs are translated into TopicStates and
  * passed to PushData().
  * - EvaluateGraph() running in an event loop until HasDataPending() is false.
- * - After each call to EvaluateGraph() the list in GetOutputList() is
- * inspected for TopicStates of interest that must be passed onwards to the
+ * - After each call to EvaluateGraph() the TopicStates in GetOutputView()
+ * are inspected for those of interest that must be passed onwards to the
  * outside.
  *
  *
@@ -183,14 +188,47 @@ public:
      * This method is used to input data into the graph and
      * it's the only API to do so.
      *
+     * On the Full config it returns ErrorType_NoResource if the input queue
+     * is full and its policy is kRejectNewInput (see SetInputQueueCapacity).
      */
-    template<class TTopicState> void PushData(const TTopicState& aTopicState)
+    template<class TTopicState> ErrorType PushData(const TTopicState& aTopicState)
     {
-        mGraphInputQueue.Enqueue(*ResolveTopic<TTopicState>(), aTopicState);
+        return mGraphInputQueue.Enqueue(*ResolveTopic<TTopicState>(), aTopicState);
     }
 
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+    /**
+     * @brief Push data to a specific topic in the graph, moving it in
+     *
+     * Same as PushData(const TTopicState&) for rvalues; the TopicState is
+     * moved (not copied) all the way into its Topic.
+     */
+    template<class TTopicState> ErrorType PushData(TTopicState&& aTopicState)
+    {
+        typedef typename std::decay<TTopicState>::type TDecayedTopicState;
+        return mGraphInputQueue.Enqueue(*ResolveTopic<TDecayedTopicState>(), std::forward<TTopicState>(aTopicState));
+    }
+
+    /**
+     * @brief Push a TTopicState constructed in place from \p aArgs
+     *
+     * The TopicState is constructed directly in the input queue and then
+     * moved into its Topic on evaluation.
+     */
+    template<class TTopicState, typename... TArgs> ErrorType PushDataInPlace(TArgs&&... aArgs)
+    {
+        return mGraphInputQueue.Enqueue(*ResolveTopic<TTopicState>(), std::forward<TArgs>(aArgs)...);
+    }
+#endif
+
     /**
      * @brief Evaluate the whole graph
+     *
+     * Dispatches the next pending input and evaluates, in topological order,
+     * every Detector downstream of it that receives new data. On the Full
+     * config vertices that cannot be reached from the input are not visited
+     * at all, so the cost of an evaluation is proportional to the affected
+     * portion of the graph.
      */
     ErrorType EvaluateGraph();
 
@@ -225,12 +263,18 @@ public:
 
 private:
     /**
-     * @ brief Clears @ref VertexSearchState to kVertexClear on all vertices
+     * @brief Clears @ref VertexSearchState to kVertexClear on all vertices
+     *
+     * This advances the evaluation epoch all vertices are bound to, so it
+     * costs O(1) except for the one call in 2^32 where the epoch wraps around.
      */
     ErrorType ClearTraverseContexts();
 
     /**
      * @brief Traverse though vertices in the right order and perform computation
+     *
+     * On the Full config only vertices reachable from topics published in this
+     * evaluation are visited (see @ref ScheduleVertex).
      */
     ErrorType TraverseVertices();
 
@@ -238,6 +282,7 @@ private:
     TopicRegistry mTopicRegistry;
     GraphInputQueue mGraphInputQueue;
     VertexPtrContainer mVertices;
+    Vertex::EvaluationEpoch mEvaluationEpoch;
 
 
 #if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
@@ -257,33 +302,471 @@ private:
     // FULL_BEGIN
 
 public:
+    /**
+     * @brief Returns a view of the topicstates published in the last Evaluation.
+     *
+     * The view refers directly to the values held by the Topics that changed
+     * during the last call to \ref EvaluateGraph(), in topological order; it
+     * costs nothing to create and is valid only until the next evaluation.
+     */
+    OutputView GetOutputView() const;
+
     /**
      * @brief Returns the list of topicstates published in the last Evaluation.
      *
-     * It returns a list of references (valid only in between evaluations) to
-     * the topicstates that changed during the last call to \ref EvaluateGraph()
+     * Same contents as GetOutputView() but each topicstate is copied into a
+     * shared_ptr the caller can keep past the next evaluation. The copies are
+     * only made on the first call after each evaluation.
      */
     const std::list<ptr::shared_ptr<const TopicState> >& GetOutputList() const;
 
+    /**
+     * @brief Filters for SetOutputFilter()
+     */
+    enum OutputFilter
+    {
+        /** All published topicstates are output (the default). */
+        kOutputAllTopics,
+        /**
+         * Only topicstates with a public TopicStateId (i.e. not
+         * TopicState::kAnonymousTopicState) are output.
+         */
+        kOutputNamedTopicsOnly
+    };
+
+    /**
+     * @brief Selects which topicstates GetOutputView() & GetOutputList() return
+     *
+     * Applications that only pass Named TopicStates to the outside (e.g.
+     * through a GraphStateStore) can use kOutputNamedTopicsOnly to skip the
+     * graph's internal topicstates altogether.
+     */
+    void SetOutputFilter(OutputFilter aFilter);
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+    /**
+     * @brief Strategies for SetParallelEvaluation()
+     */
+    enum ParallelScheduling
+    {
+        /**
+         * Detectors are grouped into dependency levels (the longest path
+         * from the graph's inputs) and the Detectors with new data on each
+         * level run concurrently; a level starts once the previous one is
+         * done.
+         */
+        kLevelSynchronous,
+        /**
+         * Each Detector starts as soon as all of its inputs are settled, on
+         * whichever worker is free (see WorkStealingExecutor). Avoids
+         * waiting on the slowest Detector of each level.
+         */
+        kWorkStealing
+    };
+
+    /**
+     * @brief Evaluates independent Detectors concurrently
+     *
+     * Detectors run on \p aNumWorkerThreads threads in addition to the one
+     * calling EvaluateGraph(), scheduled according to \p aScheduling.
+     * Passing 0 (the default) goes back to evaluating all Detectors on the
+     * calling thread.
+     *
+     * Results are the same on every run: Detectors publishing to the same
+     * Topic, and all Detectors with future/timeout/periodic publishers, are
+     * always run one after the other in a fixed order, and the output list
+     * is still composed in order on the calling thread.
+     * Detectors must not share any other mutable state and must not throw
+     * from Evaluate().
+     */
+    void SetParallelEvaluation(unsigned aNumWorkerThreads, ParallelScheduling aScheduling = kLevelSynchronous);
+#endif
+
+    /**
+     * @brief Limits the number of inputs pending from PushData()
+     *
+     * By default the input queue grows as needed. With a \p aCapacity other
+     * than 0, inputs pushed while it's full (e.g. by a FuturePublisher or
+     * Lag feedback loop outpacing the evaluations) are handled according to
+     * \p aPolicy: kRejectNewInput, kDropNewestInput or kDropOldestInput.
+     * kBlockProducer would deadlock the graph's own thread and is treated
+     * as kRejectNewInput.
+     */
+    void SetInputQueueCapacity(size_t aCapacity, InputOverflowPolicy aPolicy = kRejectNewInput);
+
+    /**
+     * @brief Makes PushData() for TTopicState keep only the latest pending
+     * input
+     *
+     * For state-like TopicStates (e.g. a sensor reading) where only the
+     * newest value matters. While an input of TTopicState is pending, pushing
+     * another one overwrites it in place - keeping its position relative to
+     * inputs of other types - instead of costing an extra evaluation.
+     */
+    template<class TTopicState> void SetInputConflation(bool aEnabled)
+    {
+        mGraphInputQueue.SetConflation(ResolveTopic<TTopicState>(), aEnabled);
+    }
+
+    /**
+     * @brief Sets the priority class of PushData() inputs for TTopicState
+     *
+     * EvaluateGraph() always takes the next input from the highest priority
+     * class with inputs pending (0 by default), so e.g. an alarm doesn't wait
+     * behind a backlog of telemetry. Within a class, inputs pushed with
+     * PushDataWithDeadline() go first, earliest deadline first, followed by
+     * the others in the order they were pushed.
+     */
+    template<class TTopicState> void SetInputPriority(unsigned aPriority)
+    {
+        mGraphInputQueue.SetPriority(ResolveTopic<TTopicState>(), aPriority);
+    }
+
+    /**
+     * @brief Push data to be evaluated before any input in its priority
+     * class with a later (or no) deadline.
+     *
+     * @sa SetInputPriority
+     */
+    template<class TTopicState> ErrorType PushDataWithDeadline(const TTopicState& aTopicState, InputDeadline aDeadline)
+    {
+        return mGraphInputQueue.EnqueueWithDeadline(aDeadline, *ResolveTopic<TTopicState>(), aTopicState);
+    }
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+    template<class TTopicState> ErrorType PushDataWithDeadline(TTopicState&& aTopicState, InputDeadline aDeadline)
+    {
+        typedef typename std::decay<TTopicState>::type TDecayedTopicState;
+        return mGraphInputQueue.EnqueueWithDeadline(aDeadline, *ResolveTopic<TDecayedTopicState>(), std::forward<TTopicState>(aTopicState));
+    }
+#endif
+
+    /**
+     * @brief Returns the depth, high-water mark & overflow counters of the
+     * PushData() input queue.
+     */
+    InputQueueStats GetInputQueueStats() const;
+
+    /**
+     * @brief Resets the overflow counters and the high-water mark (to the
+     * current depth) of the input queues.
+     */
+    void ResetInputQueueStats();
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT)
+    /**
+     * @brief Enables PushDataFromAnyThread() with room for \p aCapacity
+     * pending inputs
+     *
+     * Must be called before any other thread starts pushing data. Passing 0
+     * disables it again (dropping any pending inputs).
+     *
+     * \p aPolicy decides what happens to inputs pushed while it's full:
+     * kRejectNewInput, kDropNewestInput or kBlockProducer (producers wait
+     * for the graph's thread to dispatch an input). The producers can't
+     * discard inputs the graph's thread may be dispatching, so
+     * kDropOldestInput isn't supported and behaves as kRejectNewInput.
+     */
+    void EnableConcurrentInput(unsigned aCapacity, InputOverflowPolicy aPolicy = kRejectNewInput);
+
+    /**
+     * @brief Returns the depth, high-water mark & overflow counters of the
+     * PushDataFromAnyThread() input queue.
+     *
+     * Must be called from the graph's thread. The high-water mark is sampled
+     * as inputs are dispatched.
+     */
+    InputQueueStats GetConcurrentInputQueueStats() const;
+
+    /**
+     * @brief Thread-safe version of PushData()
+     *
+     * Can be called from any number of threads at the same time as the
+     * graph is being evaluated; inputs are queued without locks and moved
+     * into the PushData() queue by EvaluateGraph() on the graph's thread,
+     * where their Topic's priority & conflation settings apply.
+     *
+     * Each evaluation moves at least one of them (so PushData() inputs -
+     * e.g. from a FuturePublisher republishing on every evaluation - can't
+     * starve other threads) and then more only while fewer than
+     * EnableConcurrentInput()'s capacity are pending, so producers still see
+     * its overflow policy when the graph falls behind. An input the
+     * PushData() queue rejects (see SetInputQueueCapacity) stays pending.
+     *
+     * Returns ErrorType_NoResource if the queue is full (and its policy is
+     * kRejectNewInput) and ErrorType_BadConfiguration if
+     * EnableConcurrentInput() wasn't called.
+     */
+    template<class TTopicState> ErrorType PushDataFromAnyThread(const TTopicState& aTopicState)
+    {
+        return EnqueueConcurrentInput<TTopicState>(aTopicState);
+    }
+
+    /**
+     * @brief Same as PushDataFromAnyThread(const TTopicState&) but moves
+     * rvalues into the queue.
+     */
+    template<class TTopicState> ErrorType PushDataFromAnyThread(TTopicState&& aTopicState)
+    {
+        typedef typename std::decay<TTopicState>::type TDecayedTopicState;
+        return EnqueueConcurrentInput<TDecayedTopicState>(std::forward<TTopicState>(aTopicState));
+    }
+
+    /**
+     * @brief Blocks until HasDataPending() or \p aTimeoutMs elapse
+     *
+     * Lets the graph's thread sleep while it waits for other threads'
+     * PushDataFromAnyThread(). Returns HasDataPending().
+     */
+    bool WaitForDataPending(unsigned aTimeoutMs);
+#endif
+
     /**
      * @brief Determine the right order to process the vertices by topological sort
+     *
+     * This always re-sorts the whole graph; EvaluateGraph() only does so
+     * when the incremental order maintenance can't be used.
+     *
+     * On success the sorted graph is also lowered into a flat execution plan
+     * (contiguous arrays of vertices and their out-edges) that
+     * EvaluateGraph() runs until the topology changes again.
      */
     ErrorType TopoSortGraph();
 
 private:
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT)
     /**
-     * @brief Pop data out of topics to the output list after evaluation
+     * @brief An input pushed through PushDataFromAnyThread()
      */
-    ErrorType ComposeOutputList();
+    template<class TTopicState>
+    class ConcurrentInput : public ConcurrentInputQueue::Record
+    {
+    public:
+        template<typename TArg>
+        explicit ConcurrentInput(TArg&& aTopicState)
+        : mData(std::forward<TArg>(aTopicState))
+        {
+        }
+
+        virtual ErrorType Transfer(Graph& aGraph)
+        {
+            return aGraph.mGraphInputQueue.Enqueue(*aGraph.ResolveTopic<TTopicState>(), std::move(mData));
+        }
 
+    private:
+        TTopicState mData;
+    };
+
+    template<class TTopicState, typename TArg> ErrorType EnqueueConcurrentInput(TArg&& aTopicState)
+    {
+        if (mConcurrentInputQueue == NULL)
+        {
+            return ErrorType_BadConfiguration;
+        }
+        return mConcurrentInputQueue->Enqueue< ConcurrentInput<TTopicState> >(std::forward<TArg>(aTopicState));
+    }
+
+    /**
+     * @brief Moves inputs from PushDataFromAnyThread() into mGraphInputQueue
+     *
+     * May create their Topics, so it must be done before sorting.
+     */
+    void TransferConcurrentInputs();
+#endif
+
+    /**
+     * @brief Prepares mPublishedTopics to back the output of the evaluation
+     *
+     * Puts the published Topics in topological order, applies the output
+     * filter and invalidates the previously materialized output list.
+     */
+    ErrorType ComposeOutputView();
+
+    /**
+     * @brief Recomputes mFilteredOutputTopics from mPublishedTopics
+     */
+    void ApplyOutputFilter();
+
+    /**
+     * @brief Topics backing GetOutputView() & GetOutputList()
+     */
+    const std::vector<BaseTopic*>& GetOutputTopics() const;
+
+    /**
+     * @brief Depth-First-Search used on topo-sorting
+     *
+     * Uses an explicit stack so arbitrarily deep graphs can't overflow the
+     * call stack. Appends vertices to \p postOrder as they finish.
+     */
+    ErrorType DFS_visit(Vertex* v, std::vector<Vertex*>& postOrder);
+
+    /**
+     * @brief Brings the topological sort and the plan up to date
+     *
+     * Vertices added since the last sort are merged into the existing order
+     * incrementally (see @ref InsertEdgeIntoOrder) unless they make up most
+     * of the graph, in which case a full TopoSortGraph() is cheaper.
+     */
+    ErrorType UpdateTopoSort();
+
+    /**
+     * @brief Merges the edges of all vertices added since the last sort into
+     * the topological order
+     */
+    ErrorType InsertPendingVertices();
+
+    /**
+     * @brief Restores the topological order after the edge \p aFrom ->
+     * \p aTo was added (Pearce-Kelly).
+     *
+     * Only vertices ordered in between the two ends of the edge and connected
+     * to them are visited and reordered.
+     */
+    ErrorType InsertEdgeIntoOrder(Vertex* aFrom, Vertex* aTo);
+
+    /**
+     * @brief Returns true if \p aVertex has a slot in the current order.
+     */
+    bool IsInPlan(const Vertex* aVertex) const;
+
+    /**
+     * @brief Drops the values of topics published on the previous evaluation.
+     *
+     * All other topics are known to be empty already, so this costs
+     * O(previously published) instead of O(V).
+     */
+    ErrorType ClearPublishedTopics();
+
+    /**
+     * @brief Lowers the sorted vertex list into the flat execution plan.
+     *
+     * Called by TopoSortGraph() so the plan is only rebuilt when the
+     * topology of the graph changes.
+     */
+    ErrorType CompilePlan();
+
+    /**
+     * @brief Adds a vertex (by its index in the plan) to the evaluation
+     * frontier.
+     *
+     * The frontier is a min-heap on plan indices, which are the vertices'
+     * topological order, so vertices are always visited in topological order
+     * regardless of the order in which they were scheduled.
+     */
+    void ScheduleVertex(unsigned aPlanIndex);
+
+    /**
+     * @brief Schedules the out-edges of a vertex that were marked for a visit.
+     */
+    void ScheduleOutEdges(unsigned aPlanIndex);
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
     /**
-     * @brief Recursive method used on Depth-First-Search used on topo-sorting
+     * @brief Version of TraverseVertices() that runs the Detectors on each
+     * dependency level in parallel.
      */
-    ErrorType DFS_visit(Vertex* v, VertexPtrContainer& sorted);
+    ErrorType TraverseVerticesInParallel();
+
+    /**
+     * @brief Runs all Detectors in mDetectorBatch on the worker pool.
+     */
+    void RunDetectorBatch();
+
+    /**
+     * @brief Computes mPlanLevels & mPlanGroups for the current plan.
+     */
+    void CompileParallelPlan();
+#endif
 
 private:
     bool mNeedsSorting;
-    std::list<ptr::shared_ptr<const TopicState> > mOutputList;
+    bool mNeedsCompiling;
+
+    /**
+     * @brief Copies of the last output, built on demand by GetOutputList().
+     */
+    mutable std::list<ptr::shared_ptr<const TopicState> > mOutputList;
+    mutable bool mOutputListStale;
+
+    /**
+     * @brief Vertices added since the last sort whose edges haven't been
+     * merged into the order yet.
+     */
+    std::vector<Vertex*> mPendingVertices;
+
+    /**
+     * @brief Vertices in topological order; the plan index of a vertex is
+     * its Vertex::GetTopoOrder().
+     *
+     * In between topology changes and the next CompilePlan() removed
+     * vertices leave NULL holes behind.
+     */
+    std::vector<Vertex*> mPlanVertices;
+
+    /**
+     * @brief Cached Vertex::GetVertexType() of each vertex in mPlanVertices.
+     */
+    std::vector<Vertex::VertexType> mPlanVertexTypes;
+
+    /**
+     * @brief Out-edges of the plan in Compressed Sparse Row form.
+     *
+     * The out-edges of vertex i are the plan indices in
+     * mPlanOutEdges[mPlanOutEdgeOffsets[i]] up to (excluding)
+     * mPlanOutEdges[mPlanOutEdgeOffsets[i+1]].
+     */
+    std::vector<unsigned> mPlanOutEdgeOffsets;
+    std::vector<unsigned> mPlanOutEdges;
+
+    /**
+     * @brief Plan indices of vertices pending a visit on the current
+     * evaluation.
+     */
+    std::vector<unsigned> mFrontier;
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+    EvaluationWorkerPool* mWorkerPool;
+    WorkStealingExecutor* mWorkStealingExecutor;
+
+    /**
+     * @brief Dependency level of each vertex in the plan.
+     *
+     * Vertices on the same level never share an edge.
+     */
+    std::vector<unsigned> mPlanLevels;
+
+    /**
+     * @brief Serialization group of each Detector in the plan.
+     *
+     * Detectors in the same group are never run concurrently.
+     */
+    std::vector<unsigned> mPlanGroups;
+
+    /**
+     * @brief Detectors of the current level waiting to be run.
+     */
+    std::vector<unsigned> mDetectorBatch;
+    std::vector<unsigned> mDetectorBatchTaskOffsets;
+#endif
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT)
+    ConcurrentInputQueue* mConcurrentInputQueue;
+#endif
+
+    /**
+     * @brief Topics published to during the last evaluation.
+     */
+    std::vector<BaseTopic*> mPublishedTopics;
+
+    OutputFilter mOutputFilter;
+
+    /**
+     * @brief Published Topics that passed mOutputFilter.
+     *
+     * Only used with kOutputNamedTopicsOnly; otherwise the output is
+     * mPublishedTopics itself.
+     */
+    std::vector<BaseTopic*> mFilteredOutputTopics;
     // FULL_END
 #endif
 };
@@ -28,6 +28,7 @@ class GraphInputDispatcherInterface
 public:
     virtual ~GraphInputDispatcherInterface() {}
     virtual void Dispatch() = 0;
+    virtual Vertex* GetTopicVertex() = 0;
 };
 /**
  * @brief _Internal_ - Push data to the graph
@@ -39,6 +40,26 @@ template<class T>
 class GraphInputDispatcher : public GraphInputDispatcherInterface
 {
 public:
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+    /**
+     * @brief Constructs the pending T from \p aArgs (copying, moving or
+     * building it in place as appropriate).
+     */
+    template<typename... TArgs>
+    GraphInputDispatcher(Topic<T>& aTopic, TArgs&&... aArgs)
+:   mTopic(aTopic)
+,   mData(std::forward<TArgs>(aArgs)...)
+    {
+    }
+
+    /**
+     * @brief Moves the pending T into the Topic; can only be called once.
+     */
+    void Dispatch()
+    {
+        mTopic.Publish(std::move(mData));
+    }
+#else
     GraphInputDispatcher(Topic<T>& aTopic, const T& aData)
 :   mTopic(aTopic)
 ,   mData(aData)
@@ -49,9 +70,19 @@ public:
     {
         mTopic.Publish(mData);
     }
+#endif
+
+    Vertex* GetTopicVertex()
+    {
+        return &mTopic;
+    }
 private:
     Topic<T>& mTopic;
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+    T mData;
+#else
     const T mData;
+#endif
 };
 
 } // namespace DetectorGraph
@@ -16,21 +16,27 @@
 #define DETECTORGRAPH_INCLUDE_GRAPHINPUTQUEUE_LITE_HPP_
 
 #include "graphinputdispatcher.hpp"
+#include "detectorgraphliteconfig.hpp"
 
 #include "dgassert.hpp"
+#include "errortype.hpp"
 
 namespace DetectorGraph
 {
 /**
  * @brief _Internal_ - Provides an bare-bones version of GraphInputQueue
+ *
+ * Each TopicState type gets a statically allocated ring of
+ * DetectorGraphConfig::kMaxPendingInputsPerTopicState nodes, so that many
+ * inputs of the same type can be pending at once without using the heap.
  */
 class GraphInputQueue
 {
 private:
     struct InputQueueNode
     {
-        InputQueueNode(uint8_t* aDispatcherStorage)
-        : dispatcherStorage(aDispatcherStorage), dispatcher(NULL)
+        InputQueueNode()
+        : dispatcherStorage(NULL), dispatcher(NULL)
         , next(NULL), busy(false)
         {
         }
@@ -44,36 +50,56 @@ private:
 public:
     GraphInputQueue() : mHeadNode(NULL), mTailNode(NULL) {}
 
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+    /**
+     * @brief Enqueues a TTopicState constructed from \p aArgs for \p aTopic.
+     */
+    template<class TTopicState, typename... TArgs>
+    ErrorType Enqueue(Topic<TTopicState>& aTopic, TArgs&&... aArgs)
+#else
     template<class TTopicState>
-    void Enqueue(Topic<TTopicState>& aTopic, const TTopicState& aTopicState)
+    ErrorType Enqueue(Topic<TTopicState>& aTopic, const TTopicState& aTopicState)
+#endif
     {
         InputQueueNode* node = GetQueueNode<TTopicState>();
 
         DG_ASSERT(!node->busy);
-        // WARNING: Give how we keep the storage of GraphInputDispatcher and
-        // nodes it's impossible to, for a given TTopicState, have two nodes
-        // enqueued at the same time. Here we're choosing to assert if we
-        // encounter this scenario. In practice this would happen if a
-        // TopicState is being FuturePublished faster than it's being consumed
-        // - and the only way to achieve that is by calling it twice for the
-        // same topic in a single evaluation pass or if two FuturePublished
-        // topics are competing for the next evaluation pass and they cause one
-        // another to be re-published - this is very contrived and deep.
+        // WARNING: Given how we keep the storage of GraphInputDispatcher and
+        // nodes it's impossible to, for a given TTopicState, have more than
+        // kMaxPendingInputsPerTopicState nodes enqueued at the same time.
+        // Here we're choosing to assert if we encounter this scenario. In
+        // practice this would happen if inputs of one type arrive in bursts
+        // larger than that or if a TopicState is being FuturePublished faster
+        // than it's being consumed - in which case the config needs bumping.
         //
         // In the weird world where the above is a problem we could clobber the
         // dispatcher with the new data and just not enqueue it. This is not
         // necessarily wrong but violates the current rules, would be
         // unnecessary complexity and would certainly hide graph design bugs.
 
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+        node->dispatcher =
+            new(node->dispatcherStorage) GraphInputDispatcher<TTopicState>(
+                aTopic, std::forward<TArgs>(aArgs)...);
+#else
         node->dispatcher =
             new(node->dispatcherStorage) GraphInputDispatcher<TTopicState>(
                 aTopic, aTopicState);
+#endif
 
         node->busy = true;
         EnqueueNode(node);
+
+        return ErrorType_Success;
     }
 
-    bool DequeueAndDispatch()
+    /**
+     * @brief Dispatches the oldest input into its topic.
+     *
+     * Returns the Topic that received the input or NULL if the queue was
+     * empty.
+     */
+    Vertex* DequeueAndDispatch()
     {
         InputQueueNode* nextNode = DequeueNode();
         if (nextNode)
@@ -85,11 +111,11 @@ public:
 
             nextNode->busy = false;
 
-            return true;
+            return nextInput->GetTopicVertex();
         }
         else
         {
-            return false;
+            return NULL;
         }
     }
 
@@ -147,9 +173,16 @@ private:
     template<class TTopicState>
     InputQueueNode* GetQueueNode()
     {
-        static uint8_t mInputDispatcherStorage[sizeof(GraphInputDispatcher<TTopicState>)];
-        static InputQueueNode node = InputQueueNode(mInputDispatcherStorage);
-        return &node;
+        static uint8_t mInputDispatcherStorage[DetectorGraphConfig::kMaxPendingInputsPerTopicState][sizeof(GraphInputDispatcher<TTopicState>)];
+        static InputQueueNode nodes[DetectorGraphConfig::kMaxPendingInputsPerTopicState];
+        static unsigned nextNode = 0;
+
+        // Inputs of the same type are dispatched in the order they were
+        // enqueued so nodes are also freed in ring order.
+        InputQueueNode* node = &nodes[nextNode];
+        node->dispatcherStorage = mInputDispatcherStorage[nextNode];
+        nextNode = (nextNode + 1) % DetectorGraphConfig::kMaxPendingInputsPerTopicState;
+        return node;
     }
 };
 
@@ -16,62 +16,723 @@
 #define DETECTORGRAPH_INCLUDE_GRAPHINPUTQUEUE_STL_HPP_
 
 #include "graphinputdispatcher.hpp"
+#include "inputqueuepolicy.hpp"
+#include "errortype.hpp"
+#include "dgassert.hpp"
 
-#include <queue>
+#include <vector>
+#include <algorithm>
+#include <new>
 
 namespace DetectorGraph
 {
 /**
  * @brief _Internal_ - Provides an STL implementation of GraphInputQueue
+ *
+ * Pending inputs are kept in ring buffers and each GraphInputDispatcher
+ * is constructed in a pooled slot that is recycled once it's dispatched.
+ * Slots are pooled by size class (powers of two) so after the first few
+ * inputs of each TopicState type enqueuing and dispatching doesn't touch the
+ * heap at all. The rings and pools only grow; they're freed with the queue.
+ *
+ * Inputs are dispatched from the highest priority lane (see SetPriority())
+ * that has any pending; within a lane, inputs enqueued with a deadline go
+ * first, earliest deadline first, followed by the others in FIFO order.
+ * Each lane keeps a min-heap for the former and a ring for the latter.
+ *
+ * The queue is unbounded unless SetCapacity() is used; inputs that don't
+ * fit are then handled according to the InputOverflowPolicy.
+ *
+ * Topics set with SetConflation() keep at most one pending input (without a
+ * deadline): enqueuing while one is pending overwrites it in its place in
+ * the queue. Every input in a ring gets a sequence number so whether a
+ * Topic's last input is still pending is a comparison against the sequence
+ * number of the oldest one.
  */
 class GraphInputQueue
 {
 public:
-    GraphInputQueue() : mInputQueue() {}
+    GraphInputQueue()
+    : mLanes(1), mNumPending(0), mNumUrgent(0), mNextDeadlineSequence(0), mFreeSlots()
+    , mCapacity(0), mOverflowPolicy(kRejectNewInput), mStats(), mTopicSettings()
+    {
+    }
+
+    /**
+     * @brief Pending inputs and pooled slots belong to a single queue so a
+     * copy starts out empty.
+     */
+    GraphInputQueue(const GraphInputQueue& aOther)
+    : mLanes(aOther.mLanes.size()), mNumPending(0), mNumUrgent(0), mNextDeadlineSequence(0), mFreeSlots()
+    , mCapacity(aOther.mCapacity), mOverflowPolicy(aOther.mOverflowPolicy), mStats()
+    , mTopicSettings(aOther.mTopicSettings)
+    {
+        for (size_t i = 0; i < mTopicSettings.size(); ++i)
+        {
+            mTopicSettings[i].pendingSequence = kNoSequence;
+        }
+    }
+
+    /**
+     * @brief Limits the queue to \p aCapacity pending inputs (0 for
+     * unbounded)
+     *
+     * kBlockProducer isn't supported as the only consumer is the thread
+     * pushing; it behaves as kRejectNewInput. Inputs already pending beyond
+     * the new capacity are kept. kDropOldestInput drops from the lowest
+     * priority lane with pending inputs: its oldest input without a deadline
+     * or, if there's none, the one with the latest deadline.
+     */
+    void SetCapacity(size_t aCapacity, InputOverflowPolicy aPolicy)
+    {
+        DG_ASSERT(aPolicy != kBlockProducer);
+        mCapacity = aCapacity;
+        mOverflowPolicy = aPolicy;
+    }
+
+    /**
+     * @brief Makes inputs for \p aTopic overwrite its still-pending one, if
+     * any, instead of being appended.
+     *
+     * Meant for state-like TopicStates where only the latest value matters.
+     * The overwritten input keeps its position relative to other inputs.
+     */
+    void SetConflation(const Vertex* aTopic, bool aEnabled)
+    {
+        TopicSettings* settings = FindTopicSettings(aTopic);
+        if (settings == NULL && aEnabled)
+        {
+            settings = AddTopicSettings(aTopic);
+        }
+
+        if (settings != NULL)
+        {
+            settings->conflate = aEnabled;
+            settings->pendingSequence = kNoSequence;
+            RemoveIfDefault(settings);
+        }
+    }
+
+    /**
+     * @brief Puts inputs for \p aTopic in lane \p aPriority (0 by default);
+     * higher lanes are dispatched first.
+     *
+     * Inputs already pending keep their lane.
+     */
+    void SetPriority(const Vertex* aTopic, unsigned aPriority)
+    {
+        TopicSettings* settings = FindTopicSettings(aTopic);
+        if (settings == NULL && aPriority != 0)
+        {
+            settings = AddTopicSettings(aTopic);
+        }
+
+        if (settings != NULL)
+        {
+            settings->priority = aPriority;
+            settings->pendingSequence = kNoSequence;
+            if (aPriority >= mLanes.size())
+            {
+                mLanes.resize(aPriority + 1);
+            }
+            RemoveIfDefault(settings);
+        }
+    }
+
+    /**
+     * @brief Forgets any settings for \p aTopic.
+     */
+    void RemoveTopic(const Vertex* aTopic)
+    {
+        TopicSettings* settings = FindTopicSettings(aTopic);
+        if (settings != NULL)
+        {
+            *settings = mTopicSettings.back();
+            mTopicSettings.pop_back();
+        }
+    }
+
+    InputQueueStats GetStats() const
+    {
+        InputQueueStats stats = mStats;
+        stats.depth = mNumPending;
+        return stats;
+    }
+
+    void ResetStats()
+    {
+        mStats = InputQueueStats();
+        mStats.highWaterMark = mNumPending;
+    }
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+    /**
+     * @brief Enqueues a TTopicState constructed from \p aArgs for \p aTopic.
+     */
+    template<class TTopicState, typename... TArgs>
+    ErrorType Enqueue(Topic<TTopicState>& aTopic, TArgs&&... aArgs)
+    {
+        if (!mTopicSettings.empty() || IsFull())
+        {
+            return EnqueueInput(aTopic, NULL, std::forward<TArgs>(aArgs)...);
+        }
+
+        const unsigned sizeClass = GetSizeClass(sizeof(GraphInputDispatcher<TTopicState>));
+        void* slot = AcquireSlot(sizeClass);
+        PushLowestLaneInput(new(slot) GraphInputDispatcher<TTopicState>(aTopic, std::forward<TArgs>(aArgs)...), slot, sizeClass);
+        return ErrorType_Success;
+    }
+
+    /**
+     * @brief Enqueues a TTopicState constructed from \p aArgs for \p aTopic
+     * ahead of inputs with later (or no) deadlines in its lane.
+     */
+    template<class TTopicState, typename... TArgs>
+    ErrorType EnqueueWithDeadline(InputDeadline aDeadline, Topic<TTopicState>& aTopic, TArgs&&... aArgs)
+    {
+        return EnqueueInput(aTopic, &aDeadline, std::forward<TArgs>(aArgs)...);
+    }
+#else
+    template<class TTopicState>
+    ErrorType Enqueue(Topic<TTopicState>& aTopic, const TTopicState& aTopicState)
+    {
+        if (!mTopicSettings.empty() || IsFull())
+        {
+            return EnqueueInput(aTopic, NULL, aTopicState);
+        }
+
+        const unsigned sizeClass = GetSizeClass(sizeof(GraphInputDispatcher<TTopicState>));
+        void* slot = AcquireSlot(sizeClass);
+        PushLowestLaneInput(new(slot) GraphInputDispatcher<TTopicState>(aTopic, aTopicState), slot, sizeClass);
+        return ErrorType_Success;
+    }
 
     template<class TTopicState>
-    void Enqueue(Topic<TTopicState>& aTopic, const TTopicState& aTopicState)
+    ErrorType EnqueueWithDeadline(InputDeadline aDeadline, Topic<TTopicState>& aTopic, const TTopicState& aTopicState)
     {
-        mInputQueue.push(new GraphInputDispatcher<TTopicState>(aTopic, aTopicState));
+        return EnqueueInput(aTopic, &aDeadline, aTopicState);
     }
+#endif
 
-    bool DequeueAndDispatch()
+    /**
+     * @brief Dispatches the most urgent input into its topic.
+     *
+     * Returns the Topic that received the input or NULL if the queue was
+     * empty.
+     */
+    Vertex* DequeueAndDispatch()
     {
-        if (!mInputQueue.empty())
+        if (mNumPending > 0)
         {
-            GraphInputDispatcherInterface* nextInput = mInputQueue.front();
-            mInputQueue.pop();
+            PendingInput nextInput = PopMostUrgentInput();
 
             // Will call Topic->Publish(aTopicState)
-            nextInput->Dispatch();
+            nextInput.dispatcher->Dispatch();
+            Vertex* topicVertex = nextInput.dispatcher->GetTopicVertex();
 
-            delete nextInput;
+            ReleaseSlot(nextInput);
 
-            return true;
+            return topicVertex;
         }
         else
         {
-            return false;
+            return NULL;
         }
     }
 
     bool IsEmpty() const
     {
-        return mInputQueue.empty();
+        return mNumPending == 0;
     }
 
     ~GraphInputQueue()
     {
-        while (!mInputQueue.empty())
+        while (mNumPending > 0)
+        {
+            ReleaseSlot(PopMostUrgentInput());
+        }
+
+        for (unsigned sizeClass = 0; sizeClass < mFreeSlots.size(); ++sizeClass)
         {
-            GraphInputDispatcherInterface* nextInput = mInputQueue.front();
-            mInputQueue.pop();
-            delete nextInput;
+            while (mFreeSlots[sizeClass] != NULL)
+            {
+                FreeSlot* slot = mFreeSlots[sizeClass];
+                mFreeSlots[sizeClass] = slot->next;
+                ::operator delete(slot);
+            }
         }
     }
 
 private:
-    std::queue< GraphInputDispatcherInterface* > mInputQueue;
+    // Not assignable; see the copy constructor.
+    GraphInputQueue& operator=(const GraphInputQueue&);
+
+    enum { kMinSlotSize = 16, kMinRingSize = 8 };
+    static const size_t kNoSequence = (size_t)-1;
+
+    struct PendingInput
+    {
+        GraphInputDispatcherInterface* dispatcher;
+        void* slot;
+        unsigned sizeClass;
+    };
+
+    struct DeadlineInput
+    {
+        PendingInput input;
+        InputDeadline deadline;
+        size_t sequence;
+
+        // Inverted for a min-heap; ties go in enqueuing order.
+        bool operator<(const DeadlineInput& aOther) const
+        {
+            return (deadline != aOther.deadline) ? (deadline > aOther.deadline) : (sequence > aOther.sequence);
+        }
+    };
+
+    /**
+     * @brief Inputs pending for one priority level.
+     */
+    struct Lane
+    {
+        Lane() : ring(), head(0), numQueued(0), headSequence(0), deadlineHeap() {}
+
+        size_t GetNumPending() const
+        {
+            return numQueued + deadlineHeap.size();
+        }
+
+        bool IsQueued(size_t aSequence) const
+        {
+            // Inputs only ever leave from the head so anything not older
+            // than it is still pending.
+            return aSequence != kNoSequence && aSequence >= headSequence;
+        }
+
+        PendingInput& GetQueued(size_t aSequence)
+        {
+            return ring[(head + (aSequence - headSequence)) & (ring.size() - 1)];
+        }
+
+        std::vector<PendingInput> ring;
+        size_t head;
+        size_t numQueued;
+
+        /**
+         * @brief Sequence number of the input at head.
+         */
+        size_t headSequence;
+
+        std::vector<DeadlineInput> deadlineHeap;
+    };
+
+    struct TopicSettings
+    {
+        const Vertex* topic;
+        unsigned priority;
+        bool conflate;
+        size_t pendingSequence;
+    };
+
+    /**
+     * @brief Where Commit() puts an input after Reserve()
+     */
+    struct Reservation
+    {
+        void* slot;
+        unsigned sizeClass;
+        Lane* lane;
+        PendingInput* conflated;
+        TopicSettings* settings;
+        const InputDeadline* deadline;
+    };
+
+    /**
+     * @brief Overlaid on recycled slots to link them in mFreeSlots.
+     */
+    struct FreeSlot
+    {
+        FreeSlot* next;
+    };
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+    /**
+     * @brief Enqueue() for when the queue is full or Topics have settings.
+     */
+    template<class TTopicState, typename... TArgs>
+    ErrorType EnqueueInput(Topic<TTopicState>& aTopic, const InputDeadline* apDeadline, TArgs&&... aArgs)
+    {
+        Reservation reservation;
+        ErrorType r = Reserve(&aTopic, sizeof(GraphInputDispatcher<TTopicState>), apDeadline, reservation);
+        if (reservation.slot != NULL)
+        {
+            Commit(reservation, new(reservation.slot) GraphInputDispatcher<TTopicState>(aTopic, std::forward<TArgs>(aArgs)...));
+        }
+        return r;
+    }
+#else
+    template<class TTopicState>
+    ErrorType EnqueueInput(Topic<TTopicState>& aTopic, const InputDeadline* apDeadline, const TTopicState& aTopicState)
+    {
+        Reservation reservation;
+        ErrorType r = Reserve(&aTopic, sizeof(GraphInputDispatcher<TTopicState>), apDeadline, reservation);
+        if (reservation.slot != NULL)
+        {
+            Commit(reservation, new(reservation.slot) GraphInputDispatcher<TTopicState>(aTopic, aTopicState));
+        }
+        return r;
+    }
+#endif
+
+    /**
+     * @brief Finds a slot for an input for \p aTopic, applying its settings
+     * and the overflow policy
+     *
+     * Leaves \p arReservation.slot NULL (and returns the result for Enqueue)
+     * if the new input must not be enqueued.
+     */
+    ErrorType Reserve(const Vertex* aTopic, size_t aDispatcherSize, const InputDeadline* apDeadline, Reservation& arReservation)
+    {
+        arReservation.slot = NULL;
+        arReservation.lane = &mLanes[0];
+        arReservation.conflated = NULL;
+        arReservation.settings = NULL;
+        arReservation.deadline = apDeadline;
+
+        if (!mTopicSettings.empty() && ApplyTopicSettings(aTopic, arReservation))
+        {
+            return ErrorType_Success;
+        }
+
+        ErrorType r = ErrorType_Success;
+        if (!IsFull() || MakeRoom(r))
+        {
+            arReservation.sizeClass = GetSizeClass(aDispatcherSize);
+            arReservation.slot = AcquireSlot(arReservation.sizeClass);
+        }
+        return r;
+    }
+
+    /**
+     * @brief Picks the lane for an input for \p aTopic and, if it's
+     * conflated and has one pending, reserves that one's slot.
+     *
+     * Returns true if it did the latter.
+     */
+    bool ApplyTopicSettings(const Vertex* aTopic, Reservation& arReservation)
+    {
+        TopicSettings* settings = FindTopicSettings(aTopic);
+        if (settings == NULL)
+        {
+            return false;
+        }
+
+        arReservation.settings = settings;
+        arReservation.lane = &mLanes[settings->priority];
+
+        if (settings->conflate && arReservation.deadline == NULL &&
+            arReservation.lane->IsQueued(settings->pendingSequence))
+        {
+            PendingInput& pending = arReservation.lane->GetQueued(settings->pendingSequence);
+            pending.dispatcher->~GraphInputDispatcherInterface();
+            arReservation.conflated = &pending;
+            arReservation.slot = pending.slot;
+            mStats.numConflated++;
+            return true;
+        }
+        return false;
+    }
+
+    void Commit(const Reservation& aReservation, GraphInputDispatcherInterface* aDispatcher)
+    {
+        if (aReservation.conflated != NULL)
+        {
+            aReservation.conflated->dispatcher = aDispatcher;
+            return;
+        }
+
+        PendingInput input;
+        input.dispatcher = aDispatcher;
+        input.slot = aReservation.slot;
+        input.sizeClass = aReservation.sizeClass;
+
+        Lane& lane = *aReservation.lane;
+        if (aReservation.deadline != NULL)
+        {
+            PushDeadlineInput(lane, input, *aReservation.deadline);
+        }
+        else
+        {
+            PushQueuedInput(lane, input);
+            if (aReservation.settings != NULL && aReservation.settings->conflate)
+            {
+                aReservation.settings->pendingSequence = lane.headSequence + lane.numQueued - 1;
+            }
+        }
+
+        if (aReservation.deadline != NULL || &lane != &mLanes[0])
+        {
+            mNumUrgent++;
+        }
+        CountPendingInput();
+    }
+
+    /**
+     * @brief Enqueue()'s fast path: no settings, no deadline and room to spare.
+     */
+    void PushLowestLaneInput(GraphInputDispatcherInterface* aDispatcher, void* aSlot, unsigned aSizeClass)
+    {
+        PendingInput input;
+        input.dispatcher = aDispatcher;
+        input.slot = aSlot;
+        input.sizeClass = aSizeClass;
+        PushQueuedInput(mLanes[0], input);
+        CountPendingInput();
+    }
+
+    void CountPendingInput()
+    {
+        mNumPending++;
+        if (mNumPending > mStats.highWaterMark)
+        {
+            mStats.highWaterMark = mNumPending;
+        }
+    }
+
+    bool IsFull() const
+    {
+        return mCapacity != 0 && mNumPending >= mCapacity;
+    }
+
+    /**
+     * @brief Applies the overflow policy when the queue is full
+     *
+     * Returns false (with the result for Enqueue in \p arResult) if the new
+     * input must not be enqueued.
+     */
+    bool MakeRoom(ErrorType& arResult)
+    {
+        switch (mOverflowPolicy)
+        {
+            case kDropOldestInput:
+                ReleaseSlot(PopLeastUrgentLaneInput());
+                mStats.numDropped++;
+                return true;
+
+            case kDropNewestInput:
+                mStats.numDropped++;
+                return false;
+
+            default:
+                mStats.numRejected++;
+                arResult = ErrorType_NoResource;
+                return false;
+        }
+    }
+
+    TopicSettings* FindTopicSettings(const Vertex* aTopic)
+    {
+        // Only a handful of Topics are expected to have settings.
+        for (size_t i = 0; i < mTopicSettings.size(); ++i)
+        {
+            if (mTopicSettings[i].topic == aTopic)
+            {
+                return &mTopicSettings[i];
+            }
+        }
+        return NULL;
+    }
+
+    TopicSettings* AddTopicSettings(const Vertex* aTopic)
+    {
+        TopicSettings settings;
+        settings.topic = aTopic;
+        settings.priority = 0;
+        settings.conflate = false;
+        settings.pendingSequence = kNoSequence;
+        mTopicSettings.push_back(settings);
+        return &mTopicSettings.back();
+    }
+
+    void RemoveIfDefault(TopicSettings* aSettings)
+    {
+        if (aSettings->priority == 0 && !aSettings->conflate)
+        {
+            RemoveTopic(aSettings->topic);
+        }
+    }
+
+    static unsigned GetSizeClass(size_t aSize)
+    {
+        unsigned sizeClass = 0;
+        while (((size_t)kMinSlotSize << sizeClass) < aSize)
+        {
+            sizeClass++;
+        }
+        return sizeClass;
+    }
+
+    void* AcquireSlot(unsigned aSizeClass)
+    {
+        if (aSizeClass >= mFreeSlots.size())
+        {
+            mFreeSlots.resize(aSizeClass + 1, NULL);
+        }
+
+        FreeSlot* slot = mFreeSlots[aSizeClass];
+        if (slot != NULL)
+        {
+            mFreeSlots[aSizeClass] = slot->next;
+            return slot;
+        }
+        return ::operator new((size_t)kMinSlotSize << aSizeClass);
+    }
+
+    void ReleaseSlot(const PendingInput& aInput)
+    {
+        aInput.dispatcher->~GraphInputDispatcherInterface();
+
+        FreeSlot* slot = static_cast<FreeSlot*>(aInput.slot);
+        slot->next = mFreeSlots[aInput.sizeClass];
+        mFreeSlots[aInput.sizeClass] = slot;
+    }
+
+    PendingInput PopMostUrgentInput()
+    {
+        mNumPending--;
+        if (mNumUrgent == 0)
+        {
+            return PopQueuedInput(mLanes[0]);
+        }
+
+        // Any urgent input goes ahead of those queued in the lowest lane.
+        mNumUrgent--;
+        Lane* lane = &mLanes.back();
+        while (lane->GetNumPending() == 0)
+        {
+            lane--;
+        }
+        return lane->deadlineHeap.empty() ? PopQueuedInput(*lane) : PopDeadlineInput(*lane);
+    }
+
+    PendingInput PopLeastUrgentLaneInput()
+    {
+        mNumPending--;
+        Lane* lane = &mLanes.front();
+        while (lane->GetNumPending() == 0)
+        {
+            lane++;
+        }
+
+        // Plain inputs go first (oldest first); of those with deadlines, the
+        // one due last.
+        const bool popQueued = lane->numQueued > 0;
+        if (lane != &mLanes.front() || !popQueued)
+        {
+            mNumUrgent--;
+        }
+        return popQueued ? PopQueuedInput(*lane) : PopLatestDeadlineInput(*lane);
+    }
+
+    static PendingInput PopQueuedInput(Lane& aLane)
+    {
+        PendingInput input = aLane.ring[aLane.head];
+        aLane.head = (aLane.head + 1) & (aLane.ring.size() - 1);
+        aLane.headSequence++;
+        aLane.numQueued--;
+        return input;
+    }
+
+    void PushDeadlineInput(Lane& aLane, const PendingInput& aInput, InputDeadline aDeadline)
+    {
+        DeadlineInput deadlineInput;
+        deadlineInput.input = aInput;
+        deadlineInput.deadline = aDeadline;
+        deadlineInput.sequence = mNextDeadlineSequence++;
+        aLane.deadlineHeap.push_back(deadlineInput);
+        std::push_heap(aLane.deadlineHeap.begin(), aLane.deadlineHeap.end());
+    }
+
+    static PendingInput PopDeadlineInput(Lane& aLane)
+    {
+        std::pop_heap(aLane.deadlineHeap.begin(), aLane.deadlineHeap.end());
+        PendingInput input = aLane.deadlineHeap.back().input;
+        aLane.deadlineHeap.pop_back();
+        return input;
+    }
+
+    static PendingInput PopLatestDeadlineInput(Lane& aLane)
+    {
+        // The latest deadline is always a leaf of the heap.
+        std::vector<DeadlineInput>& heap = aLane.deadlineHeap;
+        size_t latest = heap.size() / 2;
+        for (size_t i = latest + 1; i < heap.size(); ++i)
+        {
+            if (heap[i] < heap[latest])
+            {
+                latest = i;
+            }
+        }
+
+        PendingInput input = heap[latest].input;
+        heap[latest] = heap.back();
+        heap.pop_back();
+        if (latest < heap.size())
+        {
+            // Sifts the moved leaf up into place.
+            std::push_heap(heap.begin(), heap.begin() + latest + 1);
+        }
+        return input;
+    }
+
+    static void PushQueuedInput(Lane& aLane, const PendingInput& aInput)
+    {
+        if (aLane.numQueued == aLane.ring.size())
+        {
+            GrowRing(aLane);
+        }
+
+        aLane.ring[(aLane.head + aLane.numQueued) & (aLane.ring.size() - 1)] = aInput;
+        aLane.numQueued++;
+    }
+
+    static void GrowRing(Lane& aLane)
+    {
+        // Capacity is kept a power of two so wrapping around is a mask.
+        std::vector<PendingInput> grown(aLane.ring.empty() ? (size_t)kMinRingSize : 2 * aLane.ring.size());
+        for (size_t i = 0; i < aLane.numQueued; ++i)
+        {
+            grown[i] = aLane.ring[(aLane.head + i) & (aLane.ring.size() - 1)];
+        }
+        aLane.ring.swap(grown);
+        aLane.head = 0;
+    }
+
+    /**
+     * @brief Pending inputs, indexed by priority.
+     */
+    std::vector<Lane> mLanes;
+    size_t mNumPending;
+
+    /**
+     * @brief Number of pending inputs in higher lanes or with deadlines.
+     */
+    size_t mNumUrgent;
+    size_t mNextDeadlineSequence;
+
+    /**
+     * @brief Heads of the lists of recycled slots, indexed by size class.
+     */
+    std::vector<FreeSlot*> mFreeSlots;
+
+    size_t mCapacity;
+    InputOverflowPolicy mOverflowPolicy;
+    InputQueueStats mStats;
+
+    /**
+     * @brief Priority & conflation of the Topics that don't use the defaults.
+     */
+    std::vector<TopicSettings> mTopicSettings;
 };
 
 } // namespace DetectorGraph
@@ -16,7 +16,8 @@
 #define DETECTORGRAPH_INCLUDE_GRAPHSTATESTORE_HPP_
 
 #include <list>
-#include <queue>
+#include <deque>
+#include <stdint.h>
 
 #include "sharedptr.hpp"
 #include "topicstate.hpp"
@@ -32,15 +33,35 @@ namespace DetectorGraph
  * This class is responsible for maintaining a look back queue of previous graph
  * states (in the form of StateSnapshots) in a no-duplication and safe-sharing
  * fashion.
+ *
+ * The history keeps the last 2 snapshots by default; SetHistoryLimits allows
+ * keeping more, bounded by count and/or by memory. Since consecutive
+ * StateSnapshots share all unchanged storage, each retained snapshot costs
+ * roughly its delta (StateSnapshot::GetDeltaSizeInBytes) - so deep histories
+ * don't pay a full copy per version. Past snapshots can be looked up by
+ * version or by the timestamp they were taken at.
  */
 class GraphStateStore
 {
 public:
+    /**
+     * @brief Number of StateSnapshots retained unless SetHistoryLimits is used.
+     */
+    static const size_t kDefaultMaxNumSnapshots = 2;
+
     /**
      * @brief Constructs an empty graph store.
      */
     GraphStateStore();
 
+    /**
+     * @brief Constructs an empty graph store for a bounded TopicStateId space.
+     *
+     * Its StateSnapshots keep TopicStates with Ids in `[0, aNumTopicStateIds)`
+     * in a flat array for O(1) lookups; see StateSnapshot(size_t).
+     */
+    explicit GraphStateStore(size_t aNumTopicStateIds);
+
     /**
      * @brief Default Destructor.
      *
@@ -50,14 +71,33 @@ public:
      */
     ~GraphStateStore();
 
+    /**
+     * @brief Sets how many past snapshots are retained.
+     *
+     * Keeps at most \p aMaxNumSnapshots snapshots (including the last one) and,
+     * if \p aMaxSizeInBytes is non-zero, evicts the oldest ones while the
+     * history's approximate memory (GetHistorySizeInBytes) exceeds it. The last
+     * snapshot is always retained. Takes effect immediately.
+     */
+    void SetHistoryLimits(size_t aMaxNumSnapshots, size_t aMaxSizeInBytes = 0);
+
     /**
      * @brief Takes a new state snapshot and appends it to the look back queue.
      *
      * This method takes a graph output list and combines it with the previous
      * StateSnapshot (if existent) to generate a new StateSnapshot.
+     * The new snapshot is stamped with the same timestamp as the previous one.
      */
     void TakeNewSnapshot(const std::list< ptr::shared_ptr<const TopicState> >& arTopicStates);
 
+    /**
+     * @brief Takes a new state snapshot taken at \p aTimestamp.
+     *
+     * Timestamps are in the application's time base (e.g. the graph's
+     * TimeoutPublisherService::GetTime) and must not decrease between calls.
+     */
+    void TakeNewSnapshot(const std::list< ptr::shared_ptr<const TopicState> >& arTopicStates, uint64_t aTimestamp);
+
     /**
      * @brief Returns a safe shared pointer to the latest complete StateSnapshot
      *
@@ -66,10 +106,58 @@ public:
      */
     ptr::shared_ptr<const StateSnapshot> GetLastState() const;
 
-    // TODO(DGRAPH-19): APIs for accessing earlier snapshots.
+    /**
+     * @brief Returns the retained StateSnapshot with version \p aStateVersion
+     *
+     * Or an empty ptr::shared_ptr if that version was evicted or doesn't exist.
+     */
+    ptr::shared_ptr<const StateSnapshot> GetStateByVersion(unsigned int aStateVersion) const;
+
+    /**
+     * @brief Returns the latest retained StateSnapshot taken at or before
+     * \p aTimestamp
+     *
+     * Or an empty ptr::shared_ptr if all retained snapshots are newer.
+     * Runs in O(log n) on the number of retained snapshots.
+     */
+    ptr::shared_ptr<const StateSnapshot> GetStateAtTime(uint64_t aTimestamp) const;
+
+    /**
+     * @brief Returns the number of retained StateSnapshots.
+     */
+    size_t GetHistoryLength() const;
+
+    /**
+     * @brief Returns the approximate memory used by the retained StateSnapshots
+     *
+     * The oldest snapshot counts in full and every later one only by its
+     * delta; TopicStates themselves are not counted.
+     */
+    size_t GetHistorySizeInBytes() const;
+
+private:
+    struct HistoryEntry
+    {
+        ptr::shared_ptr<const StateSnapshot> mSnapshot;
+        uint64_t mTimestamp;
+    };
+
+    struct TimestampLess
+    {
+        bool operator()(uint64_t aTimestamp, const HistoryEntry& arEntry) const
+        {
+            return aTimestamp < arEntry.mTimestamp;
+        }
+    };
+
+    void PushSnapshot(const ptr::shared_ptr<const StateSnapshot>& arSnapshot, uint64_t aTimestamp);
+    void EvictOldSnapshots();
 
 private:
-    std::queue< ptr::shared_ptr<const StateSnapshot> > mStatesLookbackQueue;
+    std::deque<HistoryEntry> mStatesLookbackQueue;
+    size_t mMaxNumSnapshots;
+    size_t mMaxSizeInBytes;
+    size_t mHistorySizeInBytes;
 };
 
 }
@@ -0,0 +1,73 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DETECTORGRAPH_INCLUDE_INPUTQUEUEPOLICY_HPP_
+#define DETECTORGRAPH_INCLUDE_INPUTQUEUEPOLICY_HPP_
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace DetectorGraph
+{
+
+/**
+ * @brief What a capacity-limited input queue does with inputs that don't fit
+ *
+ * See Graph::SetInputQueueCapacity & Graph::EnableConcurrentInput.
+ */
+enum InputOverflowPolicy
+{
+    /** The new input is discarded and the push returns ErrorType_NoResource. */
+    kRejectNewInput,
+    /** The new input is silently discarded. */
+    kDropNewestInput,
+    /** The oldest pending input is discarded to make room for the new one. */
+    kDropOldestInput,
+    /**
+     * The pushing thread waits until the graph makes room. Only meaningful
+     * when pushing from other threads.
+     */
+    kBlockProducer
+};
+
+/**
+ * @brief Deadline for an input pushed with Graph::PushDataWithDeadline
+ *
+ * Only compared against other deadlines so any monotonic clock (e.g.
+ * TimeoutPublisherService::GetMonotonicTime) will do.
+ */
+typedef uint64_t InputDeadline;
+
+/**
+ * @brief Depth & overflow counters for an input queue
+ */
+struct InputQueueStats
+{
+    InputQueueStats() : depth(0), highWaterMark(0), numDropped(0), numRejected(0), numConflated(0) {}
+
+    /** Inputs currently pending. */
+    size_t depth;
+    /** Largest depth seen since the queue was created or the stats reset. */
+    size_t highWaterMark;
+    /** Inputs discarded by kDropNewestInput or kDropOldestInput. */
+    unsigned long numDropped;
+    /** Inputs refused with ErrorType_NoResource. */
+    unsigned long numRejected;
+    /** Pending inputs overwritten by a newer one for a conflated Topic. */
+    unsigned long numConflated;
+};
+
+}
+
+#endif // DETECTORGRAPH_INCLUDE_INPUTQUEUEPOLICY_HPP_
@@ -0,0 +1,163 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DETECTORGRAPH_INCLUDE_OUTPUTVIEW_HPP_
+#define DETECTORGRAPH_INCLUDE_OUTPUTVIEW_HPP_
+
+#include "topic.hpp"
+#include "topicstate.hpp"
+
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+namespace DetectorGraph
+{
+
+/**
+ * @brief A non-owning view of the TopicStates published in the last
+ * evaluation of a Graph.
+ *
+ * Iterating yields `const TopicState&` referring directly to the values
+ * stored in each Topic, in the same order as Graph::GetOutputList() but
+ * without copying or allocating anything. Like the Topics' values, the view
+ * and its references are only valid until the next call to
+ * Graph::EvaluateGraph().
+ *
+ * @code
+for (OutputView::const_iterator it = graph.GetOutputView().begin();
+    it != graph.GetOutputView().end(); ++it)
+{
+    if (it->GetId() == kFooTopicStateId)
+    {
+        const FooTopicState& foo = static_cast<const FooTopicState&>(*it);
+        // ...
+    }
+}
+ * @endcode
+ *
+ * Use Graph::GetOutputList() instead when the TopicStates need to outlive
+ * the evaluation (e.g. for a StateSnapshot).
+ */
+class OutputView
+{
+public:
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef TopicState value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const TopicState* pointer;
+        typedef const TopicState& reference;
+
+        const_iterator() : mpTopics(NULL), mTopicIndex(0), mValueIndex(0) {}
+
+        const_iterator(const std::vector<BaseTopic*>* apTopics, size_t aTopicIndex)
+        : mpTopics(apTopics), mTopicIndex(aTopicIndex), mValueIndex(0)
+        {
+            SkipEmptyTopics();
+        }
+
+        reference operator*() const
+        {
+            return (*mpTopics)[mTopicIndex]->GetCurrentTopicState(mValueIndex);
+        }
+
+        pointer operator->() const
+        {
+            return &(operator*());
+        }
+
+        const_iterator& operator++()
+        {
+            mValueIndex++;
+            SkipEmptyTopics();
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator previous = *this;
+            ++(*this);
+            return previous;
+        }
+
+        bool operator==(const const_iterator& aOther) const
+        {
+            return mTopicIndex == aOther.mTopicIndex && mValueIndex == aOther.mValueIndex;
+        }
+
+        bool operator!=(const const_iterator& aOther) const
+        {
+            return !(*this == aOther);
+        }
+
+    private:
+        void SkipEmptyTopics()
+        {
+            while (mTopicIndex < mpTopics->size() &&
+                mValueIndex >= (*mpTopics)[mTopicIndex]->GetCurrentValuesCount())
+            {
+                mTopicIndex++;
+                mValueIndex = 0;
+            }
+        }
+
+        const std::vector<BaseTopic*>* mpTopics;
+        size_t mTopicIndex;
+        size_t mValueIndex;
+    };
+
+    explicit OutputView(const std::vector<BaseTopic*>& arTopics) : mpTopics(&arTopics)
+    {
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(mpTopics, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(mpTopics, mpTopics->size());
+    }
+
+    bool empty() const
+    {
+        return begin() == end();
+    }
+
+    /**
+     * @brief Counts the TopicStates in the view; O(Topics in the view).
+     */
+    size_t size() const
+    {
+        size_t count = 0;
+        for (std::vector<BaseTopic*>::const_iterator topicIt = mpTopics->begin();
+            topicIt != mpTopics->end();
+            ++topicIt)
+        {
+            count += (*topicIt)->GetCurrentValuesCount();
+        }
+        return count;
+    }
+
+private:
+    const std::vector<BaseTopic*>* mpTopics;
+};
+
+}
+
+#endif // DETECTORGRAPH_INCLUDE_OUTPUTVIEW_HPP_
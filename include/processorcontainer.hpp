@@ -53,6 +53,17 @@ public:
         ProcessGraph();
     }
 
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+    /**
+     * @brief Same as ProcessData(const TTopic&) but moves rvalues into the graph.
+     */
+    template<class TTopic> void ProcessData(TTopic&& topicState)
+    {
+        mGraph.PushData(std::forward<TTopic>(topicState));
+        ProcessGraph();
+    }
+#endif
+
     /// @brief Performs all pending Graph Evaluations with output processing.
     void ProcessGraph()
     {
@@ -67,7 +78,8 @@ public:
      *
      * Users should provide an implementation for this method where they can
      * inspect specific output topics or process all new outputs generically
-     * using Graph::GetOutputList.
+     * using Graph::GetOutputView (or Graph::GetOutputList when the outputs
+     * must outlive the next evaluation).
      */
     virtual void ProcessOutput() = 0;
 
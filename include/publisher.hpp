@@ -87,6 +87,27 @@ public:
         DG_ASSERT(mTopic);
         mTopic->Publish(data);
     }
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+    /**
+     * @brief Publish a new version of T to a Topic by moving it in
+     */
+    void Publish(T&& data)
+    {
+        DG_ASSERT(mTopic);
+        mTopic->Publish(std::move(data));
+    }
+
+    /**
+     * @brief Publish a new version of T constructed in place in the Topic
+     */
+    template<typename... TArgs>
+    void PublishInPlace(TArgs&&... args)
+    {
+        DG_ASSERT(mTopic);
+        mTopic->PublishInPlace(std::forward<TArgs>(args)...);
+    }
+#endif
 };
 
 } // namespace DetectorGraph
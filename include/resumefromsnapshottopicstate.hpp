@@ -23,19 +23,40 @@
 
 #include <topicstate.hpp>
 #include "statesnapshot.hpp"
+#include "sharedptr.hpp"
 
 namespace DetectorGraph
 {
 
+/**
+ * @brief Carries the StateSnapshot resuming detectors initialize from.
+ *
+ * The snapshot is held through a shared, immutable handle: copying this
+ * TopicState (into the input queue, the Topic and each subscriber's
+ * Evaluate) only copies the handle, so all resuming detectors read the same
+ * StateSnapshot instance.
+ */
 struct ResumeFromSnapshotTopicState : public DetectorGraph::TopicState
 {
-    DetectorGraph::StateSnapshot snapshot;
+    ptr::shared_ptr<const DetectorGraph::StateSnapshot> snapshot;
 
-    ResumeFromSnapshotTopicState() : snapshot() {}
-    ResumeFromSnapshotTopicState(const DetectorGraph::StateSnapshot& aSnapshot)
+    ResumeFromSnapshotTopicState()
+    : snapshot(new DetectorGraph::StateSnapshot())
+    {
+    }
+
+    ResumeFromSnapshotTopicState(const ptr::shared_ptr<const DetectorGraph::StateSnapshot>& aSnapshot)
     : snapshot(aSnapshot)
     {
     }
+
+    /**
+     * @brief Copies \p aSnapshot once into a new shared handle.
+     */
+    ResumeFromSnapshotTopicState(const DetectorGraph::StateSnapshot& aSnapshot)
+    : snapshot(new DetectorGraph::StateSnapshot(aSnapshot))
+    {
+    }
 };
 
 }
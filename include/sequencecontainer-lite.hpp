@@ -53,6 +53,25 @@ public:
         mNumElements++;
     }
 
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+    void push_back(T&& v)
+    {
+        emplace_back(std::move(v));
+    }
+
+    template<typename... TArgs>
+    void emplace_back(TArgs&&... args)
+    {
+        DG_ASSERT(mNumElements < N);
+
+        uint8_t* storagePtr = &(mStorage[mNumElements * sizeof(T)]);
+        T* newElement = new(storagePtr) T(std::forward<TArgs>(args)...);
+        (void)newElement; // Otherwise it's unused in release builds.
+        DG_ASSERT((void*)newElement == (void*)&(Items()[mNumElements]));
+        mNumElements++;
+    }
+#endif
+
     T (& Items())[N]
     {
         return reinterpret_cast<T(&)[N]>(mStorage);
@@ -15,8 +15,8 @@
 #ifndef DETECTORGRAPH_INCLUDE_STATESNAPSHOT_HPP_
 #define DETECTORGRAPH_INCLUDE_STATESNAPSHOT_HPP_
 
-#include <map>
 #include <list>
+#include <vector>
 #include <stdint.h>
 
 #include "sharedptr.hpp"
@@ -30,6 +30,17 @@ namespace DetectorGraph
  *
  * Responsible for conveying and composing a complete state set in the form of
  * a collection of TopicState shared_ptrs.
+ *
+ * # Internals #
+ * TopicStates are kept in a persistent array trie keyed by TopicStateId
+ * (kTrieRadixBits of the Id per level). A StateSnapshot built from a previous
+ * one copies only the trie nodes on the paths to the Ids it changes and shares
+ * every other node with its predecessor - so taking a new snapshot costs
+ * O(changed TopicStates * depth) instead of O(all named TopicStates).
+ * Nodes are immutable once built, so sharing them between snapshots is safe.
+ *
+ * Snapshots for a bounded TopicStateId space (see StateSnapshot(size_t)) keep
+ * the Ids within the bound in a flat array instead.
  */
 class StateSnapshot
 {
@@ -41,6 +52,21 @@ public:
      */
     StateSnapshot();
 
+    /**
+     * @brief T=0 Constructor for a bounded TopicStateId space
+     *
+     * Builds an initial and empty StateSnapshot that keeps TopicStates with
+     * Ids in `[0, aNumTopicStateIds)` in a flat array indexed by Id - making
+     * GetState a single index and GetTopicStates a linear scan. Snapshots built
+     * from it keep the same layout. This suits applications with a contiguous
+     * TopicStateId enum (e.g. ending in `kNumberOfTopicStateIds`); Ids outside
+     * the range still work but are kept in the trie.
+     *
+     * Taking a new snapshot copies the array (one allocation) whenever one of
+     * its TopicStates changes, so prefer it for small Id spaces.
+     */
+    explicit StateSnapshot(size_t aNumTopicStateIds);
+
     /**
      * @brief T=0 Priming Constructor
      *
@@ -48,6 +74,14 @@ public:
      */
     StateSnapshot(const std::list< ptr::shared_ptr<const TopicState> >& arTopicStates);
 
+    /**
+     * @brief T=0 Priming Constructor for a bounded TopicStateId space
+     *
+     * Builds a prime StateSnapshot from a TopicState list, with the flat layout
+     * described in StateSnapshot(size_t).
+     */
+    StateSnapshot(size_t aNumTopicStateIds, const std::list< ptr::shared_ptr<const TopicState> >& arTopicStates);
+
     /**
      * @brief T>0 Constructor
      *
@@ -86,6 +120,23 @@ public:
      */
     size_t GetMapSize() const;
 
+    /**
+     * @brief Returns the approximate memory used by this snapshot's storage.
+     *
+     * Counts the snapshot and all storage reachable from it - including what
+     * is shared with other snapshots - but not the TopicStates themselves.
+     */
+    size_t GetSizeInBytes() const;
+
+    /**
+     * @brief Returns the approximate memory allocated to build this snapshot.
+     *
+     * For a snapshot built from a previous one this is only what it does not
+     * share with it (i.e. the copied paths); for a T=0 snapshot it equals
+     * GetSizeInBytes(). TopicStates themselves are not counted.
+     */
+    size_t GetDeltaSizeInBytes() const;
+
     /**
      * @brief Returns the version of this snapshot.
      *
@@ -97,16 +148,79 @@ public:
     /**
      * @brief Gets TopicStates stored in this snapshot
      *
-     * Fills aOutTopicStateList with all public TopicStates stored in this Snapshot.
+     * Fills aOutTopicStateList with all public TopicStates stored in this Snapshot,
+     * ordered by TopicStateId.
      * This can be useful for merging the contents of this snapshot into another.
      */
     void GetTopicStates(std::list< ptr::shared_ptr<const TopicState> >& aOutTopicStateList) const;
 
 private:
+    static const unsigned kTrieRadixBits = 4;
+    static const unsigned kTrieFanout = 1u << kTrieRadixBits;
+
+    // Level 0 nodes are TrieLeaves; every level above holds TrieBranches
+    // whose children live one level down.
+    struct TrieBranch
+    {
+        ptr::shared_ptr<const void> mChildren[kTrieFanout];
+    };
+
+    struct TrieLeaf
+    {
+        ptr::shared_ptr<const TopicState> mValues[kTrieFanout];
+    };
+
+    typedef std::vector< ptr::shared_ptr<const TopicState> > DenseStates;
+
+    struct PendingValue
+    {
+        unsigned mKey;
+        const ptr::shared_ptr<const TopicState>* mpValue;
+        bool operator<(const PendingValue& aOther) const { return mKey < aOther.mKey; }
+    };
+
+    typedef std::vector<PendingValue>::const_iterator PendingValueIterator;
+
+    static unsigned TrieIndex(unsigned aKey, unsigned aLevel)
+    {
+        return (aKey >> (aLevel * kTrieRadixBits)) & (kTrieFanout - 1);
+    }
+
+    static size_t DenseSizeInBytes(size_t aNumDenseIds)
+    {
+        return aNumDenseIds ? sizeof(DenseStates) + aNumDenseIds * sizeof(ptr::shared_ptr<const TopicState>) : 0;
+    }
+
+    static bool KeyFits(unsigned aKey, unsigned aNumLevels)
+    {
+        return (aNumLevels * kTrieRadixBits >= sizeof(aKey) * 8) ||
+            ((aKey >> (aNumLevels * kTrieRadixBits)) == 0);
+    }
+
     void UpdateValues(const std::list< ptr::shared_ptr<const TopicState> >& arTopicStates);
 
+    ptr::shared_ptr<const void> Assign(
+        const ptr::shared_ptr<const void>& arNode,
+        unsigned aLevel,
+        PendingValueIterator aBegin,
+        PendingValueIterator aEnd);
+
+    static void CollectValues(
+        const ptr::shared_ptr<const void>& arNode,
+        unsigned aLevel,
+        std::list< ptr::shared_ptr<const TopicState> >& aOutTopicStateList);
+
 private:
-    std::map< TopicStateIdType, ptr::shared_ptr<const TopicState> > mStateStore;
+    // Flat storage for Ids in [0, mNumDenseIds); shared with the previous
+    // snapshot until one of its TopicStates changes.
+    ptr::shared_ptr<const DenseStates> mDenseStates;
+    size_t mNumDenseIds;
+    ptr::shared_ptr<const void> mRoot;
+    unsigned mNumLevels;
+    size_t mNumStates;
+    size_t mNumTrieBranches;
+    size_t mNumTrieLeaves;
+    size_t mDeltaSizeInBytes;
     unsigned int mStateVersion;
 };
 
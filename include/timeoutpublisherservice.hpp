@@ -77,20 +77,34 @@ class TimeoutPublisherService
     /**
      * @brief Internal Dispatcher for periodically dispatching TopicState to Graph::PushData<T>
      *
-     * This internal data structure holds a periodically-triggered dispatcher. It is also used to track
-     * the time between triggers, so that different dispatchers can use the same synchronized metronome timer.
+     * This internal data structure holds a periodically-triggered dispatcher
+     * and the metronome time at which it's next due. Series are kept in a
+     * min-heap on (mNextPublishingTime, mSeriesIndex) so the metronome only
+     * needs to fire when the earliest one is due - and series due at the same
+     * time are dispatched in the order they were scheduled.
      */
     struct PeriodicPublishingSeries
     {
         TimeOffset mPublishingPeriodMsec;
-        TimeOffset mMetronomeAccumulator;
+        TimeOffset mNextPublishingTime;
         DispatcherInterface* mpDispatcher;
+        unsigned mSeriesIndex;
 
         PeriodicPublishingSeries(TimeOffset aPublishingPeriodMsec,
-            DispatcherInterface* aDispatcher)
+            TimeOffset aNextPublishingTime,
+            DispatcherInterface* aDispatcher,
+            unsigned aSeriesIndex)
         : mPublishingPeriodMsec(aPublishingPeriodMsec)
-        , mMetronomeAccumulator(0)
-        , mpDispatcher(aDispatcher) {}
+        , mNextPublishingTime(aNextPublishingTime)
+        , mpDispatcher(aDispatcher)
+        , mSeriesIndex(aSeriesIndex) {}
+
+        bool IsDueBefore(const PeriodicPublishingSeries& aOther) const
+        {
+            return (mNextPublishingTime != aOther.mNextPublishingTime)
+                ? (mNextPublishingTime < aOther.mNextPublishingTime)
+                : (mSeriesIndex < aOther.mSeriesIndex);
+        }
     };
 
 
@@ -126,8 +140,11 @@ public:
     /**
      * @brief Starts a Metronome to publish scheduled TopicStates
      *
-     * Calling this method starts a metronome(periodic timer).
-     * TimeoutPublisherService will start publishing scheduled TopicStates periodically to graph.
+     * Calling this method arms the metronome for the earliest scheduled
+     * TopicState. TimeoutPublisherService will start publishing scheduled
+     * TopicStates periodically to graph, waking up only when one is due.
+     * TopicStates scheduled after this call are first considered the next
+     * time the metronome fires.
      */
     void StartPeriodicPublishing();
 
@@ -144,7 +161,6 @@ public:
      * @brief Schedules a TopicState for publishing periodically
      *
      * This is called by different Detectors with a TopicState and a publishing period.
-     * This method updates the metronome period based on the GCD of the requested publishing period.
      * Calling 'StartPeriodicPublishing' will start publishing `T` to the graph periodically
      * with interval @param aPeriodInMilliseconds .
      *
@@ -269,25 +285,37 @@ protected:
     virtual void Cancel(const TimeoutPublisherHandle) = 0;
 
     /**
-     * @brief Update metronome counters and Fires/Dispatches TopicStates that was pending on scheduled period.
+     * @brief Fires/Dispatches the TopicStates due at the metronome's deadline
+     * and re-arms it for the next one.
      *
      * This method should be called by a particular subclasses of
      * TimeoutPublisherService to notify the service that the actual
-     * internal period timer has fired.
+     * internal metronome timer has fired. It calls ArmMetronome with the
+     * time until the next periodic TopicState is due.
      */
     void MetronomeFired();
 
     /**
-     * @brief Should start the metronome (periodic timer) for the given period.
+     * @brief Should (re)arm the metronome to fire once after the given time.
+     *
+     * This must be implemented by subclasses. This should start a one-shot
+     * timer - replacing any pending one - that calls MetronomeFired() when it
+     * expires. The service re-arms it from within MetronomeFired().
      *
-     * This must be implemented by subclasses. This should start the periodic timer.
+     * This replaces StartMetronome(aPeriodInMilliseconds), which asked for a
+     * periodic timer ticking at the GCD of all periods. Subclasses migrating
+     * from it should rename it to ArmMetronome, make their timer one-shot
+     * and stop re-arming it after calling MetronomeFired(). Subclasses that
+     * still only implement StartMetronome are left abstract and no longer
+     * build.
      */
-    virtual void StartMetronome(const TimeOffset aPeriodInMilliseconds) = 0;
+    virtual void ArmMetronome(const TimeOffset aMillisecondsFromNow) = 0;
 
     /**
      * @brief Should stop the metronome.
      *
-     * This must be implemented by subclasses. This should stop the periodic timer.
+     * This must be implemented by subclasses. This should cancel the pending
+     * metronome timer, if any.
      */
     virtual void CancelMetronome() = 0;
 
@@ -303,9 +331,24 @@ private:
     void SchedulePeriodicPublishingDispatcher(DispatcherInterface* aDispatcher, const TimeOffset aPeriodInMilliseconds);
 
     /**
-     * @brief Euclidean algorithm to compute great common divisor(GCD)
+     * @brief Arms the metronome for the earliest due periodic series
+     */
+    void ArmMetronomeForNextSeries();
+
+    /**
+     * @brief Restores the heap order of mPeriodicSeries from \p aIndex up
+     */
+    void SiftUpPeriodicSeries(unsigned aIndex);
+
+    /**
+     * @brief Restores the heap order of mPeriodicSeries from \p aIndex down
+     */
+    void SiftDownPeriodicSeries(unsigned aIndex);
+
+    /**
+     * @brief Swaps two entries of mPeriodicSeries
      */
-    TimeOffset gcd(TimeOffset lhs, TimeOffset rhs);
+    void SwapPeriodicSeries(unsigned aIndexA, unsigned aIndexB);
 
     /**
      * @brief Reference to the graph to which timed out TopicStates will be
@@ -314,9 +357,15 @@ private:
     Graph& mrGraph;
 
     /**
-     * @brief Metronome period which used for periodic Topicstates publishing
+     * @brief Metronome time of the last (or, before the first, of no)
+     metronome firing; periodic series deadlines are kept in this time base.
+     */
+    TimeOffset mMetronomeTime;
+
+    /**
+     * @brief Metronome time at which the armed metronome fires
      */
-    TimeOffset mMetronomePeriodMsec;
+    TimeOffset mMetronomeDeadline;
 
     /**
      * @brief Map of pending TopicStates per Handle
@@ -324,7 +373,7 @@ private:
     TimeoutDispatchersContainer mTimeoutDispatchers;
 
     /**
-     * @brief List of scheduled periodic TopicStates dispatcher
+     * @brief Min-heap of scheduled periodic TopicStates dispatchers
      */
     PeriodicPublishingSeriesContainer mPeriodicSeries;
 
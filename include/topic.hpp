@@ -48,12 +48,39 @@ class BaseTopic : public Vertex
 public:
 #if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
     virtual std::list< ptr::shared_ptr<const TopicState> > GetCurrentTopicStates() const = 0;
-    virtual TopicStateIdType GetId() const = 0;
+
+    /**
+     * @brief Returns the TopicStateId of the Topic's TopicState type.
+     */
+    TopicStateIdType GetId() const
+    {
+        return mTopicStateId;
+    }
+
+    /**
+     * @brief Drops all values published to this topic.
+     */
+    virtual void ClearCurrentValues() = 0;
+
+    /**
+     * @brief Returns the number of values published in this evaluation.
+     */
+    virtual size_t GetCurrentValuesCount() const = 0;
+
+    /**
+     * @brief Returns a reference to the \p aIndex-th value published in this
+     * evaluation, without copying it.
+     */
+    virtual const TopicState& GetCurrentTopicState(size_t aIndex) const = 0;
 #endif
 
     virtual VertexType GetVertexType() const { return Vertex::kTopicVertex; }
 
 protected:
+#if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
+    explicit BaseTopic(TopicStateIdType aTopicStateId) : mTopicStateId(aTopicStateId) {}
+#endif
+
     void MarkChildrenState(VertexSearchState aNewState)
     {
         for (VertexPtrContainer::iterator vIt = GetOutEdges().begin();
@@ -63,6 +90,11 @@ protected:
             (*vIt)->SetState(aNewState);
         }
     }
+
+#if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
+private:
+    TopicStateIdType mTopicStateId;
+#endif
 };
 /**
  * @brief Manage data and its handler
@@ -76,6 +108,8 @@ protected:
  * - The first Publish call during an evaluation pass (cleared
  * before adding new value)
  * - Topic is processed, and no further data will be Published to it
+ * - (Full config) The Graph starts a new evaluation and the topic was
+ * published to on the previous one
  *
  * The intended behavior is to have this vector always contain all the
  * data for a single evaluation pass - or nothing if that's the case.
@@ -97,6 +131,9 @@ public:
 #endif
 
     Topic()
+#if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
+    : BaseTopic(TopicState::GetId<T>())
+#endif
     {
         // Pre-C++11 type checking.
 #if __cplusplus < 201103L
@@ -109,15 +146,31 @@ public:
      */
     void Publish(const T& arPayload)
     {
-        if (Vertex::GetState() != kVertexProcessing)
-        {
-            mCurrentValues.clear();
-            Vertex::SetState(kVertexProcessing);
-        }
-
+        BeginPublishing();
         mCurrentValues.push_back(arPayload);
     }
 
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+    /**
+     * @brief Append data to its vector by moving it in
+     */
+    void Publish(T&& arPayload)
+    {
+        BeginPublishing();
+        mCurrentValues.push_back(std::move(arPayload));
+    }
+
+    /**
+     * @brief Append a T constructed in place from \p aArgs to its vector
+     */
+    template<typename... TArgs>
+    void PublishInPlace(TArgs&&... aArgs)
+    {
+        BeginPublishing();
+        mCurrentValues.emplace_back(std::forward<TArgs>(aArgs)...);
+    }
+#endif
+
     virtual void ProcessVertex()
     {
         // TODO(DGRAPH-5): This maintains the old detector graph state style
@@ -192,9 +245,19 @@ public:
 
 #if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
 // FULL_BEGIN
-    virtual TopicStateIdType GetId() const
+    virtual void ClearCurrentValues()
     {
-        return TopicState::GetId<T>();
+        mCurrentValues.clear();
+    }
+
+    virtual size_t GetCurrentValuesCount() const
+    {
+        return mCurrentValues.size();
+    }
+
+    virtual const TopicState& GetCurrentTopicState(size_t aIndex) const
+    {
+        return mCurrentValues[aIndex];
     }
 
     virtual std::list<ptr::shared_ptr<const TopicState> > GetCurrentTopicStates() const
@@ -214,6 +277,15 @@ public:
 #endif
 
 private:
+    void BeginPublishing()
+    {
+        if (Vertex::GetState() != kVertexProcessing)
+        {
+            mCurrentValues.clear();
+            Vertex::SetState(kVertexProcessing);
+        }
+    }
+
     /*
      * @brief List of current data in topic. @sa Topic.
      */
@@ -18,8 +18,10 @@
 #include "topic.hpp"
 #include "topicstate.hpp"
 
-#include <map>
-#include <typeinfo>
+#include <vector>
+#if __cplusplus >= 201103L
+#include <atomic>
+#endif
 
 namespace DetectorGraph
 {
@@ -28,32 +30,32 @@ namespace DetectorGraph
  *
  * Graphs use a TopicRegistry to register and resolve (i.e. retrieve) Topics
  * using a Type-aware API.
- * This uses RTTI to retrieve an 'index' for each class.
  *
- * Right now using 'name' because it's convenient for debugging..
- * But could use other stuff too.
+ * Each TopicState type is assigned a small dense index the first time any
+ * registry sees it (process-wide, so the same type has the same index in
+ * every registry) and Topics are stored in a flat vector by that index.
+ * Resolving is then a bounds check and a load - no RTTI, hashing or tree
+ * walk.
  */
 class TopicRegistry
 {
-    /* TODO(DGRAPH-18): Use std::type_index (from <typeindex>) as the
-     * registry's index when on C++11. */
-    std::map<const char*, BaseTopic*> registry;
+    std::vector<BaseTopic*> mTopics;
 public:
 
     /**
      * @brief _Internal_ - Retrieves a Topic pointer for a given TopicState.
      */
     template<class TTopicState>
-    Topic<TTopicState>* Resolve()
+    Topic<TTopicState>* Resolve() const
     {
 #if __cplusplus >= 201103L
         static_assert(std::is_base_of<TopicState, TTopicState>::value,
             "Trying to Resolve non-Topic type.");
 #endif
-        const char* typeKey = typeid(TTopicState).name();
-        if (registry.count(typeKey) != 0)
+        const size_t typeIndex = GetTypeIndex<TTopicState>();
+        if (typeIndex < mTopics.size())
         {
-            return static_cast<Topic<TTopicState>*>(registry[typeKey]);
+            return static_cast<Topic<TTopicState>*>(mTopics[typeIndex]);
         }
         return NULL;
     }
@@ -68,7 +70,32 @@ public:
         static_assert(std::is_base_of<TopicState, TTopicState>::value,
             "Trying to Register non-Topic type.");
 #endif
-        registry[typeid(TTopicState).name()] = obj;
+        const size_t typeIndex = GetTypeIndex<TTopicState>();
+        if (typeIndex >= mTopics.size())
+        {
+            mTopics.resize(typeIndex + 1, NULL);
+        }
+        mTopics[typeIndex] = obj;
+    }
+
+private:
+    template<class TTopicState>
+    static size_t GetTypeIndex()
+    {
+        static const size_t sTypeIndex = NextTypeIndex();
+        return sTypeIndex;
+    }
+
+    static size_t NextTypeIndex()
+    {
+#if __cplusplus >= 201103L
+        // Types may be seen for the first time by Graphs on different
+        // threads.
+        static std::atomic<size_t> sNextTypeIndex(0);
+#else
+        static size_t sNextTypeIndex = 0;
+#endif
+        return sNextTypeIndex++;
     }
 };
 
@@ -26,6 +26,60 @@ namespace DetectorGraph
 
 typedef int TopicStateIdType;
 
+#if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
+// FULL_BEGIN
+/**
+ * @brief _Internal_ - Detects a compile-time `kTopicStateId` in \p T
+ */
+template<class T>
+struct HasStaticTopicStateId
+{
+private:
+    typedef char Yes;
+    typedef char (&No)[2];
+    template<TopicStateIdType> struct Probe {};
+    template<class U> static Yes Test(Probe<U::kTopicStateId>*);
+    template<class U> static No Test(...);
+public:
+    enum { value = (sizeof(Test<T>(0)) == sizeof(Yes)) };
+};
+
+/**
+ * @brief The TopicStateId of \p T, known at compile time if \p T declares
+ * it as a `kTopicStateId` constant (see NamedTopicState).
+ *
+ * `TopicStateIdOf<T>::value` is then a constant expression.
+ */
+template<class T, bool = HasStaticTopicStateId<T>::value>
+struct TopicStateIdOf
+{
+    static const TopicStateIdType value = T::kTopicStateId;
+
+    static TopicStateIdType Get()
+    {
+        return value;
+    }
+};
+
+template<class T, bool B>
+const TopicStateIdType TopicStateIdOf<T, B>::value;
+
+/**
+ * @brief Fallback for TopicStates that only override the virtual GetId():
+ * asks a function-static default-constructed instance.
+ */
+template<class T>
+struct TopicStateIdOf<T, false>
+{
+    static TopicStateIdType Get()
+    {
+        static const T dummy = T();
+        return dummy.GetId();
+    } // LCOV_EXCL_LINE
+};
+// FULL_END
+#endif
+
 /**
  * @brief Base struct for topic data types
  *
@@ -86,6 +140,8 @@ struct TopicState
      *
      * For a full discussion/example of how to use _Named TopicStates_ see
      * [Trivial Vending Machine Example](@ref trivialvendingmachine.cpp)
+     *
+     * @sa NamedTopicState for declaring the Id at compile time.
      */
     virtual TopicStateIdType GetId() const
     {
@@ -95,19 +151,55 @@ struct TopicState
     /**
      * @brief Convenience templated static method to retrieve the ID for a
      * Type when an instance is not available.
+     *
+     * Free for types that declare their Id at compile time (see
+     * NamedTopicState); otherwise a default-constructed instance is asked.
      */
     template<class TTopic>
     static TopicStateIdType GetId()
     {
-        static const TTopic dummy = TTopic();
-        return dummy.GetId();
-    } // LCOV_EXCL_LINE
+        return TopicStateIdOf<TTopic>::Get();
+    }
 
 // FULL_END
 #endif
 
 };
 
+#if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
+// FULL_BEGIN
+/**
+ * @brief Base for Named TopicStates with an Id known at compile time
+ *
+ * Declares both the `kTopicStateId` constant the library uses when it has
+ * the type (e.g. Topic, StateSnapshot::GetState<T>()) and the matching
+ * GetId() override for when it only has an instance:
+ * @code
+struct Balance : public DetectorGraph::NamedTopicState<kBalanceId>
+{
+    int numberOfCoins;
+};
+ * @endcode
+ *
+ * Such TopicStates need not be default-constructible. Declaring
+ * `kTopicStateId` directly works too, as long as GetId() returns the same.
+ */
+template<TopicStateIdType TId>
+struct NamedTopicState : public TopicState
+{
+    static const TopicStateIdType kTopicStateId = TId;
+
+    virtual TopicStateIdType GetId() const
+    {
+        return TId;
+    }
+};
+
+template<TopicStateIdType TId>
+const TopicStateIdType NamedTopicState<TId>::kTopicStateId;
+// FULL_END
+#endif
+
 } // namespace DetectorGraph
 
 #endif // DETECTORGRAPH_INCLUDE_TOPICSTATE_HPP_
@@ -16,6 +16,7 @@
 #define DETECTORGRAPH_INCLUDE_VERTEX_HPP_
 
 #include "dglogging.hpp"
+#include "dgstdincludes.hpp"
 
 #if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
 // LITE_BEGIN
@@ -43,7 +44,17 @@ public:
     typedef std::list<Vertex*> VertexPtrContainer;
 #endif
 
-    Vertex() : mState(kVertexClear) {}
+    /**
+     * @brief Counter used to invalidate the VertexSearchState of many
+     * vertices at once.
+     */
+    typedef uint32_t EvaluationEpoch;
+
+    Vertex() : mState(kVertexClear), mStateEpoch(0), mpEvaluationEpoch(&DetachedEpoch())
+#if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
+    , mTopoOrder(0)
+#endif
+    {}
     virtual ~Vertex() {}
     virtual void ProcessVertex() = 0;
     /**
@@ -68,14 +79,34 @@ public:
 
     virtual VertexType GetVertexType() const = 0;
 
+    /**
+     * @brief Returns the search state of this vertex.
+     *
+     * A state set on an earlier evaluation epoch reads as kVertexClear.
+     */
     VertexSearchState GetState() const
     {
-        return mState;
+        return (mStateEpoch == *mpEvaluationEpoch) ? mState : kVertexClear;
     }
 
     void SetState(VertexSearchState aNewState)
     {
         mState = aNewState;
+        mStateEpoch = *mpEvaluationEpoch;
+    }
+
+    /**
+     * @brief Binds the state of this vertex to an evaluation epoch.
+     *
+     * Graphs bind all their vertices to a single counter so that advancing it
+     * clears the state of every vertex in O(1). Passing NULL unbinds the
+     * vertex. The current state is preserved in either case.
+     */
+    void SetEvaluationEpochSource(const EvaluationEpoch* apEvaluationEpoch)
+    {
+        VertexSearchState currentState = GetState();
+        mpEvaluationEpoch = (apEvaluationEpoch != NULL) ? apEvaluationEpoch : &DetachedEpoch();
+        SetState(currentState);
     }
 
     void InsertEdge(Vertex* aVertex)
@@ -128,6 +159,22 @@ public:
         return mFutureInEdges;
     }
 
+    /**
+     * @brief Returns the position of this vertex in the Graph's topological
+     * sort.
+     *
+     * Only meaningful after the owning Graph has been sorted.
+     */
+    unsigned GetTopoOrder() const
+    {
+        return mTopoOrder;
+    }
+
+    void SetTopoOrder(unsigned aTopoOrder)
+    {
+        mTopoOrder = aTopoOrder;
+    }
+
     // This uses RTTI only for clarity purposes. And could potentially be removed.
     // LCOV_EXCL_START
     const char * GetName() const
@@ -138,14 +185,24 @@ public:
     // FULL_END
 #endif
 
+private:
+    static const EvaluationEpoch& DetachedEpoch()
+    {
+        static const EvaluationEpoch kDetachedEpoch = 0;
+        return kDetachedEpoch;
+    }
+
 protected:
     VertexSearchState mState;
+    EvaluationEpoch mStateEpoch;
+    const EvaluationEpoch* mpEvaluationEpoch;
     VertexPtrContainer mOutEdges;
 
 #if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
     VertexPtrContainer mInEdges;
     VertexPtrContainer mFutureOutEdges;
     VertexPtrContainer mFutureInEdges;
+    unsigned mTopoOrder;
 #endif
 };
 
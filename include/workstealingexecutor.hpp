@@ -0,0 +1,152 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DETECTORGRAPH_INCLUDE_WORKSTEALINGEXECUTOR_HPP_
+#define DETECTORGRAPH_INCLUDE_WORKSTEALINGEXECUTOR_HPP_
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+
+#include "vertex.hpp"
+#include "topic.hpp"
+#include "evaluationworkerpool.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace DetectorGraph
+{
+
+/**
+ * @brief Evaluates a Graph's execution plan as a dataflow over a pool of
+ * work-stealing workers.
+ *
+ * Used by Graph::SetParallelEvaluation with Graph::kWorkStealing. Instead of
+ * waiting for a whole dependency level to finish, each vertex downstream of
+ * the input starts as soon as all of its in-edges within that region have
+ * completed, tracked by per-vertex atomic counters.
+ *
+ * - Each worker owns a lock-free Chase-Lev deque of ready vertices; it
+ * pushes and takes at the back and idle workers steal from the front of the
+ * others' with a single CAS.
+ * - Workers that find nothing to steal park on a condition variable until
+ * more vertices are made ready or the evaluation is done.
+ * - Vertices made ready together are queued by their measured cost so the
+ * most expensive Detector is started first.
+ * - Detectors in the same serialization group (i.e. publishing to the same
+ * Topic) are chained in plan order with extra dependencies, so every Topic
+ * only ever has one writer at a time and its values keep the same order as
+ * in a serial evaluation.
+ */
+class WorkStealingExecutor
+{
+public:
+    WorkStealingExecutor();
+
+    /**
+     * @brief Resizes the per-vertex bookkeeping to a plan of \p aNumVertices.
+     *
+     * Must be called whenever the plan is recompiled.
+     */
+    void Reset(unsigned aNumVertices);
+
+    /**
+     * @brief Evaluates everything downstream of the vertex \p aInputIndex.
+     *
+     * The plan arrays are the ones compiled by the Graph (see
+     * Graph::CompilePlan). Topics published during the evaluation are
+     * appended to \p arPublishedTopics.
+     */
+    void Run(EvaluationWorkerPool& arPool,
+        const std::vector<Vertex*>& arVertices,
+        const std::vector<Vertex::VertexType>& arVertexTypes,
+        const std::vector<unsigned>& arOutEdgeOffsets,
+        const std::vector<unsigned>& arOutEdges,
+        const std::vector<unsigned>& arGroups,
+        unsigned aInputIndex,
+        std::vector<BaseTopic*>& arPublishedTopics);
+
+private:
+    /**
+     * @brief A worker's deque of ready vertices (Chase & Lev, with the
+     * C11 memory orderings of Le et al.)
+     *
+     * Every vertex is pushed at most once per Run() so, with both ends reset
+     * by Run(), a buffer the size of the region never wraps or grows.
+     */
+    struct WorkerQueue
+    {
+        WorkerQueue() : mTop(0), mPadding(), mBottom(0), mNumSlots(0) {}
+
+        // Stolen from by other workers.
+        std::atomic<long> mTop;
+        char mPadding[64];
+        // Pushed to and taken from by the owner only.
+        std::atomic<long> mBottom;
+        std::unique_ptr< std::atomic<unsigned>[] > mSlots;
+        size_t mNumSlots;
+
+        std::vector<BaseTopic*> mPublishedTopics;
+        std::vector<unsigned> mNewlyReady;
+    };
+
+    static void WorkerJob(void* aContext, unsigned aWorkerIndex);
+
+    void CollectRegion(unsigned aInputIndex);
+    void PushReady(unsigned aWorkerIndex, const std::vector<unsigned>& arVertexIndices);
+    bool PopReady(unsigned aWorkerIndex, unsigned& arVertexIndex);
+    bool StealReady(unsigned aWorkerIndex, unsigned& arVertexIndex);
+    void Park(unsigned aWorkEpoch);
+    void WakeParked(bool aWakeAll);
+    void Execute(unsigned aWorkerIndex, unsigned aVertexIndex);
+    void Release(unsigned aVertexIndex, std::vector<unsigned>& arNewlyReady);
+
+    // Plan being run; only valid during Run()
+    const std::vector<Vertex*>* mpVertices;
+    const std::vector<Vertex::VertexType>* mpVertexTypes;
+    const std::vector<unsigned>* mpOutEdgeOffsets;
+    const std::vector<unsigned>* mpOutEdges;
+    const std::vector<unsigned>* mpGroups;
+
+    // Per vertex
+    unsigned mNumVertices;
+    std::unique_ptr< std::atomic<unsigned>[] > mPendingInputs;
+    std::unique_ptr< std::atomic<bool>[] > mTriggered;
+    std::unique_ptr< std::atomic<unsigned>[] > mCostEstimates;
+    std::vector<unsigned> mGroupSuccessors;
+    std::vector<unsigned> mRegionStamps;
+    unsigned mRegionStamp;
+
+    // Per group
+    std::vector<unsigned> mLastInGroup;
+    std::vector<unsigned> mLastInGroupStamps;
+
+    std::vector<unsigned> mRegion;
+    std::vector< std::unique_ptr<WorkerQueue> > mWorkers;
+    std::atomic<unsigned> mRemaining;
+
+    // Bumped whenever vertices are made ready or the evaluation is done.
+    std::atomic<unsigned> mWorkEpoch;
+    std::atomic<unsigned> mNumParked;
+    std::mutex mParkMutex;
+    std::condition_variable mWorkAvailable;
+};
+
+}
+
+#endif
+
+#endif // DETECTORGRAPH_INCLUDE_WORKSTEALINGEXECUTOR_HPP_
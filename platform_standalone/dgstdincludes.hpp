@@ -21,6 +21,7 @@
 
 #if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
 #include <utility>
+#include <type_traits>
 #endif
 
 #include "dgalternatives.hpp"
@@ -0,0 +1,250 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "concurrentinputqueue.hpp"
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT)
+
+#include "dgassert.hpp"
+
+#include <chrono>
+
+namespace DetectorGraph
+{
+
+namespace
+{
+    size_t RoundUpToPowerOfTwo(unsigned aValue)
+    {
+        size_t powerOfTwo = 1;
+        while (powerOfTwo < aValue)
+        {
+            powerOfTwo <<= 1;
+        }
+        return powerOfTwo;
+    }
+}
+
+ConcurrentInputQueue::ConcurrentInputQueue(unsigned aCapacity, InputOverflowPolicy aPolicy)
+: mCells(RoundUpToPowerOfTwo(aCapacity))
+, mMask(mCells.size() - 1)
+, mPadding0()
+, mEnqueuePosition(0)
+, mPadding1()
+, mDequeuePosition(0)
+, mConsumerWaiting(false)
+, mOverflowPolicy(aPolicy)
+, mNumBlockedProducers(0)
+, mNumDropped(0)
+, mNumRejected(0)
+, mHighWaterMark(0)
+{
+    DG_ASSERT(aPolicy != kDropOldestInput);
+
+    for (size_t i = 0; i < mCells.size(); ++i)
+    {
+        mCells[i].sequence.store(i, std::memory_order_relaxed);
+        mCells[i].record = NULL;
+    }
+}
+
+ConcurrentInputQueue::~ConcurrentInputQueue()
+{
+    while (Front() != NULL)
+    {
+        ReleaseFront();
+    }
+}
+
+size_t ConcurrentInputQueue::GetCapacity() const
+{
+    return mCells.size();
+}
+
+ConcurrentInputQueue::Cell* ConcurrentInputQueue::ClaimCell()
+{
+    size_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Cell& cell = mCells[position & mMask];
+        // Sequentially consistent along with the accesses in ReleaseFront()
+        // for kBlockProducer; the same as acquire on most platforms.
+        const size_t sequence = cell.sequence.load(std::memory_order_seq_cst);
+        const ptrdiff_t lag = static_cast<ptrdiff_t>(sequence - position);
+        if (lag == 0)
+        {
+            if (mEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                return &cell;
+            }
+        }
+        else if (lag < 0)
+        {
+            // The consumer hasn't freed this cell since the last lap: full.
+            return NULL;
+        }
+        else
+        {
+            // Another producer claimed this position first.
+            position = mEnqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+ConcurrentInputQueue::Cell* ConcurrentInputQueue::HandleOverflow()
+{
+    if (mOverflowPolicy != kBlockProducer)
+    {
+        if (mOverflowPolicy == kDropNewestInput)
+        {
+            mNumDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            mNumRejected.fetch_add(1, std::memory_order_relaxed);
+        }
+        return NULL;
+    }
+
+    std::unique_lock<std::mutex> lock(mBlockedProducersMutex);
+    mNumBlockedProducers.fetch_add(1, std::memory_order_seq_cst);
+    Cell* cell = ClaimCell();
+    while (cell == NULL)
+    {
+        mNotFull.wait(lock);
+        cell = ClaimCell();
+    }
+    mNumBlockedProducers.fetch_sub(1, std::memory_order_relaxed);
+    return cell;
+}
+
+void ConcurrentInputQueue::PublishCell(Cell* aCell)
+{
+    // Sequentially consistent along with the accesses in
+    // WaitUntilNotEmpty(): either the consumer sees the cell filled or we
+    // see it waiting (and wake it up).
+    aCell->sequence.store(aCell->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+    if (mConsumerWaiting.load(std::memory_order_seq_cst))
+    {
+        std::lock_guard<std::mutex> lock(mWaitMutex);
+        mNotEmpty.notify_one();
+    }
+}
+
+ConcurrentInputQueue::Record* ConcurrentInputQueue::Front()
+{
+    Cell& cell = mCells[mDequeuePosition & mMask];
+    if (cell.sequence.load(std::memory_order_seq_cst) != mDequeuePosition + 1)
+    {
+        return NULL;
+    }
+    return cell.record;
+}
+
+ErrorType ConcurrentInputQueue::TransferFront(Graph& aGraph)
+{
+    Record* record = Front();
+    DG_ASSERT(record != NULL);
+
+    const size_t depth = mEnqueuePosition.load(std::memory_order_relaxed) - mDequeuePosition;
+    if (depth > mHighWaterMark)
+    {
+        mHighWaterMark = depth;
+    }
+
+    const ErrorType r = record->Transfer(aGraph);
+    if (r != ErrorType_NoResource)
+    {
+        ReleaseFront();
+    }
+
+    return r;
+}
+
+void ConcurrentInputQueue::ReleaseFront()
+{
+    Cell& cell = mCells[mDequeuePosition & mMask];
+    if (static_cast<void*>(cell.record) == static_cast<void*>(cell.storage))
+    {
+        cell.record->~Record();
+    }
+    else
+    {
+        delete cell.record;
+    }
+    cell.record = NULL;
+
+    // Frees the cell for the producer of the next lap.
+    cell.sequence.store(mDequeuePosition + mMask + 1, std::memory_order_seq_cst);
+    mDequeuePosition++;
+
+    if (mNumBlockedProducers.load(std::memory_order_seq_cst) > 0)
+    {
+        std::lock_guard<std::mutex> lock(mBlockedProducersMutex);
+        mNotFull.notify_all();
+    }
+}
+
+bool ConcurrentInputQueue::IsEmpty()
+{
+    return Front() == NULL;
+}
+
+InputQueueStats ConcurrentInputQueue::GetStats() const
+{
+    InputQueueStats stats;
+    stats.depth = mEnqueuePosition.load(std::memory_order_relaxed) - mDequeuePosition;
+    stats.highWaterMark = (mHighWaterMark > stats.depth) ? mHighWaterMark : stats.depth;
+    stats.numDropped = mNumDropped.load(std::memory_order_relaxed);
+    stats.numRejected = mNumRejected.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void ConcurrentInputQueue::ResetStats()
+{
+    mHighWaterMark = mEnqueuePosition.load(std::memory_order_relaxed) - mDequeuePosition;
+    mNumDropped.store(0, std::memory_order_relaxed);
+    mNumRejected.store(0, std::memory_order_relaxed);
+}
+
+bool ConcurrentInputQueue::WaitUntilNotEmpty(unsigned aTimeoutMs)
+{
+    if (!IsEmpty())
+    {
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(mWaitMutex);
+    mConsumerWaiting.store(true, std::memory_order_seq_cst);
+
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(aTimeoutMs);
+    bool notEmpty = !IsEmpty();
+    while (!notEmpty)
+    {
+        if (mNotEmpty.wait_until(lock, deadline) == std::cv_status::timeout)
+        {
+            notEmpty = !IsEmpty();
+            break;
+        }
+        notEmpty = !IsEmpty();
+    }
+
+    mConsumerWaiting.store(false, std::memory_order_relaxed);
+    return notEmpty;
+}
+
+}
+
+#endif
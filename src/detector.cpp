@@ -30,7 +30,11 @@ Detector::~Detector()
     {
         mDispatchersContainer.GetDispatchers()[idx]->GetTopicVertex()->RemoveEdge(this);
     }
-    mOutEdges.clear();
+    // And the topics' in edges back to self
+    while (!mOutEdges.empty())
+    {
+        RemoveEdge(mOutEdges.front());
+    }
     mGraph->RemoveVertex(this);
 #endif
 }
@@ -0,0 +1,146 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "evaluationworkerpool.hpp"
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+
+namespace DetectorGraph
+{
+
+EvaluationWorkerPool::EvaluationWorkerPool(unsigned aNumWorkers)
+: mJob(NULL)
+, mContext(NULL)
+, mNumJobs(0)
+, mPendingJobs(0)
+, mActiveWorkers(0)
+, mBatchNumber(0)
+, mShutdown(false)
+, mNextJob(0)
+{
+    for (unsigned i = 0; i < aNumWorkers; ++i)
+    {
+        mWorkers.push_back(std::thread(&EvaluationWorkerPool::WorkerLoop, this));
+    }
+}
+
+EvaluationWorkerPool::~EvaluationWorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mShutdown = true;
+    }
+    mBatchStarted.notify_all();
+
+    for (std::vector<std::thread>::iterator workerIt = mWorkers.begin();
+        workerIt != mWorkers.end();
+        ++workerIt)
+    {
+        workerIt->join();
+    }
+}
+
+unsigned EvaluationWorkerPool::GetNumWorkers() const
+{
+    return static_cast<unsigned>(mWorkers.size());
+}
+
+void EvaluationWorkerPool::Run(Job aJob, void* aContext, unsigned aNumJobs)
+{
+    {
+        // Workers that joined the previous batch late may still be about to
+        // look for more jobs on it; they must be done before it's replaced.
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (mActiveWorkers != 0)
+        {
+            mBatchDone.wait(lock);
+        }
+
+        mJob = aJob;
+        mContext = aContext;
+        mNumJobs = aNumJobs;
+        mPendingJobs = aNumJobs;
+        mNextJob = 0;
+        mBatchNumber++;
+    }
+    mBatchStarted.notify_all();
+
+    while (RunNextJob(aJob, aContext, aNumJobs))
+    {
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (mPendingJobs != 0)
+    {
+        mBatchDone.wait(lock);
+    }
+}
+
+bool EvaluationWorkerPool::RunNextJob(Job aJob, void* aContext, unsigned aNumJobs)
+{
+    unsigned jobIndex = mNextJob.fetch_add(1);
+    if (jobIndex >= aNumJobs)
+    {
+        return false;
+    }
+
+    aJob(aContext, jobIndex);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (--mPendingJobs == 0)
+    {
+        mBatchDone.notify_all();
+    }
+    return true;
+}
+
+void EvaluationWorkerPool::WorkerLoop()
+{
+    unsigned long lastBatchNumber = 0;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+        while (!mShutdown && mBatchNumber == lastBatchNumber)
+        {
+            mBatchStarted.wait(lock);
+        }
+
+        if (mShutdown)
+        {
+            return;
+        }
+
+        lastBatchNumber = mBatchNumber;
+        Job job = mJob;
+        void* context = mContext;
+        unsigned numJobs = mNumJobs;
+        mActiveWorkers++;
+
+        lock.unlock();
+        while (RunNextJob(job, context, numJobs))
+        {
+        }
+        lock.lock();
+
+        if (--mActiveWorkers == 0)
+        {
+            mBatchDone.notify_all();
+        }
+    }
+}
+
+}
+
+#endif
@@ -17,12 +17,28 @@
 #include "dglogging.hpp"
 #include "dgassert.hpp"
 
+#if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
+#include <algorithm>
+#include <functional>
+#endif
+
 namespace DetectorGraph
 {
 
 Graph::Graph()
+ : mEvaluationEpoch(0)
 #if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
- : mNeedsSorting(false)
+ , mNeedsSorting(false)
+ , mNeedsCompiling(false)
+ , mOutputListStale(false)
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+ , mWorkerPool(NULL)
+ , mWorkStealingExecutor(NULL)
+#endif
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT)
+ , mConcurrentInputQueue(NULL)
+#endif
+ , mOutputFilter(kOutputAllTopics)
 #endif
 {
     DG_LOG("Graph Initialized");
@@ -52,14 +68,31 @@ Graph::~Graph()
         vertexIt++;
         delete tmp;
     }
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+    delete mWorkerPool;
+    delete mWorkStealingExecutor;
+#endif
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT)
+    delete mConcurrentInputQueue;
+#endif
 #endif
 }
 
 void Graph::AddVertex(Vertex* aVertex)
 {
     mVertices.push_back(aVertex);
+    aVertex->SetEvaluationEpochSource(&mEvaluationEpoch);
 #if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
-    mNeedsSorting = true;
+    if (!mNeedsSorting)
+    {
+        // Appending is always valid for a vertex without edges; any edges it
+        // has (or gets until the next evaluation) are merged in later.
+        aVertex->SetTopoOrder(static_cast<unsigned>(mPlanVertices.size()));
+        mPlanVertices.push_back(aVertex);
+        mPendingVertices.push_back(aVertex);
+        mNeedsCompiling = true;
+    }
 #endif
 #if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_INSTRUMENT_RESOURCE_USAGE)
     DG_LOG("Added Vertex (total=%u)", mVertices.size());
@@ -73,7 +106,24 @@ void Graph::RemoveVertex(Vertex* aVertex)
     DG_LOG("dummy RemoveVertex called for %p.", (void*)aVertex);
 #else
     mVertices.remove(aVertex);
-    mNeedsSorting = true;
+    aVertex->SetEvaluationEpochSource(NULL);
+    mPublishedTopics.erase(
+        std::remove(mPublishedTopics.begin(), mPublishedTopics.end(), aVertex),
+        mPublishedTopics.end());
+    mFilteredOutputTopics.erase(
+        std::remove(mFilteredOutputTopics.begin(), mFilteredOutputTopics.end(), aVertex),
+        mFilteredOutputTopics.end());
+    mGraphInputQueue.RemoveTopic(aVertex);
+
+    // Removing a vertex never invalidates the order of the remaining ones.
+    if (IsInPlan(aVertex))
+    {
+        mPlanVertices[aVertex->GetTopoOrder()] = NULL;
+    }
+    mPendingVertices.erase(
+        std::remove(mPendingVertices.begin(), mPendingVertices.end(), aVertex),
+        mPendingVertices.end());
+    mNeedsCompiling = true;
 #endif
 }
 
@@ -96,9 +146,97 @@ bool Graph::EvaluateIfHasDataPending()
 
 bool Graph::HasDataPending()
 {
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT)
+    if (mConcurrentInputQueue != NULL && !mConcurrentInputQueue->IsEmpty())
+    {
+        return true;
+    }
+#endif
     return !mGraphInputQueue.IsEmpty();
 }
 
+#if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
+void Graph::SetInputQueueCapacity(size_t aCapacity, InputOverflowPolicy aPolicy)
+{
+    mGraphInputQueue.SetCapacity(aCapacity, (aPolicy == kBlockProducer) ? kRejectNewInput : aPolicy);
+}
+
+InputQueueStats Graph::GetInputQueueStats() const
+{
+    return mGraphInputQueue.GetStats();
+}
+
+void Graph::ResetInputQueueStats()
+{
+    mGraphInputQueue.ResetStats();
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT)
+    if (mConcurrentInputQueue != NULL)
+    {
+        mConcurrentInputQueue->ResetStats();
+    }
+#endif
+}
+#endif
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT)
+void Graph::EnableConcurrentInput(unsigned aCapacity, InputOverflowPolicy aPolicy)
+{
+    delete mConcurrentInputQueue;
+    mConcurrentInputQueue = NULL;
+
+    if (aCapacity > 0)
+    {
+        mConcurrentInputQueue = new ConcurrentInputQueue(aCapacity,
+            (aPolicy == kDropOldestInput) ? kRejectNewInput : aPolicy);
+    }
+}
+
+InputQueueStats Graph::GetConcurrentInputQueueStats() const
+{
+    if (mConcurrentInputQueue == NULL)
+    {
+        return InputQueueStats();
+    }
+    return mConcurrentInputQueue->GetStats();
+}
+
+bool Graph::WaitForDataPending(unsigned aTimeoutMs)
+{
+    if (HasDataPending())
+    {
+        return true;
+    }
+
+    if (mConcurrentInputQueue == NULL)
+    {
+        return false;
+    }
+
+    return mConcurrentInputQueue->WaitUntilNotEmpty(aTimeoutMs);
+}
+
+void Graph::TransferConcurrentInputs()
+{
+    if (mConcurrentInputQueue == NULL)
+    {
+        return;
+    }
+
+    // At least one per evaluation; more while few inputs are pending.
+    const size_t maxPending = mConcurrentInputQueue->GetCapacity();
+    bool transferred = false;
+    while (mConcurrentInputQueue->Front() != NULL &&
+        (!transferred || mGraphInputQueue.GetStats().depth < maxPending))
+    {
+        if (mConcurrentInputQueue->TransferFront(*this) != ErrorType_Success)
+        {
+            break;
+        }
+        transferred = true;
+    }
+}
+#endif
+
 TopicRegistry& Graph::GetTopicRegistry()
 {
     return mTopicRegistry;
@@ -107,15 +245,25 @@ TopicRegistry& Graph::GetTopicRegistry()
 ErrorType Graph::ClearTraverseContexts()
 {
     ErrorType r = ErrorType_Success;
-    for (VertexPtrContainer::iterator vertexIt = mVertices.begin();
-    vertexIt != mVertices.end();
-    ++vertexIt)
+
+    // States stamped with any other epoch now read as kVertexClear.
+    mEvaluationEpoch++;
+
+    if (mEvaluationEpoch == 0)
     {
-        (*vertexIt)->SetState(Vertex::kVertexClear);
+        // On wrap-around, vertices untouched for exactly 2^32 epochs would
+        // look current again; re-stamp everyone instead.
+        for (VertexPtrContainer::iterator vertexIt = mVertices.begin();
+        vertexIt != mVertices.end();
+        ++vertexIt)
+        {
+            (*vertexIt)->SetState(Vertex::kVertexClear);
+        }
     }
     return r;
 }
 
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
 ErrorType Graph::TraverseVertices()
 {
     ErrorType r = ErrorType_Success;
@@ -129,26 +277,366 @@ ErrorType Graph::TraverseVertices()
 
     return r;
 }
+#else
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+namespace
+{
+    // Orders the frontier by dependency level first so that a whole level
+    // is popped before any vertex of the next one. Also a min-heap.
+    struct LaterInSchedule
+    {
+        LaterInSchedule(const std::vector<unsigned>& aLevels) : mLevels(aLevels) {}
+        bool operator()(unsigned lhs, unsigned rhs) const
+        {
+            return (mLevels[lhs] != mLevels[rhs]) ? (mLevels[lhs] > mLevels[rhs]) : (lhs > rhs);
+        }
+        const std::vector<unsigned>& mLevels;
+    };
 
-ErrorType Graph::EvaluateGraph()
+    struct InGroupOrder
+    {
+        InGroupOrder(const std::vector<unsigned>& aGroups) : mGroups(aGroups) {}
+        bool operator()(unsigned lhs, unsigned rhs) const
+        {
+            return (mGroups[lhs] != mGroups[rhs]) ? (mGroups[lhs] < mGroups[rhs]) : (lhs < rhs);
+        }
+        const std::vector<unsigned>& mGroups;
+    };
+
+    struct DetectorBatch
+    {
+        Vertex* const* mVertices;
+        const unsigned* mDetectors;
+        const unsigned* mTaskOffsets;
+    };
+
+    // Each task is a serialization group's Detectors, in plan order.
+    void RunDetectorTask(void* aContext, unsigned aTaskIndex)
+    {
+        const DetectorBatch* batch = static_cast<const DetectorBatch*>(aContext);
+        for (unsigned idx = batch->mTaskOffsets[aTaskIndex];
+            idx < batch->mTaskOffsets[aTaskIndex + 1];
+            ++idx)
+        {
+            batch->mVertices[batch->mDetectors[idx]]->ProcessVertex();
+        }
+    }
+
+    unsigned FindGroup(std::vector<unsigned>& aParents, unsigned aIndex)
+    {
+        while (aParents[aIndex] != aIndex)
+        {
+            aParents[aIndex] = aParents[aParents[aIndex]];
+            aIndex = aParents[aIndex];
+        }
+        return aIndex;
+    }
+
+    void MergeGroups(std::vector<unsigned>& aParents, unsigned aIndexA, unsigned aIndexB)
+    {
+        unsigned groupA = FindGroup(aParents, aIndexA);
+        unsigned groupB = FindGroup(aParents, aIndexB);
+        aParents[std::max(groupA, groupB)] = std::min(groupA, groupB);
+    }
+}
+#endif
+
+void Graph::ScheduleVertex(unsigned aPlanIndex)
+{
+    mFrontier.push_back(aPlanIndex);
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+    if (mWorkerPool != NULL)
+    {
+        std::push_heap(mFrontier.begin(), mFrontier.end(), LaterInSchedule(mPlanLevels));
+        return;
+    }
+#endif
+    // std::*_heap build max-heaps; std::greater makes this a min-heap.
+    std::push_heap(mFrontier.begin(), mFrontier.end(), std::greater<unsigned>());
+}
+
+ErrorType Graph::TraverseVertices()
 {
     ErrorType r = ErrorType_Success;
 
-#if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
-    if (mNeedsSorting)
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+    if (mWorkStealingExecutor != NULL)
     {
-        r = TopoSortGraph();
-        if (r != ErrorType_Success)
+        if (!mFrontier.empty())
         {
-            DG_LOG("Graph::TopoSortGraph() failed");
-            return r;
+            // The frontier only ever holds the input topic at this point.
+            unsigned inputIndex = mFrontier.front();
+            mFrontier.clear();
+            mWorkStealingExecutor->Run(*mWorkerPool, mPlanVertices, mPlanVertexTypes,
+                mPlanOutEdgeOffsets, mPlanOutEdges, mPlanGroups, inputIndex, mPublishedTopics);
+        }
+        return r;
+    }
+    else if (mWorkerPool != NULL)
+    {
+        return TraverseVerticesInParallel();
+    }
+#endif
+
+    unsigned previousIndex = static_cast<unsigned>(mPlanVertices.size());
+    while (!mFrontier.empty())
+    {
+        std::pop_heap(mFrontier.begin(), mFrontier.end(), std::greater<unsigned>());
+        unsigned vIndex = mFrontier.back();
+        mFrontier.pop_back();
+
+        // A vertex scheduled by more than one parent comes out of the heap
+        // multiple times, but always back-to-back.
+        if (vIndex == previousIndex)
+        {
+            continue;
+        }
+        previousIndex = vIndex;
+
+        Vertex* v = mPlanVertices[vIndex];
+        v->ProcessVertex();
+        if (mPlanVertexTypes[vIndex] == Vertex::kTopicVertex)
+        {
+            mPublishedTopics.push_back(static_cast<BaseTopic*>(v));
+        }
+
+        ScheduleOutEdges(vIndex);
+    }
+
+    return r;
+}
+
+void Graph::ScheduleOutEdges(unsigned aPlanIndex)
+{
+    // Topics mark their subscribers and Detectors mark the topics they
+    // published to; only those need visiting.
+    for (unsigned edgeIndex = mPlanOutEdgeOffsets[aPlanIndex];
+        edgeIndex < mPlanOutEdgeOffsets[aPlanIndex + 1];
+        ++edgeIndex)
+    {
+        unsigned outIndex = mPlanOutEdges[edgeIndex];
+        if (mPlanVertices[outIndex]->GetState() == Vertex::kVertexProcessing)
+        {
+            ScheduleVertex(outIndex);
+        }
+    }
+}
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+void Graph::SetParallelEvaluation(unsigned aNumWorkerThreads, ParallelScheduling aScheduling)
+{
+    delete mWorkerPool;
+    mWorkerPool = NULL;
+    delete mWorkStealingExecutor;
+    mWorkStealingExecutor = NULL;
+    if (aNumWorkerThreads > 0)
+    {
+        mWorkerPool = new EvaluationWorkerPool(aNumWorkerThreads);
+        if (aScheduling == kWorkStealing)
+        {
+            mWorkStealingExecutor = new WorkStealingExecutor();
+        }
+    }
+    mNeedsCompiling = true;
+}
+
+ErrorType Graph::TraverseVerticesInParallel()
+{
+    ErrorType r = ErrorType_Success;
+    LaterInSchedule laterInSchedule(mPlanLevels);
+
+    // Detectors are held back until their whole level has been popped.
+    unsigned previousIndex = static_cast<unsigned>(mPlanVertices.size());
+    mDetectorBatch.clear();
+    while (!mFrontier.empty() || !mDetectorBatch.empty())
+    {
+        if (!mDetectorBatch.empty() &&
+            (mFrontier.empty() || mPlanLevels[mFrontier.front()] != mPlanLevels[mDetectorBatch.front()]))
+        {
+            RunDetectorBatch();
+            for (std::vector<unsigned>::iterator detectorIt = mDetectorBatch.begin();
+                detectorIt != mDetectorBatch.end();
+                ++detectorIt)
+            {
+                ScheduleOutEdges(*detectorIt);
+            }
+            mDetectorBatch.clear();
+            continue;
+        }
+
+        std::pop_heap(mFrontier.begin(), mFrontier.end(), laterInSchedule);
+        unsigned vIndex = mFrontier.back();
+        mFrontier.pop_back();
+
+        if (vIndex == previousIndex)
+        {
+            continue;
+        }
+        previousIndex = vIndex;
+
+        if (mPlanVertexTypes[vIndex] == Vertex::kDetectorVertex)
+        {
+            mDetectorBatch.push_back(vIndex);
+            continue;
+        }
+
+        Vertex* v = mPlanVertices[vIndex];
+        v->ProcessVertex();
+        if (mPlanVertexTypes[vIndex] == Vertex::kTopicVertex)
+        {
+            mPublishedTopics.push_back(static_cast<BaseTopic*>(v));
+        }
+
+        ScheduleOutEdges(vIndex);
+    }
+
+    return r;
+}
+
+void Graph::RunDetectorBatch()
+{
+    if (mDetectorBatch.size() == 1)
+    {
+        mPlanVertices[mDetectorBatch.front()]->ProcessVertex();
+        return;
+    }
+
+    std::sort(mDetectorBatch.begin(), mDetectorBatch.end(), InGroupOrder(mPlanGroups));
+
+    mDetectorBatchTaskOffsets.clear();
+    for (unsigned idx = 0; idx < mDetectorBatch.size(); ++idx)
+    {
+        if (idx == 0 || mPlanGroups[mDetectorBatch[idx]] != mPlanGroups[mDetectorBatch[idx - 1]])
+        {
+            mDetectorBatchTaskOffsets.push_back(idx);
+        }
+    }
+    mDetectorBatchTaskOffsets.push_back(static_cast<unsigned>(mDetectorBatch.size()));
+
+    DetectorBatch batch;
+    batch.mVertices = &mPlanVertices[0];
+    batch.mDetectors = &mDetectorBatch[0];
+    batch.mTaskOffsets = &mDetectorBatchTaskOffsets[0];
+
+    unsigned numTasks = static_cast<unsigned>(mDetectorBatchTaskOffsets.size() - 1);
+    if (numTasks == 1)
+    {
+        RunDetectorTask(&batch, 0);
+    }
+    else
+    {
+        mWorkerPool->Run(&RunDetectorTask, &batch, numTasks);
+    }
+}
+
+void Graph::CompileParallelPlan()
+{
+    const unsigned numVertices = static_cast<unsigned>(mPlanVertices.size());
+
+    mPlanLevels.assign(numVertices, 0);
+    mPlanGroups.resize(numVertices);
+    for (unsigned vIndex = 0; vIndex < numVertices; ++vIndex)
+    {
+        mPlanGroups[vIndex] = vIndex;
+    }
+
+    std::vector<unsigned> topicPublishers(numVertices, numVertices);
+    unsigned futurePublisher = numVertices;
+    for (unsigned vIndex = 0; vIndex < numVertices; ++vIndex)
+    {
+        bool isDetector = (mPlanVertexTypes[vIndex] == Vertex::kDetectorVertex);
+        for (unsigned edgeIndex = mPlanOutEdgeOffsets[vIndex];
+            edgeIndex < mPlanOutEdgeOffsets[vIndex + 1];
+            ++edgeIndex)
+        {
+            unsigned outIndex = mPlanOutEdges[edgeIndex];
+            mPlanLevels[outIndex] = std::max(mPlanLevels[outIndex], mPlanLevels[vIndex] + 1);
+
+            // Topics aren't thread-safe; all their publishers share a group.
+            if (isDetector)
+            {
+                if (topicPublishers[outIndex] == numVertices)
+                {
+                    topicPublishers[outIndex] = vIndex;
+                }
+                else
+                {
+                    MergeGroups(mPlanGroups, vIndex, topicPublishers[outIndex]);
+                }
+            }
+        }
+
+        // Neither is the GraphInputQueue nor the TimeoutPublisherService.
+        if (isDetector && !mPlanVertices[vIndex]->GetFutureOutEdges().empty())
+        {
+            if (futurePublisher == numVertices)
+            {
+                futurePublisher = vIndex;
+            }
+            else
+            {
+                MergeGroups(mPlanGroups, vIndex, futurePublisher);
+            }
         }
     }
+
+    for (unsigned vIndex = 0; vIndex < numVertices; ++vIndex)
+    {
+        mPlanGroups[vIndex] = FindGroup(mPlanGroups, vIndex);
+    }
+
+    if (mWorkStealingExecutor != NULL)
+    {
+        mWorkStealingExecutor->Reset(numVertices);
+    }
+}
+#endif
+
+ErrorType Graph::ClearPublishedTopics()
+{
+    ErrorType r = ErrorType_Success;
+    for (std::vector<BaseTopic*>::iterator topicIt = mPublishedTopics.begin();
+        topicIt != mPublishedTopics.end();
+        ++topicIt)
+    {
+        (*topicIt)->ClearCurrentValues();
+    }
+    mPublishedTopics.clear();
+    return r;
+}
+#endif
+
+ErrorType Graph::EvaluateGraph()
+{
+    ErrorType r = ErrorType_Success;
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT)
+    TransferConcurrentInputs();
+#endif
+
+#if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
+    r = UpdateTopoSort();
+    if (r != ErrorType_Success)
+    {
+        DG_LOG("Graph::TopoSortGraph() failed");
+        return r;
+    }
 #endif
 
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
     ClearTraverseContexts();
 
     mGraphInputQueue.DequeueAndDispatch();
+#else
+    ClearTraverseContexts();
+    ClearPublishedTopics();
+
+    Vertex* inputTopic = mGraphInputQueue.DequeueAndDispatch();
+    if (inputTopic != NULL)
+    {
+        ScheduleVertex(inputTopic->GetTopoOrder());
+    }
+#endif
 
     r = TraverseVertices();
     if (r != ErrorType_Success) // LCOV_EXCL_START // Dead code for future-proofness
@@ -158,10 +646,10 @@ ErrorType Graph::EvaluateGraph()
     } // LCOV_EXCL_STOP
 
 #if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
-    r = ComposeOutputList();
+    r = ComposeOutputView();
     if (r != ErrorType_Success) // LCOV_EXCL_START // Dead code for future-proofness
     {
-        DG_LOG("Graph::ComposeOutputList() failed");
+        DG_LOG("Graph::ComposeOutputView() failed");
         return r;
     } // LCOV_EXCL_STOP
 #endif
@@ -219,19 +707,207 @@ bool Graph::IsGraphSorted()
 #else
 // FULL_BEGIN
 
+ErrorType Graph::UpdateTopoSort()
+{
+    ErrorType r = ErrorType_Success;
+
+    if (!mNeedsSorting && mNeedsCompiling)
+    {
+        // Merging edges one by one only pays off for small changes (e.g. a
+        // detector added at runtime); a graph built from scratch is sorted in
+        // one go. Anything unexpected is left for the full sort to report.
+        if (!mPendingVertices.empty() &&
+            (2 * mPendingVertices.size() > mPlanVertices.size() ||
+             InsertPendingVertices() != ErrorType_Success))
+        {
+            mNeedsSorting = true;
+        }
+        else if (CompilePlan() != ErrorType_Success)
+        {
+            mNeedsSorting = true;
+        }
+    }
+
+    if (mNeedsSorting)
+    {
+        r = TopoSortGraph();
+    }
+
+    return r;
+}
+
+ErrorType Graph::InsertPendingVertices()
+{
+    ErrorType r = ErrorType_Success;
+
+    for (std::vector<Vertex*>::iterator vertexIt = mPendingVertices.begin();
+        vertexIt != mPendingVertices.end();
+        ++vertexIt)
+    {
+        Vertex* v = *vertexIt;
+        for (Vertex::VertexPtrContainer::iterator outEdgeIt = v->GetOutEdges().begin();
+            outEdgeIt != v->GetOutEdges().end();
+            ++outEdgeIt)
+        {
+            if (!IsInPlan(*outEdgeIt))
+            {
+                // Out of bounds edge; left for TopoSortGraph() to report.
+                return ErrorType_BadConfiguration;
+            }
+
+            r = InsertEdgeIntoOrder(v, *outEdgeIt);
+            if (r != ErrorType_Success)
+            {
+                return r;
+            }
+        }
+
+        // Edges coming from outside the graph are ignored, as in the full sort.
+        for (Vertex::VertexPtrContainer::iterator inEdgeIt = v->GetInEdges().begin();
+            inEdgeIt != v->GetInEdges().end();
+            ++inEdgeIt)
+        {
+            if (IsInPlan(*inEdgeIt))
+            {
+                r = InsertEdgeIntoOrder(*inEdgeIt, v);
+                if (r != ErrorType_Success)
+                {
+                    return r;
+                }
+            }
+        }
+    }
+    mPendingVertices.clear();
+
+    return r;
+}
+
+namespace
+{
+    struct EarlierInTopoOrder
+    {
+        bool operator()(const Vertex* lhs, const Vertex* rhs) const
+        {
+            return lhs->GetTopoOrder() < rhs->GetTopoOrder();
+        }
+    };
+}
+
+ErrorType Graph::InsertEdgeIntoOrder(Vertex* aFrom, Vertex* aTo)
+{
+    ErrorType r = ErrorType_Success;
+
+    const unsigned lowerBound = aTo->GetTopoOrder();
+    const unsigned upperBound = aFrom->GetTopoOrder();
+    if (lowerBound > upperBound)
+    {
+        return r;
+    }
+
+    // Marks vertices reached forward from aTo as kVertexProcessing and
+    // backward from aFrom as kVertexDone.
+    ClearTraverseContexts();
+
+    // Everything downstream of aTo that is currently ordered before aFrom.
+    std::vector<Vertex*> forward;
+    forward.push_back(aTo);
+    aTo->SetState(Vertex::kVertexProcessing);
+    for (size_t idx = 0; idx < forward.size(); ++idx)
+    {
+        Vertex::VertexPtrContainer& outEdges = forward[idx]->GetOutEdges();
+        for (Vertex::VertexPtrContainer::iterator outEdgeIt = outEdges.begin();
+            outEdgeIt != outEdges.end();
+            ++outEdgeIt)
+        {
+            Vertex* w = *outEdgeIt;
+            if (w == aFrom)
+            {
+                DG_LOG("Cycle at: %s", aFrom->GetName());
+                return ErrorType_BadConfiguration;
+            }
+            if (!IsInPlan(w))
+            {
+                return ErrorType_BadConfiguration;
+            }
+            if (w->GetTopoOrder() < upperBound && w->GetState() == Vertex::kVertexClear)
+            {
+                w->SetState(Vertex::kVertexProcessing);
+                forward.push_back(w);
+            }
+        }
+    }
+
+    // Everything upstream of aFrom that is currently ordered after aTo.
+    std::vector<Vertex*> backward;
+    backward.push_back(aFrom);
+    aFrom->SetState(Vertex::kVertexDone);
+    for (size_t idx = 0; idx < backward.size(); ++idx)
+    {
+        Vertex::VertexPtrContainer& inEdges = backward[idx]->GetInEdges();
+        for (Vertex::VertexPtrContainer::iterator inEdgeIt = inEdges.begin();
+            inEdgeIt != inEdges.end();
+            ++inEdgeIt)
+        {
+            Vertex* u = *inEdgeIt;
+            if (u->GetTopoOrder() > lowerBound && u->GetState() == Vertex::kVertexClear &&
+                IsInPlan(u))
+            {
+                u->SetState(Vertex::kVertexDone);
+                backward.push_back(u);
+            }
+        }
+    }
+
+    // Both sets keep their relative order, but all of the upstream set now
+    // goes before all of the downstream set, using the same slots as before.
+    std::sort(forward.begin(), forward.end(), EarlierInTopoOrder());
+    std::sort(backward.begin(), backward.end(), EarlierInTopoOrder());
+
+    std::vector<unsigned> slots;
+    slots.reserve(forward.size() + backward.size());
+    for (size_t idx = 0; idx < backward.size(); ++idx)
+    {
+        slots.push_back(backward[idx]->GetTopoOrder());
+    }
+    for (size_t idx = 0; idx < forward.size(); ++idx)
+    {
+        slots.push_back(forward[idx]->GetTopoOrder());
+    }
+    std::sort(slots.begin(), slots.end());
+
+    backward.insert(backward.end(), forward.begin(), forward.end());
+    for (size_t idx = 0; idx < backward.size(); ++idx)
+    {
+        backward[idx]->SetTopoOrder(slots[idx]);
+        mPlanVertices[slots[idx]] = backward[idx];
+    }
+
+    mNeedsCompiling = true;
+    return r;
+}
+
+bool Graph::IsInPlan(const Vertex* aVertex) const
+{
+    return aVertex->GetTopoOrder() < mPlanVertices.size() &&
+        mPlanVertices[aVertex->GetTopoOrder()] == aVertex;
+}
+
 ErrorType Graph::TopoSortGraph()
 {
     ErrorType r = ErrorType_Success;
     // SORT
 
+    // Until this succeeds the current order can't be trusted.
+    mNeedsSorting = true;
+
     // Clean graph-search context
     ClearTraverseContexts();
 
-    std::list<Vertex*> sorted;
+    std::vector<Vertex*> postOrder;
+    postOrder.reserve(mVertices.size());
 
     size_t numVertices = mVertices.size();
 
-    // cout << "--- TOPOSORT START ---" << endl;
     // DFS starting on any random vertex and repeating for other undiscovered
     // vertices
     for (std::list<Vertex*>::iterator vertexIt = mVertices.begin();
@@ -240,17 +916,15 @@ ErrorType Graph::TopoSortGraph()
     {
         if ((*vertexIt)->GetState() == Vertex::kVertexClear)
         {
-            // cout << "TOP DFS_visit" << endl;
-            r = DFS_visit(*vertexIt, sorted);
+            r = DFS_visit(*vertexIt, postOrder);
             if (r != ErrorType_Success)
             {
                 return r;
             }
         }
     }
-    // cout << "--- TOPOSORT END ---" << endl;
 
-    if (sorted.size() != numVertices)
+    if (postOrder.size() != numVertices)
     {
         // Tree structure is inconsistent.
         // This probably means that a vertex 'm' pointed to
@@ -265,78 +939,184 @@ ErrorType Graph::TopoSortGraph()
     }
 
     // Save sorted vertices
-    mVertices = sorted;
+    mPlanVertices.assign(postOrder.rbegin(), postOrder.rend());
+    mPendingVertices.clear();
     mNeedsSorting = false;
 
+    // Leave no vertex marked by the search.
+    ClearTraverseContexts();
+
+    r = CompilePlan();
+
     return r;
 }
 
-ErrorType Graph::DFS_visit(Vertex* v, std::list<Vertex*>& sorted)
+ErrorType Graph::CompilePlan()
 {
     ErrorType r = ErrorType_Success;
 
-    // cout << "---> Starting at " << v->GetName() << " that has " << v->GetOutEdges().size() << " out edges " << endl;
-    v->SetState(Vertex::kVertexProcessing);
-    for (std::list<Vertex*>::iterator vIt = v->GetOutEdges().begin();
-        vIt != v->GetOutEdges().end();
-        ++vIt)
+    // Squeeze out holes left by removed vertices.
+    mPlanVertices.erase(
+        std::remove(mPlanVertices.begin(), mPlanVertices.end(), static_cast<Vertex*>(NULL)),
+        mPlanVertices.end());
+    mVertices.assign(mPlanVertices.begin(), mPlanVertices.end());
+
+    mPlanVertexTypes.resize(mPlanVertices.size());
+    for (unsigned vIndex = 0; vIndex < mPlanVertices.size(); ++vIndex)
     {
-        // cout << "Examining edge from " << v->GetName() << " to " << (*vIt)->GetName() << endl;
-        if ((*vIt)->GetState() == Vertex::kVertexClear)
+        mPlanVertices[vIndex]->SetTopoOrder(vIndex);
+        mPlanVertexTypes[vIndex] = mPlanVertices[vIndex]->GetVertexType();
+    }
+
+    // Out-edges can only be translated once every vertex knows its index.
+    mPlanOutEdgeOffsets.resize(mPlanVertices.size() + 1);
+    mPlanOutEdges.clear();
+    for (unsigned vIndex = 0; vIndex < mPlanVertices.size(); ++vIndex)
+    {
+        mPlanOutEdgeOffsets[vIndex] = static_cast<unsigned>(mPlanOutEdges.size());
+
+        Vertex::VertexPtrContainer& outEdges = mPlanVertices[vIndex]->GetOutEdges();
+        for (Vertex::VertexPtrContainer::iterator outEdgeIt = outEdges.begin();
+            outEdgeIt != outEdges.end();
+            ++outEdgeIt)
         {
-            r = DFS_visit(*vIt, sorted);
-            if (r != ErrorType_Success)
+            if (!IsInPlan(*outEdgeIt))
             {
-                return r;
+                return ErrorType_BadConfiguration;
             }
+            mPlanOutEdges.push_back((*outEdgeIt)->GetTopoOrder());
+        }
+    }
+    mPlanOutEdgeOffsets[mPlanVertices.size()] = static_cast<unsigned>(mPlanOutEdges.size());
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+    if (mWorkerPool != NULL)
+    {
+        CompileParallelPlan();
+    }
+#endif
+    mNeedsCompiling = false;
+
+    return r;
+}
+
+ErrorType Graph::DFS_visit(Vertex* v, std::vector<Vertex*>& postOrder)
+{
+    ErrorType r = ErrorType_Success;
+
+    typedef std::pair<Vertex*, Vertex::VertexPtrContainer::iterator> StackFrame;
+    std::vector<StackFrame> stack;
+
+    v->SetState(Vertex::kVertexProcessing);
+    stack.push_back(StackFrame(v, v->GetOutEdges().begin()));
+    while (!stack.empty())
+    {
+        Vertex* current = stack.back().first;
+        Vertex::VertexPtrContainer::iterator& vIt = stack.back().second;
+
+        if (vIt == current->GetOutEdges().end())
+        {
+            current->SetState(Vertex::kVertexDone);
+            postOrder.push_back(current);
+            stack.pop_back();
+            continue;
         }
-        else if ((*vIt)->GetState() == Vertex::kVertexProcessing)
+
+        Vertex* next = *vIt;
+        ++vIt;
+
+        if (next->GetState() == Vertex::kVertexClear)
+        {
+            next->SetState(Vertex::kVertexProcessing);
+            stack.push_back(StackFrame(next, next->GetOutEdges().begin()));
+        }
+        else if (next->GetState() == Vertex::kVertexProcessing)
         {
             DG_LOG("--------------------------------------");
             DG_LOG("------------CYCLE DETECTED------------");
             DG_LOG("---------- Will Ignore edge ----------");
             DG_LOG("--------------------------------------");
-            DG_LOG("Cycle at: %s", (*vIt)->GetName());
+            DG_LOG("Cycle at: %s", next->GetName());
             r = ErrorType_BadConfiguration;
-            if (r != ErrorType_Success)
-            {
-                return r;
-            }
-        } // LCOV_EXCL_LINE
+            return r;
+        }
         //v2 - do nothing.
     }
-    // cout << "<--- Finished at " << v->GetName() << endl;
-    v->SetState(Vertex::kVertexDone);
-    sorted.push_front(v);
 
     return r;
 }
 
-ErrorType Graph::ComposeOutputList()
+ErrorType Graph::ComposeOutputView()
 {
     ErrorType r = ErrorType_Success;
 
-    mOutputList.clear();
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+    // Serial traversal settles Topics in plan order already; the parallel
+    // ones settle them in whatever order the workers finished.
+    if (mWorkerPool != NULL)
+    {
+        std::sort(mPublishedTopics.begin(), mPublishedTopics.end(), EarlierInTopoOrder());
+    }
+#endif
 
-    for (std::list< Vertex* >::iterator it = mVertices.begin();
-        it != mVertices.end();
-        ++it)
+    ApplyOutputFilter();
+
+    return r;
+} // LCOV_EXCL_LINE
+
+void Graph::ApplyOutputFilter()
+{
+    mFilteredOutputTopics.clear();
+    if (mOutputFilter == kOutputNamedTopicsOnly)
     {
-        if ( (*it)->GetVertexType() == Vertex::kTopicVertex)
+        for (std::vector<BaseTopic*>::const_iterator topicIt = mPublishedTopics.begin();
+            topicIt != mPublishedTopics.end();
+            ++topicIt)
         {
-            BaseTopic* tTopic = static_cast<BaseTopic*>(*it);
-            std::list< ptr::shared_ptr<const TopicState> > tTopicStates = tTopic->GetCurrentTopicStates();
-
-            //Pushes back entire list
-            mOutputList.insert(mOutputList.end(), tTopicStates.begin(), tTopicStates.end());
+            if ((*topicIt)->GetId() != TopicState::kAnonymousTopicState)
+            {
+                mFilteredOutputTopics.push_back(*topicIt);
+            }
         }
     }
 
-    return r;
-} // LCOV_EXCL_LINE
+    mOutputList.clear();
+    mOutputListStale = true;
+}
+
+const std::vector<BaseTopic*>& Graph::GetOutputTopics() const
+{
+    return (mOutputFilter == kOutputNamedTopicsOnly) ? mFilteredOutputTopics : mPublishedTopics;
+}
+
+void Graph::SetOutputFilter(OutputFilter aFilter)
+{
+    mOutputFilter = aFilter;
+    ApplyOutputFilter();
+}
+
+OutputView Graph::GetOutputView() const
+{
+    return OutputView(GetOutputTopics());
+}
 
 const std::list< ptr::shared_ptr<const TopicState> >& Graph::GetOutputList() const
 {
+    if (mOutputListStale)
+    {
+        const std::vector<BaseTopic*>& outputTopics = GetOutputTopics();
+        for (std::vector<BaseTopic*>::const_iterator topicIt = outputTopics.begin();
+            topicIt != outputTopics.end();
+            ++topicIt)
+        {
+            std::list< ptr::shared_ptr<const TopicState> > tTopicStates = (*topicIt)->GetCurrentTopicStates();
+
+            //Pushes back entire list
+            mOutputList.splice(mOutputList.end(), tTopicStates);
+        }
+        mOutputListStale = false;
+    }
+
     return mOutputList;
 }
 
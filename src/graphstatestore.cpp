@@ -14,40 +14,128 @@
 
 #include "graphstatestore.hpp"
 
+#include "dgassert.hpp"
+
+#include <algorithm>
+
 namespace DetectorGraph
 {
 
 GraphStateStore::GraphStateStore()
+: mStatesLookbackQueue()
+, mMaxNumSnapshots(kDefaultMaxNumSnapshots)
+, mMaxSizeInBytes(0)
+, mHistorySizeInBytes(0)
 {
     ptr::shared_ptr<const StateSnapshot> tZeroState = ptr::shared_ptr<const StateSnapshot>(new StateSnapshot());
-    mStatesLookbackQueue.push(tZeroState);
+    PushSnapshot(tZeroState, 0);
+}
+
+GraphStateStore::GraphStateStore(size_t aNumTopicStateIds)
+: mStatesLookbackQueue()
+, mMaxNumSnapshots(kDefaultMaxNumSnapshots)
+, mMaxSizeInBytes(0)
+, mHistorySizeInBytes(0)
+{
+    ptr::shared_ptr<const StateSnapshot> tZeroState = ptr::shared_ptr<const StateSnapshot>(new StateSnapshot(aNumTopicStateIds));
+    PushSnapshot(tZeroState, 0);
 }
 
 GraphStateStore::~GraphStateStore()
 {
 }
 
+void GraphStateStore::SetHistoryLimits(size_t aMaxNumSnapshots, size_t aMaxSizeInBytes)
+{
+    mMaxNumSnapshots = aMaxNumSnapshots;
+    mMaxSizeInBytes = aMaxSizeInBytes;
+    EvictOldSnapshots();
+}
+
 void GraphStateStore::TakeNewSnapshot(const std::list< ptr::shared_ptr<const TopicState> >& arTopicStates)
 {
-    // do it
-    ptr::shared_ptr<const StateSnapshot> newState;
+    // mStatesLookbackQueue is ensured to not be empty by the constructor.
+    TakeNewSnapshot(arTopicStates, mStatesLookbackQueue.back().mTimestamp);
+}
 
+void GraphStateStore::TakeNewSnapshot(const std::list< ptr::shared_ptr<const TopicState> >& arTopicStates, uint64_t aTimestamp)
+{
     // mStatesLookbackQueue is ensured to not be empty by the constructor.
-    newState = ptr::shared_ptr<const StateSnapshot>(new StateSnapshot(*(mStatesLookbackQueue.back()), arTopicStates));
+    DG_ASSERT(aTimestamp >= mStatesLookbackQueue.back().mTimestamp);
 
-    mStatesLookbackQueue.push(newState);
+    ptr::shared_ptr<const StateSnapshot> newState = ptr::shared_ptr<const StateSnapshot>(
+        new StateSnapshot(*(mStatesLookbackQueue.back().mSnapshot), arTopicStates));
 
-    const size_t MaxLookBack = 2;
-    if (mStatesLookbackQueue.size() > MaxLookBack)
-    {
-        mStatesLookbackQueue.pop();
-    }
+    PushSnapshot(newState, aTimestamp);
+    EvictOldSnapshots();
 }
 
 ptr::shared_ptr<const StateSnapshot> GraphStateStore::GetLastState() const
 {
     // mStatesLookbackQueue is ensured to not be empty by the constructor.
-    return mStatesLookbackQueue.back();
+    return mStatesLookbackQueue.back().mSnapshot;
+}
+
+ptr::shared_ptr<const StateSnapshot> GraphStateStore::GetStateByVersion(unsigned int aStateVersion) const
+{
+    // Versions are consecutive along the queue so this is a direct index.
+    const unsigned int oldestVersion = mStatesLookbackQueue.front().mSnapshot->GetStateVersion();
+    if (aStateVersion < oldestVersion || aStateVersion - oldestVersion >= mStatesLookbackQueue.size())
+    {
+        return ptr::shared_ptr<const StateSnapshot>();
+    }
+
+    return mStatesLookbackQueue[aStateVersion - oldestVersion].mSnapshot;
+}
+
+ptr::shared_ptr<const StateSnapshot> GraphStateStore::GetStateAtTime(uint64_t aTimestamp) const
+{
+    std::deque<HistoryEntry>::const_iterator firstNewer = std::upper_bound(
+        mStatesLookbackQueue.begin(), mStatesLookbackQueue.end(), aTimestamp, TimestampLess());
+    if (firstNewer == mStatesLookbackQueue.begin())
+    {
+        return ptr::shared_ptr<const StateSnapshot>();
+    }
+
+    return (firstNewer - 1)->mSnapshot;
+}
+
+size_t GraphStateStore::GetHistoryLength() const
+{
+    return mStatesLookbackQueue.size();
+}
+
+size_t GraphStateStore::GetHistorySizeInBytes() const
+{
+    return mHistorySizeInBytes;
+}
+
+void GraphStateStore::PushSnapshot(const ptr::shared_ptr<const StateSnapshot>& arSnapshot, uint64_t aTimestamp)
+{
+    // Only the oldest snapshot is counted in full; see EvictOldSnapshots.
+    mHistorySizeInBytes += mStatesLookbackQueue.empty() ?
+        arSnapshot->GetSizeInBytes() :
+        arSnapshot->GetDeltaSizeInBytes();
+
+    HistoryEntry entry = { arSnapshot, aTimestamp };
+    mStatesLookbackQueue.push_back(entry);
+}
+
+void GraphStateStore::EvictOldSnapshots()
+{
+    while (mStatesLookbackQueue.size() > 1 &&
+        (mStatesLookbackQueue.size() > mMaxNumSnapshots ||
+         (mMaxSizeInBytes > 0 && mHistorySizeInBytes > mMaxSizeInBytes)))
+    {
+        // Dropping the oldest frees roughly what the next one replaced - its
+        // delta - so the next one now counts in full.
+        mHistorySizeInBytes -= mStatesLookbackQueue.front().mSnapshot->GetSizeInBytes();
+        mStatesLookbackQueue.pop_front();
+
+        const StateSnapshot& newOldest = *(mStatesLookbackQueue.front().mSnapshot);
+        mHistorySizeInBytes -= newOldest.GetDeltaSizeInBytes();
+        mHistorySizeInBytes += newOldest.GetSizeInBytes();
+    }
 }
 
 }
@@ -17,28 +17,83 @@
 #include "dgassert.hpp"
 #include "dglogging.hpp"
 
+#include <algorithm>
+
 namespace DetectorGraph
 {
 
 StateSnapshot::StateSnapshot()
-: mStateStore()
+: mDenseStates()
+, mNumDenseIds(0)
+, mRoot()
+, mNumLevels(0)
+, mNumStates(0)
+, mNumTrieBranches(0)
+, mNumTrieLeaves(0)
+, mDeltaSizeInBytes(0)
+, mStateVersion(0)
+{
+    mDeltaSizeInBytes = GetSizeInBytes();
+}
+
+StateSnapshot::StateSnapshot(size_t aNumTopicStateIds)
+: mDenseStates(new DenseStates(aNumTopicStateIds))
+, mNumDenseIds(aNumTopicStateIds)
+, mRoot()
+, mNumLevels(0)
+, mNumStates(0)
+, mNumTrieBranches(0)
+, mNumTrieLeaves(0)
+, mDeltaSizeInBytes(0)
 , mStateVersion(0)
 {
+    mDeltaSizeInBytes = GetSizeInBytes();
 }
 
 StateSnapshot::StateSnapshot(const std::list< ptr::shared_ptr<const TopicState> >& arTopicStates)
-: mStateStore()
+: mDenseStates()
+, mNumDenseIds(0)
+, mRoot()
+, mNumLevels(0)
+, mNumStates(0)
+, mNumTrieBranches(0)
+, mNumTrieLeaves(0)
+, mDeltaSizeInBytes(0)
+, mStateVersion(0)
+{
+    UpdateValues(arTopicStates);
+    mDeltaSizeInBytes = GetSizeInBytes();
+}
+
+StateSnapshot::StateSnapshot(size_t aNumTopicStateIds, const std::list< ptr::shared_ptr<const TopicState> >& arTopicStates)
+: mDenseStates(new DenseStates(aNumTopicStateIds))
+, mNumDenseIds(aNumTopicStateIds)
+, mRoot()
+, mNumLevels(0)
+, mNumStates(0)
+, mNumTrieBranches(0)
+, mNumTrieLeaves(0)
+, mDeltaSizeInBytes(0)
 , mStateVersion(0)
 {
     UpdateValues(arTopicStates);
+    mDeltaSizeInBytes = GetSizeInBytes();
 }
 
 StateSnapshot::StateSnapshot(const StateSnapshot& arPreviousState, const std::list< ptr::shared_ptr<const TopicState> >& arTopicStates)
+// Sharing the previous storage is safe since it is never modified after
+// being built; UpdateValues copies whatever it changes.
+: mDenseStates(arPreviousState.mDenseStates)
+, mNumDenseIds(arPreviousState.mNumDenseIds)
+, mRoot(arPreviousState.mRoot)
+, mNumLevels(arPreviousState.mNumLevels)
+, mNumStates(arPreviousState.mNumStates)
+, mNumTrieBranches(arPreviousState.mNumTrieBranches)
+, mNumTrieLeaves(arPreviousState.mNumTrieLeaves)
+, mDeltaSizeInBytes(sizeof(StateSnapshot))
+, mStateVersion(arPreviousState.mStateVersion + 1)
 {
-    // by-value copy will do a shallow & safe copy of all ptr::shared_ptrs
-    mStateStore = arPreviousState.mStateStore;
     UpdateValues(arTopicStates);
-    mStateVersion = arPreviousState.mStateVersion + 1;
 }
 
 void StateSnapshot::UpdateValues(const std::list< ptr::shared_ptr<const TopicState> >& arTopicStates)
@@ -46,17 +101,22 @@ void StateSnapshot::UpdateValues(const std::list< ptr::shared_ptr<const TopicSta
     // Used for detection of consecutive/repeated named topics being published on the same evaluation
     TopicStateIdType previousTopicStateID = TopicState::kAnonymousTopicState;
 
+    std::vector<PendingValue> pendingValues;
+    pendingValues.reserve(arTopicStates.size());
+    DenseStates* newDenseStates = NULL;
+
     typedef std::list< ptr::shared_ptr<const TopicState> >::const_iterator TopicStatePointerIterator;
     for (TopicStatePointerIterator tDataIt = arTopicStates.begin();
         tDataIt != arTopicStates.end();
         ++tDataIt)
     {
-        const ptr::shared_ptr<const TopicState> tpTopicState = *tDataIt;
-        if (tpTopicState->GetId() != TopicState::kAnonymousTopicState)
+        const ptr::shared_ptr<const TopicState>& tpTopicState = *tDataIt;
+        const TopicStateIdType topicStateId = tpTopicState->GetId();
+        if (topicStateId != TopicState::kAnonymousTopicState)
         {
             /* A malformed graph could publish more than one named TopicState
              * with the same name on the same evaluation pass. This is not
-             * supported by StateSnapshot's map (and the second would just
+             * supported by StateSnapshot's trie (and the second would just
              * clobber the first one). In order to detect that bad design
              * this check looks for consecutive TopicStates with matching
              * names. The logic here relies on the fact that arTopicStates
@@ -64,23 +124,124 @@ void StateSnapshot::UpdateValues(const std::list< ptr::shared_ptr<const TopicSta
              * repeated TopicStates would come consecutively.
              * Thus if this check fails, multiple named TopicStates were
              * published on same eval Pass */
-            if (tpTopicState->GetId() == previousTopicStateID)
+            if (topicStateId == previousTopicStateID)
             {
                 // LCOV_EXCL_START
                 DG_LOG("!!!!!!!!!!!! Duplicate Detected (GetId = %d, previousTopicStateID = %d, Topic %s)",
-                    (int)tpTopicState->GetId(), (int)previousTopicStateID, tpTopicState->GetName());
+                    (int)topicStateId, (int)previousTopicStateID, tpTopicState->GetName());
                 // LCOV_EXCL_STOP
             } // LCOV_EXCL_LINE
 
             // Uncomment line below to re-enable paranoid check for development.
-            // DG_ASSERT(tpTopicState->GetId() != previousTopicStateID);
+            // DG_ASSERT(topicStateId != previousTopicStateID);
+
+            previousTopicStateID = topicStateId;
 
-            previousTopicStateID = tpTopicState->GetId();
+            const unsigned key = (unsigned)topicStateId;
+            if (key < mNumDenseIds)
+            {
+                if (!newDenseStates)
+                {
+                    newDenseStates = new DenseStates(*mDenseStates);
+                    mDenseStates = ptr::shared_ptr<const DenseStates>(newDenseStates);
+                    mDeltaSizeInBytes += DenseSizeInBytes(mNumDenseIds);
+                }
 
+                ptr::shared_ptr<const TopicState>& slot = (*newDenseStates)[key];
+                if (!slot)
+                {
+                    ++mNumStates;
+                }
+                // Just copying a ptr::shared_ptr around :)
+                slot = tpTopicState;
+            }
+            else
+            {
+                PendingValue pendingValue = { key, &tpTopicState };
+                pendingValues.push_back(pendingValue);
+            }
+        }
+    }
+
+    if (pendingValues.empty())
+    {
+        return;
+    }
+
+    // Stable so that a clobbered TopicState is still replaced by the later one.
+    std::stable_sort(pendingValues.begin(), pendingValues.end());
+
+    // Grow the trie upwards until the largest Id fits (and there is at least
+    // a leaf level); existing nodes become the leftmost subtree of the new root.
+    while (mNumLevels == 0 || !KeyFits(pendingValues.back().mKey, mNumLevels))
+    {
+        if (mRoot)
+        {
+            TrieBranch* newRoot = new TrieBranch();
+            newRoot->mChildren[0] = mRoot;
+            mRoot = ptr::shared_ptr<const void>(newRoot);
+            ++mNumTrieBranches;
+            mDeltaSizeInBytes += sizeof(TrieBranch);
+        }
+        ++mNumLevels;
+    }
+
+    mRoot = Assign(mRoot, mNumLevels - 1, pendingValues.begin(), pendingValues.end());
+}
+
+ptr::shared_ptr<const void> StateSnapshot::Assign(
+    const ptr::shared_ptr<const void>& arNode,
+    unsigned aLevel,
+    PendingValueIterator aBegin,
+    PendingValueIterator aEnd)
+{
+    if (aLevel == 0)
+    {
+        TrieLeaf* leaf = arNode ?
+            new TrieLeaf(*static_cast<const TrieLeaf*>(arNode.get())) :
+            new TrieLeaf();
+        ptr::shared_ptr<const void> newNode(leaf);
+        mNumTrieLeaves += arNode ? 0 : 1;
+        mDeltaSizeInBytes += sizeof(TrieLeaf);
+
+        for (PendingValueIterator valueIt = aBegin; valueIt != aEnd; ++valueIt)
+        {
+            ptr::shared_ptr<const TopicState>& slot = leaf->mValues[TrieIndex(valueIt->mKey, 0)];
+            if (!slot)
+            {
+                ++mNumStates;
+            }
             // Just copying a ptr::shared_ptr around :)
-            mStateStore[tpTopicState->GetId()] = tpTopicState;
+            slot = *(valueIt->mpValue);
+        }
+
+        return newNode;
+    }
+
+    TrieBranch* branch = arNode ?
+        new TrieBranch(*static_cast<const TrieBranch*>(arNode.get())) :
+        new TrieBranch();
+    ptr::shared_ptr<const void> newNode(branch);
+    mNumTrieBranches += arNode ? 0 : 1;
+    mDeltaSizeInBytes += sizeof(TrieBranch);
+
+    // aBegin..aEnd is sorted so values under the same child are contiguous;
+    // each touched child is copied exactly once.
+    PendingValueIterator rangeBegin = aBegin;
+    while (rangeBegin != aEnd)
+    {
+        const unsigned index = TrieIndex(rangeBegin->mKey, aLevel);
+        PendingValueIterator rangeEnd = rangeBegin;
+        while (rangeEnd != aEnd && TrieIndex(rangeEnd->mKey, aLevel) == index)
+        {
+            ++rangeEnd;
         }
+
+        branch->mChildren[index] = Assign(branch->mChildren[index], aLevel - 1, rangeBegin, rangeEnd);
+        rangeBegin = rangeEnd;
     }
+
+    return newNode;
 }
 
 StateSnapshot::~StateSnapshot()
@@ -89,28 +250,91 @@ StateSnapshot::~StateSnapshot()
 
 ptr::shared_ptr<const TopicState> StateSnapshot::GetState(TopicStateIdType aId) const
 {
-    if (mStateStore.count(aId) > 0)
+    const unsigned key = (unsigned)aId;
+    if (key < mNumDenseIds)
     {
-        return mStateStore.at(aId);
+        return (*mDenseStates)[key];
     }
 
-    return ptr::shared_ptr<const TopicState>();
+    if (!mRoot || !KeyFits(key, mNumLevels))
+    {
+        return ptr::shared_ptr<const TopicState>();
+    }
+
+    const void* node = mRoot.get();
+    for (unsigned level = mNumLevels - 1; level > 0; --level)
+    {
+        node = static_cast<const TrieBranch*>(node)->mChildren[TrieIndex(key, level)].get();
+        if (!node)
+        {
+            return ptr::shared_ptr<const TopicState>();
+        }
+    }
+
+    return static_cast<const TrieLeaf*>(node)->mValues[TrieIndex(key, 0)];
 }
 
 void StateSnapshot::GetTopicStates(std::list< ptr::shared_ptr<const TopicState> >& aOutTopicStateList) const
 {
-    typedef std::map< TopicStateIdType, ptr::shared_ptr<const TopicState> >::const_iterator StateStoreIterator;
-    for (StateStoreIterator stateIt = mStateStore.begin();
-        stateIt != mStateStore.end();
-        ++stateIt)
+    for (size_t id = 0; id < mNumDenseIds; ++id)
     {
-        aOutTopicStateList.push_back(stateIt->second);
+        if ((*mDenseStates)[id])
+        {
+            aOutTopicStateList.push_back((*mDenseStates)[id]);
+        }
+    }
+
+    // Any trie Id is above the dense ones, so order is preserved.
+    if (mRoot)
+    {
+        CollectValues(mRoot, mNumLevels - 1, aOutTopicStateList);
+    }
+}
+
+void StateSnapshot::CollectValues(
+    const ptr::shared_ptr<const void>& arNode,
+    unsigned aLevel,
+    std::list< ptr::shared_ptr<const TopicState> >& aOutTopicStateList)
+{
+    if (aLevel == 0)
+    {
+        const TrieLeaf* leaf = static_cast<const TrieLeaf*>(arNode.get());
+        for (unsigned index = 0; index < kTrieFanout; ++index)
+        {
+            if (leaf->mValues[index])
+            {
+                aOutTopicStateList.push_back(leaf->mValues[index]);
+            }
+        }
+        return;
+    }
+
+    const TrieBranch* branch = static_cast<const TrieBranch*>(arNode.get());
+    for (unsigned index = 0; index < kTrieFanout; ++index)
+    {
+        if (branch->mChildren[index])
+        {
+            CollectValues(branch->mChildren[index], aLevel - 1, aOutTopicStateList);
+        }
     }
 }
 
 size_t StateSnapshot::GetMapSize() const
 {
-    return mStateStore.size();
+    return mNumStates;
+}
+
+size_t StateSnapshot::GetSizeInBytes() const
+{
+    return sizeof(StateSnapshot) +
+        DenseSizeInBytes(mNumDenseIds) +
+        mNumTrieBranches * sizeof(TrieBranch) +
+        mNumTrieLeaves * sizeof(TrieLeaf);
+}
+
+size_t StateSnapshot::GetDeltaSizeInBytes() const
+{
+    return mDeltaSizeInBytes;
 }
 
 unsigned int StateSnapshot::GetStateVersion() const
@@ -17,7 +17,7 @@
 namespace DetectorGraph
 {
 
-TimeoutPublisherService::TimeoutPublisherService(Graph& arGraph) : mrGraph(arGraph), mMetronomePeriodMsec(0)
+TimeoutPublisherService::TimeoutPublisherService(Graph& arGraph) : mrGraph(arGraph), mMetronomeTime(0), mMetronomeDeadline(0)
 {
 }
 
@@ -70,9 +70,14 @@ void TimeoutPublisherService::SchedulePeriodicPublishingDispatcher(
     DispatcherInterface* aDispatcher,
     const TimeOffset aPeriodInMilliseconds)
 {
-    mMetronomePeriodMsec = gcd(aPeriodInMilliseconds, mMetronomePeriodMsec);
+    DG_ASSERT(aPeriodInMilliseconds > 0);
+    const unsigned seriesIndex = (unsigned)mPeriodicSeries.size();
     mPeriodicSeries.push_back(
-        PeriodicPublishingSeries(aPeriodInMilliseconds, aDispatcher));
+        PeriodicPublishingSeries(aPeriodInMilliseconds,
+            mMetronomeTime + aPeriodInMilliseconds,
+            aDispatcher,
+            seriesIndex));
+    SiftUpPeriodicSeries(seriesIndex);
 }
 
 void TimeoutPublisherService::CancelPublishOnTimeout(const TimeoutPublisherHandle aHandle)
@@ -123,43 +128,84 @@ bool TimeoutPublisherService::HasTimeoutExpired(const TimeoutPublisherHandle aHa
 
 void TimeoutPublisherService::StartPeriodicPublishing()
 {
-    if (mMetronomePeriodMsec > 0)
+    if (mPeriodicSeries.size() > 0)
     {
-        StartMetronome(mMetronomePeriodMsec);
+        ArmMetronomeForNextSeries();
 #if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_INSTRUMENT_RESOURCE_USAGE)
-        DG_LOG("Started Metronome with period of %d milliseconds\n", mMetronomePeriodMsec);
+        DG_LOG("Started Metronome for %d periodic series\n", (int)mPeriodicSeries.size());
 #endif
     }
 }
 
 void TimeoutPublisherService::MetronomeFired()
 {
-    for (PeriodicPublishingSeriesContainer::iterator it = mPeriodicSeries.begin();
-        it != mPeriodicSeries.end();
-        ++it)
+    mMetronomeTime = mMetronomeDeadline;
+
+    // Only the series due now are touched; each one is pushed back into the
+    // heap at its next deadline.
+    while (mPeriodicSeries.size() > 0 && mPeriodicSeries[0].mNextPublishingTime <= mMetronomeTime)
+    {
+        mPeriodicSeries[0].mpDispatcher->Dispatch(mrGraph);
+        mPeriodicSeries[0].mNextPublishingTime += mPeriodicSeries[0].mPublishingPeriodMsec;
+        SiftDownPeriodicSeries(0);
+    }
+
+    if (mPeriodicSeries.size() > 0)
+    {
+        ArmMetronomeForNextSeries();
+    }
+}
+
+void TimeoutPublisherService::ArmMetronomeForNextSeries()
+{
+    mMetronomeDeadline = mPeriodicSeries[0].mNextPublishingTime;
+    ArmMetronome(mMetronomeDeadline - mMetronomeTime);
+}
+
+void TimeoutPublisherService::SiftUpPeriodicSeries(unsigned aIndex)
+{
+    while (aIndex > 0)
     {
-        it->mMetronomeAccumulator += mMetronomePeriodMsec;
-        if (it->mMetronomeAccumulator >= it->mPublishingPeriodMsec)
+        const unsigned parent = (aIndex - 1) / 2;
+        if (!mPeriodicSeries[aIndex].IsDueBefore(mPeriodicSeries[parent]))
         {
-            it->mpDispatcher->Dispatch(mrGraph);
-            it->mMetronomeAccumulator = 0;
+            break;
         }
+        SwapPeriodicSeries(aIndex, parent);
+        aIndex = parent;
     }
 }
 
-TimeOffset TimeoutPublisherService::gcd(TimeOffset lhs, TimeOffset rhs)
+void TimeoutPublisherService::SiftDownPeriodicSeries(unsigned aIndex)
 {
-    while (rhs != 0)
+    const unsigned size = (unsigned)mPeriodicSeries.size();
+    while (true)
     {
-        TimeOffset temp = rhs;
-#if defined(DG_TIMEOFFSET_REMAINDER)
-        rhs = DG_TIMEOFFSET_REMAINDER(lhs, rhs);
-#else
-        rhs = lhs % rhs;
-#endif
-        lhs = temp;
+        unsigned earliest = aIndex;
+        const unsigned left = 2 * aIndex + 1;
+        const unsigned right = left + 1;
+        if (left < size && mPeriodicSeries[left].IsDueBefore(mPeriodicSeries[earliest]))
+        {
+            earliest = left;
+        }
+        if (right < size && mPeriodicSeries[right].IsDueBefore(mPeriodicSeries[earliest]))
+        {
+            earliest = right;
+        }
+        if (earliest == aIndex)
+        {
+            break;
+        }
+        SwapPeriodicSeries(aIndex, earliest);
+        aIndex = earliest;
     }
-    return lhs;
+}
+
+void TimeoutPublisherService::SwapPeriodicSeries(unsigned aIndexA, unsigned aIndexB)
+{
+    const PeriodicPublishingSeries temp = mPeriodicSeries[aIndexA];
+    mPeriodicSeries[aIndexA] = mPeriodicSeries[aIndexB];
+    mPeriodicSeries[aIndexB] = temp;
 }
 
 } // namespace DetectorGraph
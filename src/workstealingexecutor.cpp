@@ -0,0 +1,381 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "workstealingexecutor.hpp"
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+
+#include <algorithm>
+#include <chrono>
+
+namespace DetectorGraph
+{
+
+namespace
+{
+    // Rounds of stealing attempts before an idle worker parks.
+    const unsigned kStealRoundsBeforeParking = 16;
+
+    struct CheaperToRun
+    {
+        CheaperToRun(const std::atomic<unsigned>* aCostEstimates) : mCostEstimates(aCostEstimates) {}
+        bool operator()(unsigned lhs, unsigned rhs) const
+        {
+            return mCostEstimates[lhs].load(std::memory_order_relaxed) <
+                mCostEstimates[rhs].load(std::memory_order_relaxed);
+        }
+        const std::atomic<unsigned>* mCostEstimates;
+    };
+}
+
+WorkStealingExecutor::WorkStealingExecutor()
+: mpVertices(NULL)
+, mpVertexTypes(NULL)
+, mpOutEdgeOffsets(NULL)
+, mpOutEdges(NULL)
+, mpGroups(NULL)
+, mNumVertices(0)
+, mRegionStamp(0)
+, mRemaining(0)
+, mWorkEpoch(0)
+, mNumParked(0)
+{
+}
+
+void WorkStealingExecutor::Reset(unsigned aNumVertices)
+{
+    mNumVertices = aNumVertices;
+    mPendingInputs.reset(new std::atomic<unsigned>[aNumVertices]);
+    mTriggered.reset(new std::atomic<bool>[aNumVertices]);
+    mCostEstimates.reset(new std::atomic<unsigned>[aNumVertices]);
+    for (unsigned vIndex = 0; vIndex < aNumVertices; ++vIndex)
+    {
+        mCostEstimates[vIndex].store(0, std::memory_order_relaxed);
+    }
+    mGroupSuccessors.assign(aNumVertices, aNumVertices);
+    mRegionStamps.assign(aNumVertices, 0);
+    mRegionStamp = 0;
+    mLastInGroup.assign(aNumVertices, aNumVertices);
+    mLastInGroupStamps.assign(aNumVertices, 0);
+}
+
+void WorkStealingExecutor::Run(EvaluationWorkerPool& arPool,
+    const std::vector<Vertex*>& arVertices,
+    const std::vector<Vertex::VertexType>& arVertexTypes,
+    const std::vector<unsigned>& arOutEdgeOffsets,
+    const std::vector<unsigned>& arOutEdges,
+    const std::vector<unsigned>& arGroups,
+    unsigned aInputIndex,
+    std::vector<BaseTopic*>& arPublishedTopics)
+{
+    mpVertices = &arVertices;
+    mpVertexTypes = &arVertexTypes;
+    mpOutEdgeOffsets = &arOutEdgeOffsets;
+    mpOutEdges = &arOutEdges;
+    mpGroups = &arGroups;
+
+    unsigned numWorkers = arPool.GetNumWorkers() + 1;
+    while (mWorkers.size() < numWorkers)
+    {
+        mWorkers.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+    }
+
+    CollectRegion(aInputIndex);
+
+    // Nothing runs concurrently yet; the pool publishes all of this to the
+    // workers when it starts the batch.
+    for (unsigned workerIndex = 0; workerIndex < numWorkers; ++workerIndex)
+    {
+        WorkerQueue& queue = *mWorkers[workerIndex];
+        if (queue.mNumSlots < mRegion.size())
+        {
+            queue.mNumSlots = std::max(mRegion.size(), 2 * queue.mNumSlots);
+            queue.mSlots.reset(new std::atomic<unsigned>[queue.mNumSlots]);
+        }
+        queue.mTop.store(0, std::memory_order_relaxed);
+        queue.mBottom.store(0, std::memory_order_relaxed);
+    }
+    mRemaining.store(static_cast<unsigned>(mRegion.size()), std::memory_order_relaxed);
+    mWorkers[0]->mSlots[0].store(aInputIndex, std::memory_order_relaxed);
+    mWorkers[0]->mBottom.store(1, std::memory_order_relaxed);
+
+    arPool.Run(&WorkStealingExecutor::WorkerJob, this, numWorkers);
+
+    for (unsigned workerIndex = 0; workerIndex < numWorkers; ++workerIndex)
+    {
+        std::vector<BaseTopic*>& published = mWorkers[workerIndex]->mPublishedTopics;
+        arPublishedTopics.insert(arPublishedTopics.end(), published.begin(), published.end());
+        published.clear();
+    }
+}
+
+void WorkStealingExecutor::CollectRegion(unsigned aInputIndex)
+{
+    const std::vector<unsigned>& outEdgeOffsets = *mpOutEdgeOffsets;
+    const std::vector<unsigned>& outEdges = *mpOutEdges;
+    const std::vector<unsigned>& groups = *mpGroups;
+
+    if (++mRegionStamp == 0)
+    {
+        std::fill(mRegionStamps.begin(), mRegionStamps.end(), 0);
+        std::fill(mLastInGroupStamps.begin(), mLastInGroupStamps.end(), 0);
+        mRegionStamp = 1;
+    }
+
+    // Everything reachable from the input, whether or not it gets new data.
+    mRegion.clear();
+    mRegion.push_back(aInputIndex);
+    mRegionStamps[aInputIndex] = mRegionStamp;
+    for (size_t idx = 0; idx < mRegion.size(); ++idx)
+    {
+        unsigned vIndex = mRegion[idx];
+        for (unsigned edgeIndex = outEdgeOffsets[vIndex]; edgeIndex < outEdgeOffsets[vIndex + 1]; ++edgeIndex)
+        {
+            unsigned outIndex = outEdges[edgeIndex];
+            if (mRegionStamps[outIndex] != mRegionStamp)
+            {
+                mRegionStamps[outIndex] = mRegionStamp;
+                mRegion.push_back(outIndex);
+            }
+        }
+    }
+    std::sort(mRegion.begin(), mRegion.end());
+
+    for (std::vector<unsigned>::iterator vIt = mRegion.begin(); vIt != mRegion.end(); ++vIt)
+    {
+        mPendingInputs[*vIt].store(0, std::memory_order_relaxed);
+        mTriggered[*vIt].store(false, std::memory_order_relaxed);
+        mGroupSuccessors[*vIt] = mNumVertices;
+    }
+
+    // Plan order is topological, so chaining group members in that order
+    // can't introduce cycles.
+    for (std::vector<unsigned>::iterator vIt = mRegion.begin(); vIt != mRegion.end(); ++vIt)
+    {
+        unsigned vIndex = *vIt;
+        for (unsigned edgeIndex = outEdgeOffsets[vIndex]; edgeIndex < outEdgeOffsets[vIndex + 1]; ++edgeIndex)
+        {
+            mPendingInputs[outEdges[edgeIndex]].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if ((*mpVertexTypes)[vIndex] == Vertex::kDetectorVertex)
+        {
+            unsigned group = groups[vIndex];
+            if (mLastInGroupStamps[group] == mRegionStamp)
+            {
+                mGroupSuccessors[mLastInGroup[group]] = vIndex;
+                mPendingInputs[vIndex].fetch_add(1, std::memory_order_relaxed);
+            }
+            mLastInGroup[group] = vIndex;
+            mLastInGroupStamps[group] = mRegionStamp;
+        }
+    }
+}
+
+void WorkStealingExecutor::WorkerJob(void* aContext, unsigned aWorkerIndex)
+{
+    WorkStealingExecutor* executor = static_cast<WorkStealingExecutor*>(aContext);
+
+    unsigned idleRounds = 0;
+    while (executor->mRemaining.load(std::memory_order_acquire) != 0)
+    {
+        // Read first so nothing made ready after the attempts below goes
+        // unnoticed by Park().
+        const unsigned workEpoch = executor->mWorkEpoch.load(std::memory_order_seq_cst);
+
+        unsigned vIndex;
+        if (executor->PopReady(aWorkerIndex, vIndex) || executor->StealReady(aWorkerIndex, vIndex))
+        {
+            executor->Execute(aWorkerIndex, vIndex);
+            idleRounds = 0;
+        }
+        else if (++idleRounds >= kStealRoundsBeforeParking)
+        {
+            executor->Park(workEpoch);
+            idleRounds = 0;
+        }
+    }
+}
+
+void WorkStealingExecutor::PushReady(unsigned aWorkerIndex, const std::vector<unsigned>& arVertexIndices)
+{
+    WorkerQueue& queue = *mWorkers[aWorkerIndex];
+    long bottom = queue.mBottom.load(std::memory_order_relaxed);
+    for (std::vector<unsigned>::const_iterator it = arVertexIndices.begin(); it != arVertexIndices.end(); ++it)
+    {
+        queue.mSlots[bottom++].store(*it, std::memory_order_relaxed);
+    }
+    queue.mBottom.store(bottom, std::memory_order_release);
+}
+
+bool WorkStealingExecutor::PopReady(unsigned aWorkerIndex, unsigned& arVertexIndex)
+{
+    WorkerQueue& queue = *mWorkers[aWorkerIndex];
+    const long bottom = queue.mBottom.load(std::memory_order_relaxed) - 1;
+    queue.mBottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long top = queue.mTop.load(std::memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        // Empty
+        queue.mBottom.store(bottom + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    arVertexIndex = queue.mSlots[bottom].load(std::memory_order_relaxed);
+    if (top == bottom)
+    {
+        // Last one; race the thieves for it.
+        const bool won = queue.mTop.compare_exchange_strong(top, top + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed);
+        queue.mBottom.store(bottom + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+bool WorkStealingExecutor::StealReady(unsigned aWorkerIndex, unsigned& arVertexIndex)
+{
+    const size_t numWorkers = mWorkers.size();
+    for (size_t offset = 1; offset < numWorkers; ++offset)
+    {
+        WorkerQueue& victim = *mWorkers[(aWorkerIndex + offset) % numWorkers];
+        long top = victim.mTop.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const long bottom = victim.mBottom.load(std::memory_order_acquire);
+        if (top < bottom)
+        {
+            arVertexIndex = victim.mSlots[top].load(std::memory_order_relaxed);
+            if (victim.mTop.compare_exchange_strong(top, top + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return true;
+            }
+            // Lost it to the owner or another thief; try the next victim
+            // rather than contending for this one.
+        }
+    }
+    return false;
+}
+
+void WorkStealingExecutor::Park(unsigned aWorkEpoch)
+{
+    std::unique_lock<std::mutex> lock(mParkMutex);
+    // Sequentially consistent along with the accesses in WakeParked(): either
+    // the waker sees this worker parked or it sees the epoch bumped.
+    mNumParked.fetch_add(1, std::memory_order_seq_cst);
+    while (mWorkEpoch.load(std::memory_order_seq_cst) == aWorkEpoch &&
+        mRemaining.load(std::memory_order_acquire) != 0)
+    {
+        mWorkAvailable.wait(lock);
+    }
+    mNumParked.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void WorkStealingExecutor::WakeParked(bool aWakeAll)
+{
+    mWorkEpoch.fetch_add(1, std::memory_order_seq_cst);
+    if (mNumParked.load(std::memory_order_seq_cst) > 0)
+    {
+        std::lock_guard<std::mutex> lock(mParkMutex);
+        if (aWakeAll)
+        {
+            mWorkAvailable.notify_all();
+        }
+        else
+        {
+            mWorkAvailable.notify_one();
+        }
+    }
+}
+
+void WorkStealingExecutor::Execute(unsigned aWorkerIndex, unsigned aVertexIndex)
+{
+    WorkerQueue& worker = *mWorkers[aWorkerIndex];
+    Vertex* vertex = (*mpVertices)[aVertexIndex];
+    bool hasNewData = false;
+
+    if ((*mpVertexTypes)[aVertexIndex] == Vertex::kTopicVertex)
+    {
+        // Same as Topic::ProcessVertex() except that subscribers are marked
+        // through mTriggered; they may be shared with topics being settled
+        // concurrently.
+        if (vertex->GetState() == Vertex::kVertexProcessing)
+        {
+            vertex->SetState(Vertex::kVertexDone);
+            worker.mPublishedTopics.push_back(static_cast<BaseTopic*>(vertex));
+            hasNewData = true;
+        }
+    }
+    else if (mTriggered[aVertexIndex].load(std::memory_order_relaxed))
+    {
+        vertex->SetState(Vertex::kVertexProcessing);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        vertex->ProcessVertex();
+        unsigned elapsed = static_cast<unsigned>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+
+        // Exponential moving average; only this vertex's runner writes it.
+        unsigned previous = mCostEstimates[aVertexIndex].load(std::memory_order_relaxed);
+        mCostEstimates[aVertexIndex].store(previous - previous / 8 + elapsed / 8, std::memory_order_relaxed);
+    }
+
+    worker.mNewlyReady.clear();
+    const std::vector<unsigned>& outEdges = *mpOutEdges;
+    for (unsigned edgeIndex = (*mpOutEdgeOffsets)[aVertexIndex];
+        edgeIndex < (*mpOutEdgeOffsets)[aVertexIndex + 1];
+        ++edgeIndex)
+    {
+        if (hasNewData)
+        {
+            mTriggered[outEdges[edgeIndex]].store(true, std::memory_order_relaxed);
+        }
+        Release(outEdges[edgeIndex], worker.mNewlyReady);
+    }
+    if (mGroupSuccessors[aVertexIndex] != mNumVertices)
+    {
+        Release(mGroupSuccessors[aVertexIndex], worker.mNewlyReady);
+    }
+
+    if (!worker.mNewlyReady.empty())
+    {
+        // The back of the deque is taken next; make that the costliest.
+        std::sort(worker.mNewlyReady.begin(), worker.mNewlyReady.end(), CheaperToRun(mCostEstimates.get()));
+        PushReady(aWorkerIndex, worker.mNewlyReady);
+    }
+
+    // Only after anything this made ready is visible to the other workers.
+    const bool done = (mRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1);
+
+    // This worker takes one of the new vertices itself; parked ones are only
+    // needed for the rest.
+    if (done || worker.mNewlyReady.size() > 1)
+    {
+        WakeParked(done || worker.mNewlyReady.size() > 2);
+    }
+}
+
+void WorkStealingExecutor::Release(unsigned aVertexIndex, std::vector<unsigned>& arNewlyReady)
+{
+    if (mPendingInputs[aVertexIndex].fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        arNewlyReady.push_back(aVertexIndex);
+    }
+}
+
+}
+
+#endif
@@ -34,13 +34,13 @@ namespace GraphTestUtils
 #if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
     void PrintOutputs(Graph& aGraph)
     {
-        DG_LOG("-----Graph::GetOutputList() contains:-----");
-        const std::list<ptr::shared_ptr<const TopicState> > outputs = aGraph.GetOutputList();
-        for (std::list<ptr::shared_ptr<const TopicState> >::const_iterator it = outputs.begin();
+        DG_LOG("-----Graph::GetOutputView() contains:-----");
+        const OutputView outputs = aGraph.GetOutputView();
+        for (OutputView::const_iterator it = outputs.begin();
             it != outputs.end();
             ++it)
         {
-            DG_LOG("Output contains %s\n", (*it)->GetName());
+            DG_LOG("Output contains %s\n", it->GetName());
         }
         DG_LOG("---------------------DONE------------------------");
     }
@@ -59,9 +59,9 @@ void TestTimeoutPublisherService::Cancel(const TimeoutPublisherHandle aTimerId)
 #endif
 }
 
-void TestTimeoutPublisherService::StartMetronome(const TimeOffset aPeriodInMilliseconds)
+void TestTimeoutPublisherService::ArmMetronome(const TimeOffset aMillisecondsFromNow)
 {
-    mMetronomeTimerPeriod = aPeriodInMilliseconds;
+    mMetronomeTimerPeriod = aMillisecondsFromNow;
     SetTimeout(mMetronomeTimerPeriod, kMetronomeId);
     Start(kMetronomeId);
 }
@@ -86,8 +86,6 @@ bool TestTimeoutPublisherService::FireNextTimeout()
         if (minIt->first == kMetronomeId)
         {
             MetronomeFired();
-            SetTimeout(mMetronomeTimerPeriod, kMetronomeId);
-            Start(kMetronomeId);
         }
         else
         {
@@ -131,8 +129,6 @@ bool TestTimeoutPublisherService::ForwardTimeAndEvaluate(TimeOffset aFwdTime, Gr
         if (minIt->first == kMetronomeId)
         {
             MetronomeFired();
-            SetTimeout(mMetronomeTimerPeriod, kMetronomeId);
-            Start(kMetronomeId);
         }
         else
         {
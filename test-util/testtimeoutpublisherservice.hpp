@@ -65,7 +65,7 @@ protected:
     virtual void SetTimeout(const TimeOffset aMillisecondsFromNow, const TimeoutPublisherHandle aTimerId);
     virtual void Start(const TimeoutPublisherHandle aTimerId);
     virtual void Cancel(const TimeoutPublisherHandle aTimerId);
-    virtual void StartMetronome(const TimeOffset aPeriodInMilliseconds);
+    virtual void ArmMetronome(const TimeOffset aMillisecondsFromNow);
     virtual void CancelMetronome();
 
 public:
@@ -0,0 +1,153 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "graph.hpp"
+#include "detector.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace DetectorGraph;
+
+/*
+ * Compares feeding a Graph from several producer threads through a global
+ * mutex around PushData()/EvaluateGraph() against
+ * Graph::PushDataFromAnyThread(), reporting inputs/sec.
+ */
+
+struct SensorSample : public TopicState
+{
+    SensorSample(int aV = 0) : v(aV) {}
+    int v;
+};
+
+struct FilteredSample : public TopicState
+{
+    FilteredSample(int aV = 0) : v(aV) {}
+    int v;
+};
+
+class FilterDetector
+: public Detector
+, public SubscriberInterface<SensorSample>
+, public Publisher<FilteredSample>
+{
+public:
+    FilterDetector(Graph* graph) : Detector(graph), mSum(0)
+    {
+        Subscribe<SensorSample>(this);
+        SetupPublishing<FilteredSample>(this);
+    }
+
+    virtual void Evaluate(const SensorSample& aSample)
+    {
+        mSum += aSample.v;
+        Publish(FilteredSample(mSum));
+    }
+
+    long mSum;
+};
+
+static const int kSamplesPerProducer = 200000;
+
+static double RunWithGlobalLock(int aNumProducers)
+{
+    Graph graph;
+    FilterDetector detector(&graph);
+    std::mutex graphMutex;
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (int p = 0; p < aNumProducers; ++p)
+    {
+        producers.push_back(std::thread([&graph, &graphMutex]() {
+            for (int i = 0; i < kSamplesPerProducer; ++i)
+            {
+                std::lock_guard<std::mutex> lock(graphMutex);
+                graph.PushData<SensorSample>(SensorSample(i));
+            }
+        }));
+    }
+
+    int numEvaluated = 0;
+    while (numEvaluated < aNumProducers * kSamplesPerProducer)
+    {
+        std::lock_guard<std::mutex> lock(graphMutex);
+        if (graph.EvaluateIfHasDataPending())
+        {
+            numEvaluated++;
+        }
+    }
+
+    for (size_t p = 0; p < producers.size(); ++p)
+    {
+        producers[p].join();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return numEvaluated / elapsed.count();
+}
+
+static double RunLockFree(int aNumProducers)
+{
+    Graph graph;
+    FilterDetector detector(&graph);
+    graph.EnableConcurrentInput(4096);
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (int p = 0; p < aNumProducers; ++p)
+    {
+        producers.push_back(std::thread([&graph]() {
+            for (int i = 0; i < kSamplesPerProducer; ++i)
+            {
+                while (graph.PushDataFromAnyThread(SensorSample(i)) != ErrorType_Success)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+
+    int numEvaluated = 0;
+    while (numEvaluated < aNumProducers * kSamplesPerProducer)
+    {
+        if (graph.WaitForDataPending(1000))
+        {
+            graph.EvaluateGraph();
+            numEvaluated++;
+        }
+    }
+
+    for (size_t p = 0; p < producers.size(); ++p)
+    {
+        producers[p].join();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return numEvaluated / elapsed.count();
+}
+
+int main()
+{
+    const int kNumProducers[] = { 1, 2, 4, 8 };
+    for (unsigned n = 0; n < sizeof(kNumProducers) / sizeof(kNumProducers[0]); ++n)
+    {
+        printf("%d producers: global lock %10.0f inputs/sec, PushDataFromAnyThread %10.0f inputs/sec\n",
+            kNumProducers[n], RunWithGlobalLock(kNumProducers[n]), RunLockFree(kNumProducers[n]));
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "graph.hpp"
+#include "detector.hpp"
+#include "graphinputqueue.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace DetectorGraph;
+
+/*
+ * Measures the ingest path: Graph::PushData() into the GraphInputQueue and
+ * back out into Topics, reporting inputs/sec and heap allocations per input
+ * once the graph has warmed up.
+ */
+
+static unsigned long sNumAllocations = 0;
+
+void* operator new(size_t aSize)
+{
+    sNumAllocations++;
+    void* ptr = malloc(aSize);
+    if (ptr == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* aPtr) noexcept
+{
+    free(aPtr);
+}
+
+void operator delete(void* aPtr, size_t) noexcept
+{
+    free(aPtr);
+}
+
+struct SensorSample : public TopicState
+{
+    SensorSample(int aV = 0) : v(aV) {}
+    int v;
+};
+
+struct SensorEvent : public TopicState
+{
+    SensorEvent(int aV = 0) : v(aV) {}
+    int v;
+};
+
+struct FilteredSample : public TopicState
+{
+    FilteredSample(int aV = 0) : v(aV) {}
+    int v;
+};
+
+class FilterDetector
+: public Detector
+, public SubscriberInterface<SensorSample>
+, public SubscriberInterface<SensorEvent>
+, public Publisher<FilteredSample>
+{
+public:
+    FilterDetector(Graph* graph) : Detector(graph), mSum(0)
+    {
+        Subscribe<SensorSample>(this);
+        Subscribe<SensorEvent>(this);
+        SetupPublishing<FilteredSample>(this);
+    }
+
+    virtual void Evaluate(const SensorSample& aSample)
+    {
+        mSum += aSample.v;
+        Publish(FilteredSample(mSum));
+    }
+
+    virtual void Evaluate(const SensorEvent& aEvent)
+    {
+        mSum -= aEvent.v;
+    }
+
+    int mSum;
+};
+
+struct Measurement
+{
+    double inputsPerSec;
+    double allocationsPerInput;
+};
+
+template<class TBody>
+static Measurement Measure(unsigned aNumInputs, TBody aBody)
+{
+    // Warm up pools & containers.
+    aBody();
+
+    const unsigned long allocationsBefore = sNumAllocations;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned numInputs = 0;
+    while (numInputs < aNumInputs)
+    {
+        numInputs += aBody();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    Measurement m;
+    m.inputsPerSec = numInputs / elapsed.count();
+    m.allocationsPerInput = (double)(sNumAllocations - allocationsBefore) / numInputs;
+    return m;
+}
+
+static void Report(const char* aName, const Measurement& m)
+{
+    printf("%-36s %12.0f inputs/sec %8.3f allocations/input\n",
+        aName, m.inputsPerSec, m.allocationsPerInput);
+}
+
+int main()
+{
+    const unsigned kNumInputs = 4000000;
+    const unsigned kBurst = 64;
+
+    Topic<SensorSample> sampleTopic;
+    Topic<SensorEvent> eventTopic;
+    GraphInputQueue inputQueue;
+
+    Report("GraphInputQueue (bursts of 64)", Measure(kNumInputs, [&]() {
+        for (unsigned i = 0; i < kBurst; ++i)
+        {
+            if (i % 4)
+            {
+                inputQueue.Enqueue(sampleTopic, SensorSample(i));
+            }
+            else
+            {
+                inputQueue.Enqueue(eventTopic, SensorEvent(i));
+            }
+        }
+        while (inputQueue.DequeueAndDispatch() != NULL) {}
+        sampleTopic.SetState(Vertex::kVertexClear);
+        eventTopic.SetState(Vertex::kVertexClear);
+        return kBurst;
+    }));
+
+    Graph graph;
+    FilterDetector detector(&graph);
+
+    Report("Graph::PushData + EvaluateGraph", Measure(kNumInputs / 4, [&]() {
+        for (unsigned i = 0; i < kBurst; ++i)
+        {
+            if (i % 4)
+            {
+                graph.PushData<SensorSample>(SensorSample(i));
+            }
+            else
+            {
+                graph.PushData<SensorEvent>(SensorEvent(i));
+            }
+        }
+        while (graph.EvaluateIfHasDataPending()) {}
+        return kBurst;
+    }));
+
+    return 0;
+}
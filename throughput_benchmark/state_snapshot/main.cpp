@@ -0,0 +1,94 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "graphstatestore.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+using namespace DetectorGraph;
+
+/*
+ * Measures GraphStateStore::TakeNewSnapshot() - done after every evaluation -
+ * for a store holding kNumNamedTopics named TopicStates of which only one
+ * changes per evaluation, and StateSnapshot::GetState() of all of them; both
+ * for the default (trie) and the bounded-Id (dense) snapshot layouts.
+ */
+
+struct Reading : public TopicState
+{
+    Reading(TopicStateIdType aId = 0, int aV = 0) : id(aId), v(aV) {}
+    virtual TopicStateIdType GetId() const { return id; }
+    TopicStateIdType id;
+    int v;
+};
+
+static const int kNumNamedTopics = 64;
+
+static void Run(const char* aLabel, GraphStateStore& aStore)
+{
+    const unsigned kNumEvaluations = 200000;
+    const unsigned kNumReadRounds = 100000;
+
+    {
+        std::list< ptr::shared_ptr<const TopicState> > primeOutput;
+        for (int id = 0; id < kNumNamedTopics; ++id)
+        {
+            primeOutput.push_back(ptr::shared_ptr<const TopicState>(new Reading(id)));
+        }
+        aStore.TakeNewSnapshot(primeOutput);
+    }
+
+    std::list< ptr::shared_ptr<const TopicState> > evaluationOutput;
+    evaluationOutput.push_back(ptr::shared_ptr<const TopicState>());
+
+    size_t checksum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned evaluation = 0; evaluation < kNumEvaluations; ++evaluation)
+    {
+        evaluationOutput.front().reset(new Reading(evaluation % kNumNamedTopics, evaluation));
+        aStore.TakeNewSnapshot(evaluationOutput);
+        checksum += aStore.GetLastState()->GetMapSize();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    printf("TakeNewSnapshot (%-6s) %19.0f snapshots/sec (%zx)\n", aLabel,
+        (double)kNumEvaluations / elapsed.count(), checksum & 0xf);
+
+    // Mimics a UI reading every named state from the latest snapshot.
+    const ptr::shared_ptr<const StateSnapshot> snapshot = aStore.GetLastState();
+    start = std::chrono::steady_clock::now();
+    for (unsigned round = 0; round < kNumReadRounds; ++round)
+    {
+        for (int id = 0; id < kNumNamedTopics; ++id)
+        {
+            checksum += (size_t)snapshot->GetState(id).get();
+        }
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+
+    printf("StateSnapshot::GetState (%-6s) %11.0f reads/sec (%zx)\n", aLabel,
+        (double)kNumReadRounds * kNumNamedTopics / elapsed.count(), checksum & 0xf);
+}
+
+int main()
+{
+    GraphStateStore trieStore;
+    Run("trie", trieStore);
+
+    GraphStateStore denseStore(kNumNamedTopics);
+    Run("dense", denseStore);
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "graph.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+using namespace DetectorGraph;
+
+/*
+ * Measures Graph::ResolveTopic() - done on every PushData() - for a graph
+ * with kNumTypes TopicState types, resolving them round-robin.
+ */
+
+template<int N>
+struct Reading : public TopicState
+{
+    Reading(int aV = 0) : v(aV) {}
+    int v;
+};
+
+static const int kNumTypes = 32;
+
+template<int N>
+struct ResolveAll
+{
+    static size_t Run(Graph& aGraph)
+    {
+        return (size_t)aGraph.ResolveTopic< Reading<N> >() + ResolveAll<N - 1>::Run(aGraph);
+    }
+};
+
+template<>
+struct ResolveAll<0>
+{
+    static size_t Run(Graph& aGraph)
+    {
+        return (size_t)aGraph.ResolveTopic< Reading<0> >();
+    }
+};
+
+int main()
+{
+    const unsigned kNumRounds = 500000;
+
+    Graph graph;
+    size_t checksum = ResolveAll<kNumTypes - 1>::Run(graph);
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned round = 0; round < kNumRounds; ++round)
+    {
+        checksum += ResolveAll<kNumTypes - 1>::Run(graph);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    printf("%-36s %12.0f resolves/sec (%zx)\n", "Graph::ResolveTopic (32 types)",
+        (double)kNumRounds * kNumTypes / elapsed.count(), checksum & 0xf);
+
+    return 0;
+}
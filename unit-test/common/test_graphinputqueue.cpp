@@ -109,11 +109,336 @@ static void Test_Cleanup(nlTestSuite *inSuite, void *inContext)
     inputQueue.Enqueue(topic, TestTopicStateA(42));
 }
 
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+struct CopyCountingTopicState : public DetectorGraph::TopicState
+{
+    CopyCountingTopicState(int av = 0) : v(av) {}
+    CopyCountingTopicState(int av, int aw) : v(av + aw) {}
+    CopyCountingTopicState(const CopyCountingTopicState& other) : TopicState(other), v(other.v) { sCopies++; }
+    CopyCountingTopicState(CopyCountingTopicState&& other) : TopicState(other), v(other.v) { sMoves++; }
+    int v;
+
+    static int sCopies;
+    static int sMoves;
+};
+int CopyCountingTopicState::sCopies = 0;
+int CopyCountingTopicState::sMoves = 0;
+
+static void Test_EnqueueMovesData(nlTestSuite *inSuite, void *inContext)
+{
+    GraphInputQueue inputQueue;
+    Topic<CopyCountingTopicState> topic;
+    CopyCountingTopicState::sCopies = 0;
+    CopyCountingTopicState::sMoves = 0;
+
+    // Act: rvalue all the way into the Topic
+    inputQueue.Enqueue(topic, CopyCountingTopicState(42));
+    inputQueue.DequeueAndDispatch();
+    topic.ProcessVertex();
+
+    NL_TEST_ASSERT(inSuite, topic.GetNewValue().v == 42);
+    NL_TEST_ASSERT(inSuite, CopyCountingTopicState::sCopies == 0);
+    NL_TEST_ASSERT(inSuite, CopyCountingTopicState::sMoves == 2);
+
+    // Act: lvalues are copied exactly once
+    topic.SetState(Vertex::kVertexClear);
+    const CopyCountingTopicState lvalue(7);
+    inputQueue.Enqueue(topic, lvalue);
+    inputQueue.DequeueAndDispatch();
+    topic.ProcessVertex();
+
+    NL_TEST_ASSERT(inSuite, topic.GetNewValue().v == 7);
+    NL_TEST_ASSERT(inSuite, CopyCountingTopicState::sCopies == 1);
+    NL_TEST_ASSERT(inSuite, CopyCountingTopicState::sMoves == 3);
+}
+
+static void Test_EnqueueInPlace(nlTestSuite *inSuite, void *inContext)
+{
+    GraphInputQueue inputQueue;
+    Topic<CopyCountingTopicState> topic;
+    CopyCountingTopicState::sCopies = 0;
+    CopyCountingTopicState::sMoves = 0;
+
+    inputQueue.Enqueue(topic, 40, 2);
+    inputQueue.DequeueAndDispatch();
+    topic.ProcessVertex();
+
+    NL_TEST_ASSERT(inSuite, topic.GetNewValue().v == 42);
+    NL_TEST_ASSERT(inSuite, CopyCountingTopicState::sCopies == 0);
+    NL_TEST_ASSERT(inSuite, CopyCountingTopicState::sMoves == 1);
+
+    // Publishing in place on the Topic itself doesn't even move.
+    topic.SetState(Vertex::kVertexClear);
+    topic.PublishInPlace(1, 2);
+    topic.ProcessVertex();
+
+    NL_TEST_ASSERT(inSuite, topic.GetNewValue().v == 3);
+    NL_TEST_ASSERT(inSuite, CopyCountingTopicState::sCopies == 0);
+    NL_TEST_ASSERT(inSuite, CopyCountingTopicState::sMoves == 1);
+}
+#endif
+
+#if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
+static void Test_FifoAcrossRecycling(nlTestSuite *inSuite, void *inContext)
+{
+    GraphInputQueue inputQueue;
+    Topic<TestTopicStateA> topicA;
+    Topic<TestTopicStateB> topicB;
+
+    // Interleaves enqueues & dequeues so the ring wraps around, grows while
+    // wrapped and dispatcher slots of both types get recycled.
+    int nextIn = 0;
+    int nextOut = 0;
+    for (int round = 0; round < 8; ++round)
+    {
+        for (int i = 0; i < 3 + 2 * round; ++i, ++nextIn)
+        {
+            if (nextIn % 2)
+            {
+                inputQueue.Enqueue(topicA, TestTopicStateA(nextIn));
+            }
+            else
+            {
+                inputQueue.Enqueue(topicB, TestTopicStateB(nextIn));
+            }
+        }
+
+        for (int i = 0; i < 2 + round; ++i, ++nextOut)
+        {
+            topicA.SetState(Vertex::kVertexClear);
+            topicB.SetState(Vertex::kVertexClear);
+            Vertex* dispatchedTopic = inputQueue.DequeueAndDispatch();
+            if (nextOut % 2)
+            {
+                NL_TEST_ASSERT(inSuite, dispatchedTopic == &topicA);
+                NL_TEST_ASSERT(inSuite, topicA.GetCurrentValues().back().v == nextOut);
+            }
+            else
+            {
+                NL_TEST_ASSERT(inSuite, dispatchedTopic == &topicB);
+                NL_TEST_ASSERT(inSuite, topicB.GetCurrentValues().back().v == nextOut);
+            }
+        }
+    }
+
+    while (!inputQueue.IsEmpty())
+    {
+        inputQueue.DequeueAndDispatch();
+        nextOut++;
+    }
+    NL_TEST_ASSERT(inSuite, nextOut == nextIn);
+}
+
+static void Test_OverflowPolicies(nlTestSuite *inSuite, void *inContext)
+{
+    Topic<TestTopicStateA> topic;
+
+    GraphInputQueue rejecting;
+    rejecting.SetCapacity(2, kRejectNewInput);
+    NL_TEST_ASSERT(inSuite, rejecting.Enqueue(topic, TestTopicStateA(0)) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, rejecting.Enqueue(topic, TestTopicStateA(1)) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, rejecting.Enqueue(topic, TestTopicStateA(2)) == ErrorType_NoResource);
+    NL_TEST_ASSERT(inSuite, rejecting.GetStats().depth == 2);
+    NL_TEST_ASSERT(inSuite, rejecting.GetStats().numRejected == 1);
+    rejecting.DequeueAndDispatch();
+    NL_TEST_ASSERT(inSuite, topic.GetCurrentValues().back().v == 0);
+
+    GraphInputQueue droppingNewest;
+    droppingNewest.SetCapacity(2, kDropNewestInput);
+    droppingNewest.Enqueue(topic, TestTopicStateA(0));
+    droppingNewest.Enqueue(topic, TestTopicStateA(1));
+    NL_TEST_ASSERT(inSuite, droppingNewest.Enqueue(topic, TestTopicStateA(2)) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, droppingNewest.GetStats().numDropped == 1);
+    topic.SetState(Vertex::kVertexClear);
+    droppingNewest.DequeueAndDispatch();
+    topic.SetState(Vertex::kVertexClear);
+    droppingNewest.DequeueAndDispatch();
+    NL_TEST_ASSERT(inSuite, topic.GetCurrentValues().back().v == 1);
+    NL_TEST_ASSERT(inSuite, droppingNewest.IsEmpty());
+
+    GraphInputQueue droppingOldest;
+    droppingOldest.SetCapacity(2, kDropOldestInput);
+    droppingOldest.Enqueue(topic, TestTopicStateA(0));
+    droppingOldest.Enqueue(topic, TestTopicStateA(1));
+    NL_TEST_ASSERT(inSuite, droppingOldest.Enqueue(topic, TestTopicStateA(2)) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, droppingOldest.GetStats().numDropped == 1);
+    topic.SetState(Vertex::kVertexClear);
+    droppingOldest.DequeueAndDispatch();
+    NL_TEST_ASSERT(inSuite, topic.GetCurrentValues().back().v == 1);
+    topic.SetState(Vertex::kVertexClear);
+    droppingOldest.DequeueAndDispatch();
+    NL_TEST_ASSERT(inSuite, topic.GetCurrentValues().back().v == 2);
+    NL_TEST_ASSERT(inSuite, droppingOldest.IsEmpty());
+}
+
+static void Test_HighWaterMark(nlTestSuite *inSuite, void *inContext)
+{
+    GraphInputQueue inputQueue;
+    Topic<TestTopicStateA> topic;
+
+    for (int i = 0; i < 5; ++i)
+    {
+        inputQueue.Enqueue(topic, TestTopicStateA(i));
+    }
+    inputQueue.DequeueAndDispatch();
+    inputQueue.DequeueAndDispatch();
+
+    InputQueueStats stats = inputQueue.GetStats();
+    NL_TEST_ASSERT(inSuite, stats.depth == 3);
+    NL_TEST_ASSERT(inSuite, stats.highWaterMark == 5);
+    NL_TEST_ASSERT(inSuite, stats.numDropped == 0 && stats.numRejected == 0);
+
+    inputQueue.ResetStats();
+    NL_TEST_ASSERT(inSuite, inputQueue.GetStats().highWaterMark == 3);
+}
+
+static void Test_Conflation(nlTestSuite *inSuite, void *inContext)
+{
+    GraphInputQueue inputQueue;
+    Topic<TestTopicStateA> topicA;
+    Topic<TestTopicStateB> topicB;
+    inputQueue.SetConflation(&topicA, true);
+
+    // A1 B2 A3 B4 A5 -> A5 B2 B4
+    inputQueue.Enqueue(topicA, TestTopicStateA(1));
+    inputQueue.Enqueue(topicB, TestTopicStateB(2));
+    inputQueue.Enqueue(topicA, TestTopicStateA(3));
+    inputQueue.Enqueue(topicB, TestTopicStateB(4));
+    inputQueue.Enqueue(topicA, TestTopicStateA(5));
+    NL_TEST_ASSERT(inSuite, inputQueue.GetStats().depth == 3);
+    NL_TEST_ASSERT(inSuite, inputQueue.GetStats().numConflated == 2);
+
+    NL_TEST_ASSERT(inSuite, inputQueue.DequeueAndDispatch() == &topicA);
+    NL_TEST_ASSERT(inSuite, topicA.GetCurrentValues().back().v == 5);
+
+    // Once dispatched, the next input is appended again.
+    inputQueue.Enqueue(topicA, TestTopicStateA(6));
+    topicB.SetState(Vertex::kVertexClear);
+    NL_TEST_ASSERT(inSuite, inputQueue.DequeueAndDispatch() == &topicB);
+    NL_TEST_ASSERT(inSuite, topicB.GetCurrentValues().back().v == 2);
+    topicB.SetState(Vertex::kVertexClear);
+    NL_TEST_ASSERT(inSuite, inputQueue.DequeueAndDispatch() == &topicB);
+    NL_TEST_ASSERT(inSuite, topicB.GetCurrentValues().back().v == 4);
+    topicA.SetState(Vertex::kVertexClear);
+    NL_TEST_ASSERT(inSuite, inputQueue.DequeueAndDispatch() == &topicA);
+    NL_TEST_ASSERT(inSuite, topicA.GetCurrentValues().back().v == 6);
+    NL_TEST_ASSERT(inSuite, inputQueue.IsEmpty());
+
+    // Conflated inputs don't need room in a full queue.
+    inputQueue.SetCapacity(1, kRejectNewInput);
+    NL_TEST_ASSERT(inSuite, inputQueue.Enqueue(topicA, TestTopicStateA(7)) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, inputQueue.Enqueue(topicA, TestTopicStateA(8)) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, inputQueue.Enqueue(topicB, TestTopicStateB(9)) == ErrorType_NoResource);
+
+    inputQueue.SetConflation(&topicA, false);
+    NL_TEST_ASSERT(inSuite, inputQueue.Enqueue(topicA, TestTopicStateA(10)) == ErrorType_NoResource);
+    topicA.SetState(Vertex::kVertexClear);
+    inputQueue.DequeueAndDispatch();
+    NL_TEST_ASSERT(inSuite, topicA.GetCurrentValues().back().v == 8);
+}
+
+static void Test_PriorityAndDeadlineOrder(nlTestSuite *inSuite, void *inContext)
+{
+    GraphInputQueue inputQueue;
+    Topic<TestTopicStateA> topicA;
+    Topic<TestTopicStateB> topicB;
+    inputQueue.SetPriority(&topicB, 2);
+
+    // Lane 0: A1 A2 A3(deadline 30) A4(deadline 20)
+    // Lane 2: B5 B6(deadline 50)
+    inputQueue.Enqueue(topicA, TestTopicStateA(1));
+    inputQueue.Enqueue(topicA, TestTopicStateA(2));
+    inputQueue.EnqueueWithDeadline(30, topicA, TestTopicStateA(3));
+    inputQueue.EnqueueWithDeadline(20, topicA, TestTopicStateA(4));
+    inputQueue.Enqueue(topicB, TestTopicStateB(5));
+    inputQueue.EnqueueWithDeadline(50, topicB, TestTopicStateB(6));
+
+    const int expected[] = { 6, 5, 4, 3, 1, 2 };
+    for (unsigned i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i)
+    {
+        topicA.SetState(Vertex::kVertexClear);
+        topicB.SetState(Vertex::kVertexClear);
+        Vertex* dispatchedTopic = inputQueue.DequeueAndDispatch();
+        int v = (dispatchedTopic == &topicA) ? topicA.GetCurrentValues().back().v : topicB.GetCurrentValues().back().v;
+        NL_TEST_ASSERT(inSuite, v == expected[i]);
+    }
+    NL_TEST_ASSERT(inSuite, inputQueue.IsEmpty());
+
+    // Dropping the oldest input drops from the lowest priority lane.
+    inputQueue.SetCapacity(2, kDropOldestInput);
+    inputQueue.Enqueue(topicB, TestTopicStateB(7));
+    inputQueue.Enqueue(topicA, TestTopicStateA(8));
+    inputQueue.Enqueue(topicA, TestTopicStateA(9));
+    NL_TEST_ASSERT(inSuite, inputQueue.DequeueAndDispatch() == &topicB);
+    topicA.SetState(Vertex::kVertexClear);
+    NL_TEST_ASSERT(inSuite, inputQueue.DequeueAndDispatch() == &topicA);
+    NL_TEST_ASSERT(inSuite, topicA.GetCurrentValues().back().v == 9);
+    NL_TEST_ASSERT(inSuite, inputQueue.IsEmpty());
+}
+
+static void Test_DropOldestKeepsDeadlines(nlTestSuite *inSuite, void *inContext)
+{
+    GraphInputQueue inputQueue;
+    Topic<TestTopicStateA> topic;
+    inputQueue.SetCapacity(4, kDropOldestInput);
+
+    // Plain inputs are dropped before any with a deadline, oldest first.
+    inputQueue.Enqueue(topic, TestTopicStateA(1));
+    inputQueue.EnqueueWithDeadline(10, topic, TestTopicStateA(2));
+    inputQueue.Enqueue(topic, TestTopicStateA(3));
+    inputQueue.EnqueueWithDeadline(40, topic, TestTopicStateA(4));
+    inputQueue.Enqueue(topic, TestTopicStateA(5));
+    inputQueue.Enqueue(topic, TestTopicStateA(6));
+    inputQueue.Enqueue(topic, TestTopicStateA(7));
+    NL_TEST_ASSERT(inSuite, inputQueue.GetStats().numDropped == 3);
+
+    const int expectedMixed[] = { 2, 4, 6, 7 };
+    for (unsigned i = 0; i < sizeof(expectedMixed) / sizeof(expectedMixed[0]); ++i)
+    {
+        topic.SetState(Vertex::kVertexClear);
+        inputQueue.DequeueAndDispatch();
+        NL_TEST_ASSERT(inSuite, topic.GetCurrentValues().back().v == expectedMixed[i]);
+    }
+    NL_TEST_ASSERT(inSuite, inputQueue.IsEmpty());
+
+    // With only deadline inputs left, the one due last is dropped.
+    inputQueue.SetCapacity(5, kDropOldestInput);
+    inputQueue.EnqueueWithDeadline(50, topic, TestTopicStateA(50));
+    inputQueue.EnqueueWithDeadline(10, topic, TestTopicStateA(10));
+    inputQueue.EnqueueWithDeadline(40, topic, TestTopicStateA(40));
+    inputQueue.EnqueueWithDeadline(20, topic, TestTopicStateA(20));
+    inputQueue.EnqueueWithDeadline(30, topic, TestTopicStateA(30));
+    inputQueue.EnqueueWithDeadline(5, topic, TestTopicStateA(5));
+    inputQueue.EnqueueWithDeadline(35, topic, TestTopicStateA(35));
+
+    const int expectedDeadlines[] = { 5, 10, 20, 30, 35 };
+    for (unsigned i = 0; i < sizeof(expectedDeadlines) / sizeof(expectedDeadlines[0]); ++i)
+    {
+        topic.SetState(Vertex::kVertexClear);
+        inputQueue.DequeueAndDispatch();
+        NL_TEST_ASSERT(inSuite, topic.GetCurrentValues().back().v == expectedDeadlines[i]);
+    }
+    NL_TEST_ASSERT(inSuite, inputQueue.IsEmpty());
+}
+#endif
+
 static const nlTest sTests[] = {
     NL_TEST_DEF("Test_IsEmpty", Test_IsEmpty),
     NL_TEST_DEF("Test_DequeueAndDispatch", Test_DequeueAndDispatch),
     NL_TEST_DEF("Test_DequeueMultiple", Test_DequeueMultiple),
     NL_TEST_DEF("Test_Cleanup", Test_Cleanup),
+#if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
+    NL_TEST_DEF("Test_FifoAcrossRecycling", Test_FifoAcrossRecycling),
+    NL_TEST_DEF("Test_OverflowPolicies", Test_OverflowPolicies),
+    NL_TEST_DEF("Test_HighWaterMark", Test_HighWaterMark),
+    NL_TEST_DEF("Test_Conflation", Test_Conflation),
+    NL_TEST_DEF("Test_PriorityAndDeadlineOrder", Test_PriorityAndDeadlineOrder),
+    NL_TEST_DEF("Test_DropOldestKeepsDeadlines", Test_DropOldestKeepsDeadlines),
+#endif
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PERFECT_FORWARDING)
+    NL_TEST_DEF("Test_EnqueueMovesData", Test_EnqueueMovesData),
+    NL_TEST_DEF("Test_EnqueueInPlace", Test_EnqueueInPlace),
+#endif
     NL_TEST_SENTINEL()
 };
 
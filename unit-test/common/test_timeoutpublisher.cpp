@@ -47,7 +47,7 @@ namespace {
         virtual void SetTimeout(const uint64_t aMillisecondsFromNow, const TimeoutPublisherHandle aTimerId) { mTimerMap[aTimerId] = false; /* running = true */ }
         virtual void Start(const TimeoutPublisherHandle aTimerId) { mTimerMap[aTimerId] = true; /* running = true */ }
         virtual void Cancel(const TimeoutPublisherHandle aTimerId) { mTimerMap[aTimerId] = false; /* running = false */ }
-        virtual void StartMetronome(const TimeOffset aPeriodInMilliseconds) {};
+        virtual void ArmMetronome(const TimeOffset aMillisecondsFromNow) {};
         virtual void CancelMetronome() {};
 
         virtual TimeOffset GetTime() const { return 0; } // LCOV_EXCL_LINE
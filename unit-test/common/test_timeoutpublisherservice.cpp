@@ -35,7 +35,7 @@ namespace {
     {
         public:
             _TimeoutPublisherService(Graph& graph)
-            : TimeoutPublisherService(graph)
+            : TimeoutPublisherService(graph), mMetronomeDelay(0)
             {
             }
 
@@ -46,7 +46,7 @@ namespace {
             void SetTimeout(const TimeOffset, const TimeoutPublisherHandle) {}
             void Start(const TimeoutPublisherHandle) {}
             void Cancel(const TimeoutPublisherHandle) {}
-            void StartMetronome(const TimeOffset aPeriodInMilliseconds) {}
+            void ArmMetronome(const TimeOffset aMillisecondsFromNow) { mMetronomeDelay = aMillisecondsFromNow; }
             void CancelMetronome() {}
 
             void TimeoutExpired(const TimeoutPublisherHandle aTimerHandle)
@@ -58,6 +58,8 @@ namespace {
             {
                 TimeoutPublisherService::MetronomeFired();
             }
+
+            TimeOffset mMetronomeDelay;
     };
 
     struct TopicStateA : public TopicState
@@ -204,50 +206,93 @@ static void Test_PeriodicMultiple(nlTestSuite *inSuite, void *inContext)
     Topic<TopicState9ms>* topic9Ptr = graph.ResolveTopic<TopicState9ms>();
     Topic<TopicState15ms>* topic15Ptr = graph.ResolveTopic<TopicState15ms>();
 
-    /* 9ms and 15ms. gcd is 3ms */
+    /* 9ms and 15ms. The metronome is armed for whichever is due next. */
     timeoutPublisherService.SchedulePeriodicPublishing<TopicState9ms>(9);
     timeoutPublisherService.SchedulePeriodicPublishing<TopicState15ms>(15);
     timeoutPublisherService.StartPeriodicPublishing();
+    NL_TEST_ASSERT(inSuite, timeoutPublisherService.mMetronomeDelay == 9);
 
     graph.EvaluateGraph();
     NL_TEST_ASSERT(inSuite, !topic9Ptr->HasNewValue());
     NL_TEST_ASSERT(inSuite, !topic15Ptr->HasNewValue());
 
-    // t = 3ms
+    // t = 9ms
     timeoutPublisherService.MetronomeFired();
     graph.EvaluateGraph();
-    NL_TEST_ASSERT(inSuite, !topic9Ptr->HasNewValue());
+    NL_TEST_ASSERT(inSuite, topic9Ptr->HasNewValue());
     NL_TEST_ASSERT(inSuite, !topic15Ptr->HasNewValue());
+    NL_TEST_ASSERT(inSuite, timeoutPublisherService.mMetronomeDelay == 6);
 
-    // t = 6ms
+    // t = 15ms
     timeoutPublisherService.MetronomeFired();
     graph.EvaluateGraph();
     NL_TEST_ASSERT(inSuite, !topic9Ptr->HasNewValue());
-    NL_TEST_ASSERT(inSuite, !topic15Ptr->HasNewValue());
+    NL_TEST_ASSERT(inSuite, topic15Ptr->HasNewValue());
+    NL_TEST_ASSERT(inSuite, timeoutPublisherService.mMetronomeDelay == 3);
 
-    // t = 9ms
+    // t = 18ms
     timeoutPublisherService.MetronomeFired();
     graph.EvaluateGraph();
     NL_TEST_ASSERT(inSuite, topic9Ptr->HasNewValue());
     NL_TEST_ASSERT(inSuite, !topic15Ptr->HasNewValue());
+    NL_TEST_ASSERT(inSuite, timeoutPublisherService.mMetronomeDelay == 9);
 
-    // t = 12ms
+    // t = 27ms, 30ms, 36ms
     timeoutPublisherService.MetronomeFired();
     graph.EvaluateGraph();
-    NL_TEST_ASSERT(inSuite, !topic9Ptr->HasNewValue());
-    NL_TEST_ASSERT(inSuite, !topic15Ptr->HasNewValue());
-
-    // t = 15ms
     timeoutPublisherService.MetronomeFired();
     graph.EvaluateGraph();
-    NL_TEST_ASSERT(inSuite, !topic9Ptr->HasNewValue());
-    NL_TEST_ASSERT(inSuite, topic15Ptr->HasNewValue());
+    timeoutPublisherService.MetronomeFired();
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, topic9Ptr->HasNewValue());
+    NL_TEST_ASSERT(inSuite, timeoutPublisherService.mMetronomeDelay == 9);
 
-    // t = 18ms
+    // t = 45ms; both are due and are dispatched in the order they were scheduled.
     timeoutPublisherService.MetronomeFired();
     graph.EvaluateGraph();
     NL_TEST_ASSERT(inSuite, topic9Ptr->HasNewValue());
     NL_TEST_ASSERT(inSuite, !topic15Ptr->HasNewValue());
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, !topic9Ptr->HasNewValue());
+    NL_TEST_ASSERT(inSuite, topic15Ptr->HasNewValue());
+}
+
+static void Test_PeriodicWakeups(nlTestSuite *inSuite, void *inContext)
+{
+    struct TopicState7ms : public TopicState {};
+    struct TopicState1s : public TopicState {};
+
+    Graph graph;
+    _TimeoutPublisherService timeoutPublisherService(graph);
+    graph.ResolveTopic<TopicState7ms>();
+    graph.ResolveTopic<TopicState1s>();
+
+    timeoutPublisherService.SchedulePeriodicPublishing<TopicState7ms>(7);
+    timeoutPublisherService.SchedulePeriodicPublishing<TopicState1s>(1000);
+    timeoutPublisherService.StartPeriodicPublishing();
+
+    // A 1ms metronome (the periods' GCD) would wake up 7000 times here; it
+    // now only wakes when either series is due.
+    TimeOffset elapsed = 0;
+    int numWakeups = 0;
+    int num7msPublished = 0;
+    int num1sPublished = 0;
+    while (elapsed + timeoutPublisherService.mMetronomeDelay <= 7000)
+    {
+        elapsed += timeoutPublisherService.mMetronomeDelay;
+        timeoutPublisherService.MetronomeFired();
+        numWakeups++;
+
+        while (graph.HasDataPending())
+        {
+            graph.EvaluateGraph();
+            num7msPublished += graph.ResolveTopic<TopicState7ms>()->HasNewValue() ? 1 : 0;
+            num1sPublished += graph.ResolveTopic<TopicState1s>()->HasNewValue() ? 1 : 0;
+        }
+    }
+    NL_TEST_ASSERT(inSuite, numWakeups == 1000 + 6);
+    NL_TEST_ASSERT(inSuite, num7msPublished == 1000);
+    NL_TEST_ASSERT(inSuite, num1sPublished == 7);
 }
 
 static const nlTest sTests[] = {
@@ -257,6 +302,7 @@ static const nlTest sTests[] = {
     NL_TEST_DEF("Test_DispatchMultiple", Test_DispatchMultiple),
     NL_TEST_DEF("Test_PeriodicOne", Test_PeriodicOne),
     NL_TEST_DEF("Test_PeriodicMultiple", Test_PeriodicMultiple),
+    NL_TEST_DEF("Test_PeriodicWakeups", Test_PeriodicWakeups),
     NL_TEST_SENTINEL()
 };
 
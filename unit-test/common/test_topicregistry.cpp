@@ -81,10 +81,36 @@ static void Test_CleanupWithScope(nlTestSuite *inSuite, void *inContext)
     }
 }
 
+#if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
+static void Test_IndependentRegistries(nlTestSuite *inSuite, void *inContext)
+{
+    TopicRegistry registry1;
+    TopicRegistry registry2;
+    Topic<TopicStateA> topicA1;
+    Topic<TopicStateA> topicA2;
+    Topic<TopicStateB> topicB2;
+
+    registry1.Register(&topicA1);
+    registry2.Register(&topicB2);
+    registry2.Register(&topicA2);
+
+    NL_TEST_ASSERT(inSuite, registry1.Resolve<TopicStateA>() == &topicA1);
+    NL_TEST_ASSERT(inSuite, registry1.Resolve<TopicStateB>() == NULL);
+    NL_TEST_ASSERT(inSuite, registry2.Resolve<TopicStateA>() == &topicA2);
+    NL_TEST_ASSERT(inSuite, registry2.Resolve<TopicStateB>() == &topicB2);
+
+    TopicRegistry copy(registry2);
+    NL_TEST_ASSERT(inSuite, copy.Resolve<TopicStateA>() == &topicA2);
+}
+#endif
+
 static const nlTest sTests[] = {
     NL_TEST_DEF("Test_ResolveUnregistered", Test_ResolveUnregistered),
     NL_TEST_DEF("Test_ResolveRegistered", Test_ResolveRegistered),
     NL_TEST_DEF("Test_CleanupWithScope", Test_CleanupWithScope),
+#if !defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_LITE)
+    NL_TEST_DEF("Test_IndependentRegistries", Test_IndependentRegistries),
+#endif
     NL_TEST_SENTINEL()
 };
 
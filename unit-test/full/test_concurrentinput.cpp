@@ -0,0 +1,403 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nltest.h"
+#include "errortype.hpp"
+
+#include "test_concurrentinput.h"
+
+#include "graph.hpp"
+#include "detector.hpp"
+#include "topicstate.hpp"
+#include "publisher.hpp"
+#include "futurepublisher.hpp"
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT)
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#endif
+
+#define SUITE_DECLARATION(name, test_ptr) { #name, test_ptr, setup_##name, teardown_##name }
+
+using namespace DetectorGraph;
+
+static int setup_concurrentinput(void *inContext)
+{
+    return 0;
+}
+
+static int teardown_concurrentinput(void *inContext)
+{
+    return 0;
+}
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT)
+namespace
+{
+    struct Sample : public TopicState
+    {
+        Sample(int aProducer = 0, int aSequence = 0) : mProducer(aProducer), mSequence(aSequence) {}
+        int mProducer;
+        int mSequence;
+    };
+
+    struct Echo : public TopicState
+    {
+        Echo(int aV = 0) : mV(aV) {}
+        int mV;
+    };
+
+    struct Big : public TopicState
+    {
+        Big() : mFirst(0), mLast(0) {}
+        int mFirst;
+        char mPayload[256];
+        int mLast;
+    };
+
+    class SampleSequenceDetector
+    : public Detector
+    , public SubscriberInterface<Sample>
+    , public SubscriberInterface<Big>
+    , public Publisher<Echo>
+    , public FuturePublisher<Echo>
+    {
+    public:
+        SampleSequenceDetector(Graph* graph, int aNumProducers)
+        : Detector(graph), mNextSequence(aNumProducers, 0), mOutOfOrder(0), mBigFirst(0), mBigLast(0)
+        {
+            Subscribe<Sample>(this);
+            Subscribe<Big>(this);
+            SetupPublishing<Echo>(this);
+            SetupFuturePublishing<Echo>(this);
+        }
+
+        virtual void Evaluate(const Sample& aSample)
+        {
+            if (aSample.mSequence != mNextSequence[aSample.mProducer])
+            {
+                mOutOfOrder++;
+            }
+            mNextSequence[aSample.mProducer] = aSample.mSequence + 1;
+            Publisher<Echo>::Publish(Echo(aSample.mSequence));
+        }
+
+        virtual void Evaluate(const Big& aBig)
+        {
+            mBigFirst = aBig.mFirst;
+            mBigLast = aBig.mLast;
+            PublishOnFutureEvaluation(Echo(-1));
+        }
+
+        std::vector<int> mNextSequence;
+        int mOutOfOrder;
+        int mBigFirst;
+        int mBigLast;
+    };
+
+    struct Tick : public TopicState
+    {
+    };
+
+    class RepublishingDetector
+    : public Detector
+    , public SubscriberInterface<Tick>
+    , public FuturePublisher<Tick>
+    {
+    public:
+        RepublishingDetector(Graph* graph) : Detector(graph), mEnabled(true)
+        {
+            Subscribe<Tick>(this);
+            SetupFuturePublishing<Tick>(this);
+        }
+
+        virtual void Evaluate(const Tick&)
+        {
+            if (mEnabled)
+            {
+                PublishOnFutureEvaluation(Tick());
+            }
+        }
+
+        bool mEnabled;
+    };
+}
+
+static void Test_RequiresEnabling(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread(Sample()) == ErrorType_BadConfiguration);
+    NL_TEST_ASSERT(inSuite, graph.HasDataPending() == false);
+    NL_TEST_ASSERT(inSuite, graph.WaitForDataPending(0) == false);
+}
+
+static void Test_DispatchesInOrder(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    SampleSequenceDetector detector(&graph, 1);
+    graph.EnableConcurrentInput(4);
+
+    const Sample lvalue(0, 0);
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread<Sample>(lvalue) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread(Sample(0, 1)) == ErrorType_Success);
+    Big big;
+    big.mFirst = 1;
+    big.mLast = 2;
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread(big) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread(Sample(0, 2)) == ErrorType_Success);
+
+    // Full
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread(Sample(0, 3)) == ErrorType_NoResource);
+    NL_TEST_ASSERT(inSuite, graph.HasDataPending() == true);
+    NL_TEST_ASSERT(inSuite, graph.WaitForDataPending(1000) == true);
+
+    graph.EvaluateGraph();
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, graph.GetOutputView().size() == 2);
+    NL_TEST_ASSERT(inSuite, graph.ResolveTopic<Echo>()->GetNewValue().mV == 1);
+
+    // Big (inline storage overflow) goes through the heap.
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, detector.mBigFirst == 1 && detector.mBigLast == 2);
+
+    // The FuturePublished Echo queues behind the concurrent input that was
+    // already pending.
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, graph.ResolveTopic<Echo>()->GetNewValue().mV == 2);
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, graph.ResolveTopic<Echo>()->GetNewValue().mV == -1);
+
+    NL_TEST_ASSERT(inSuite, graph.HasDataPending() == false);
+    NL_TEST_ASSERT(inSuite, graph.WaitForDataPending(1) == false);
+    NL_TEST_ASSERT(inSuite, detector.mOutOfOrder == 0);
+}
+
+static void Test_FuturePublisherDoesNotStarveProducers(nlTestSuite *inSuite, void *inContext)
+{
+    const int kNumSamples = 2000;
+
+    Graph graph;
+    SampleSequenceDetector detector(&graph, 1);
+    RepublishingDetector republisher(&graph);
+    graph.EnableConcurrentInput(8);
+    graph.PushData(Tick());
+
+    std::thread producer([&graph, kNumSamples]() {
+        for (int i = 0; i < kNumSamples; ++i)
+        {
+            while (graph.PushDataFromAnyThread(Sample(0, i)) != ErrorType_Success)
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    // A Tick is pending on every evaluation.
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (detector.mNextSequence[0] < kNumSamples && std::chrono::steady_clock::now() < deadline)
+    {
+        graph.EvaluateGraph();
+    }
+    NL_TEST_ASSERT(inSuite, detector.mNextSequence[0] == kNumSamples);
+    NL_TEST_ASSERT(inSuite, detector.mOutOfOrder == 0);
+
+    // Lets the producer finish either way.
+    republisher.mEnabled = false;
+    while (graph.HasDataPending() || detector.mNextSequence[0] < kNumSamples)
+    {
+        graph.EvaluateGraph();
+    }
+    producer.join();
+
+    // And the inputs follow their Topic's priority.
+    graph.SetInputPriority<Sample>(1);
+    republisher.mEnabled = true;
+    graph.PushData(Tick());
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread(Sample(0, kNumSamples)) == ErrorType_Success);
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, detector.mNextSequence[0] == kNumSamples + 1);
+}
+
+static void Test_CreatesTopicsOnGraphThread(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    graph.EnableConcurrentInput(2);
+
+    // Nothing subscribes to Echo and its Topic doesn't exist yet.
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread(Echo(5)) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, graph.EvaluateGraph() == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, graph.GetOutputView().size() == 1);
+    NL_TEST_ASSERT(inSuite, graph.ResolveTopic<Echo>()->GetNewValue().mV == 5);
+}
+
+static void Test_MultipleProducers(nlTestSuite *inSuite, void *inContext)
+{
+    const int kNumProducers = 8;
+    const int kSamplesPerProducer = 20000;
+
+    Graph graph;
+    SampleSequenceDetector detector(&graph, kNumProducers);
+    graph.EnableConcurrentInput(64);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kNumProducers; ++p)
+    {
+        producers.push_back(std::thread([&graph, p, kSamplesPerProducer]() {
+            for (int i = 0; i < kSamplesPerProducer; ++i)
+            {
+                while (graph.PushDataFromAnyThread(Sample(p, i)) != ErrorType_Success)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+
+    int numEvaluated = 0;
+    while (numEvaluated < kNumProducers * kSamplesPerProducer)
+    {
+        if (graph.WaitForDataPending(10000))
+        {
+            graph.EvaluateGraph();
+            numEvaluated++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    for (std::vector<std::thread>::iterator it = producers.begin(); it != producers.end(); ++it)
+    {
+        it->join();
+    }
+
+    NL_TEST_ASSERT(inSuite, numEvaluated == kNumProducers * kSamplesPerProducer);
+    NL_TEST_ASSERT(inSuite, detector.mOutOfOrder == 0);
+    for (int p = 0; p < kNumProducers; ++p)
+    {
+        NL_TEST_ASSERT(inSuite, detector.mNextSequence[p] == kSamplesPerProducer);
+    }
+    NL_TEST_ASSERT(inSuite, graph.HasDataPending() == false);
+}
+
+static void Test_DropsPendingInputs(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    graph.EnableConcurrentInput(8);
+    Big big;
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread(big) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread(Echo(1)) == ErrorType_Success);
+
+    graph.EnableConcurrentInput(0);
+    NL_TEST_ASSERT(inSuite, graph.HasDataPending() == false);
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread(Echo(1)) == ErrorType_BadConfiguration);
+
+    // And pending inputs are freed with the Graph.
+    graph.EnableConcurrentInput(8);
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread(big) == ErrorType_Success);
+}
+
+static void Test_DropNewestPolicy(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    graph.EnableConcurrentInput(2, kDropNewestInput);
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread(Echo(1)) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread(Echo(2)) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, graph.PushDataFromAnyThread(Echo(3)) == ErrorType_Success);
+
+    InputQueueStats stats = graph.GetConcurrentInputQueueStats();
+    NL_TEST_ASSERT(inSuite, stats.depth == 2);
+    NL_TEST_ASSERT(inSuite, stats.highWaterMark == 2);
+    NL_TEST_ASSERT(inSuite, stats.numDropped == 1);
+
+    graph.EvaluateGraph();
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, graph.ResolveTopic<Echo>()->GetNewValue().mV == 2);
+    NL_TEST_ASSERT(inSuite, graph.HasDataPending() == false);
+
+    graph.ResetInputQueueStats();
+    stats = graph.GetConcurrentInputQueueStats();
+    NL_TEST_ASSERT(inSuite, stats.highWaterMark == 0 && stats.numDropped == 0);
+}
+
+static void Test_BlockProducerPolicy(nlTestSuite *inSuite, void *inContext)
+{
+    const int kNumProducers = 4;
+    const int kSamplesPerProducer = 5000;
+
+    Graph graph;
+    SampleSequenceDetector detector(&graph, kNumProducers);
+    graph.EnableConcurrentInput(4, kBlockProducer);
+
+    std::atomic<int> numFailed(0);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kNumProducers; ++p)
+    {
+        producers.push_back(std::thread([&graph, &numFailed, p, kSamplesPerProducer]() {
+            for (int i = 0; i < kSamplesPerProducer; ++i)
+            {
+                if (graph.PushDataFromAnyThread(Sample(p, i)) != ErrorType_Success)
+                {
+                    numFailed++;
+                }
+            }
+        }));
+    }
+
+    int numEvaluated = 0;
+    while (numEvaluated < kNumProducers * kSamplesPerProducer && graph.WaitForDataPending(10000))
+    {
+        graph.EvaluateGraph();
+        numEvaluated++;
+    }
+
+    for (std::vector<std::thread>::iterator it = producers.begin(); it != producers.end(); ++it)
+    {
+        it->join();
+    }
+
+    NL_TEST_ASSERT(inSuite, numFailed == 0);
+    NL_TEST_ASSERT(inSuite, numEvaluated == kNumProducers * kSamplesPerProducer);
+    NL_TEST_ASSERT(inSuite, detector.mOutOfOrder == 0);
+    NL_TEST_ASSERT(inSuite, graph.GetConcurrentInputQueueStats().highWaterMark <= 4);
+    NL_TEST_ASSERT(inSuite, graph.GetConcurrentInputQueueStats().numRejected == 0);
+}
+#endif
+
+static const nlTest sTests[] = {
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_CONCURRENT_INPUT)
+    NL_TEST_DEF("Test_RequiresEnabling", Test_RequiresEnabling),
+    NL_TEST_DEF("Test_DispatchesInOrder", Test_DispatchesInOrder),
+    NL_TEST_DEF("Test_FuturePublisherDoesNotStarveProducers", Test_FuturePublisherDoesNotStarveProducers),
+    NL_TEST_DEF("Test_CreatesTopicsOnGraphThread", Test_CreatesTopicsOnGraphThread),
+    NL_TEST_DEF("Test_MultipleProducers", Test_MultipleProducers),
+    NL_TEST_DEF("Test_DropsPendingInputs", Test_DropsPendingInputs),
+    NL_TEST_DEF("Test_DropNewestPolicy", Test_DropNewestPolicy),
+    NL_TEST_DEF("Test_BlockProducerPolicy", Test_BlockProducerPolicy),
+#endif
+    NL_TEST_SENTINEL()
+};
+
+//This function creates the Suite (i.e: the name of your test and points to the array of test functions)
+extern "C"
+int concurrentinput_testsuite(void)
+{
+    nlTestSuite theSuite = SUITE_DECLARATION(concurrentinput, &sTests[0]);
+    nlTestRunner(&theSuite, NULL);
+    return nlTestRunnerStats(&theSuite);
+}
@@ -22,6 +22,9 @@
 #include "topicstate.hpp"
 #include "detector.hpp"
 #include "dglogging.hpp"
+#include "resumefromsnapshottopicstate.hpp"
+
+#include <map>
 
 #define SUITE_DECLARATION(name, test_ptr) { #name, test_ptr, setup_##name, teardown_##name }
 
@@ -614,6 +617,427 @@ static void Test_TopicDataTypes(nlTestSuite *inSuite, void *inContext)
     delete graph;
 }
 
+static void Test_SparseEvaluation(nlTestSuite *inSuite, void *inContext)
+{
+    /*
+     * Only vertices reachable from the topic that received the input are
+     * visited on an evaluation. To test that, assume the graph:
+     *
+     *   TopicB              TopicAnonymous
+     *   ^
+     *   |                   IdleVertex
+     *   TestDetector
+     *   ^
+     *   |
+     *   TopicA
+     *
+     * IdleVertex has no edges and so should never be visited.
+     */
+    class CountingVertex : public Vertex
+    {
+    public:
+        CountingVertex() : mProcessCount(0) { }
+        virtual ~CountingVertex() { }
+        void ProcessVertex() { mProcessCount++; } // LCOV_EXCL_LINE
+        VertexType GetVertexType() const { return Vertex::kTestVertex; } // LCOV_EXCL_LINE
+        int mProcessCount;
+    };
+
+    Graph graph;
+    TestDetector detector(&graph);
+    CountingVertex idleVertex;
+    graph.AddVertex(&idleVertex);
+
+    graph.PushData<PacketTypeA>(PacketTypeA(11));
+    graph.PushData<PacketTypeAnonymous>(PacketTypeAnonymous(22));
+
+    ErrorType r = graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, r == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, detector.mEvalCount == 1);
+    NL_TEST_ASSERT(inSuite, idleVertex.mProcessCount == 0);
+    NL_TEST_ASSERT(inSuite, graph.ResolveTopic<PacketTypeB>()->GetCurrentValues().size() == 1);
+
+    r = graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, r == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, detector.mEvalCount == 1);
+    NL_TEST_ASSERT(inSuite, idleVertex.mProcessCount == 0);
+    NL_TEST_ASSERT(inSuite, graph.ResolveTopic<PacketTypeAnonymous>()->GetCurrentValues().size() == 1);
+
+    // Topics visited on the previous evaluation are still cleared.
+    NL_TEST_ASSERT(inSuite, graph.ResolveTopic<PacketTypeA>()->GetCurrentValues().size() == 0);
+    NL_TEST_ASSERT(inSuite, graph.ResolveTopic<PacketTypeB>()->GetCurrentValues().size() == 0);
+    NL_TEST_ASSERT(inSuite, graph.GetOutputList().size() == 1);
+
+    graph.RemoveVertex(&idleVertex);
+}
+
+static void Test_StateClearedOnNextEvaluation(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    TestDetector detector(&graph);
+    Topic<PacketTypeA>* ta = graph.ResolveTopic<PacketTypeA>();
+    Topic<PacketTypeB>* tb = graph.ResolveTopic<PacketTypeB>();
+
+    graph.PushData<PacketTypeA>(PacketTypeA(11));
+    ErrorType r = graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, r == ErrorType_Success);
+
+    // States are kept in between evaluations so outputs can be inspected.
+    NL_TEST_ASSERT(inSuite, ta->GetState() == Vertex::kVertexDone);
+    NL_TEST_ASSERT(inSuite, detector.GetState() == Vertex::kVertexDone);
+    NL_TEST_ASSERT(inSuite, tb->GetState() == Vertex::kVertexDone);
+    NL_TEST_ASSERT(inSuite, tb->HasNewValue());
+
+    r = graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, r == ErrorType_Success);
+
+    // None of them were visited and yet all of them read as clear.
+    NL_TEST_ASSERT(inSuite, ta->GetState() == Vertex::kVertexClear);
+    NL_TEST_ASSERT(inSuite, detector.GetState() == Vertex::kVertexClear);
+    NL_TEST_ASSERT(inSuite, tb->GetState() == Vertex::kVertexClear);
+    NL_TEST_ASSERT(inSuite, !tb->HasNewValue());
+    NL_TEST_ASSERT(inSuite, tb->GetCurrentValues().size() == 0);
+}
+
+namespace {
+    struct PacketTypeBSubscriber : public Detector, public SubscriberInterface<PacketTypeB>
+    {
+        PacketTypeBSubscriber(Graph* graph) : Detector(graph), mEvalCount(0)
+        {
+            Subscribe<PacketTypeB>(this);
+        }
+        virtual void Evaluate(const PacketTypeB&)
+        {
+            mEvalCount++;
+        }
+        int mEvalCount;
+    };
+}
+
+static void Test_PlanRecompiledOnTopologyChange(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    TestDetector detector(&graph);
+
+    graph.PushData<PacketTypeA>(PacketTypeA(11));
+    ErrorType r = graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, r == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, graph.GetOutputList().size() == 2);
+
+    {
+        // Extends the already compiled graph downstream of TopicB.
+        PacketTypeBSubscriber subscriber(&graph);
+
+        graph.PushData<PacketTypeA>(PacketTypeA(22));
+        r = graph.EvaluateGraph();
+        NL_TEST_ASSERT(inSuite, r == ErrorType_Success);
+        NL_TEST_ASSERT(inSuite, detector.mEvalCount == 2);
+        NL_TEST_ASSERT(inSuite, subscriber.mEvalCount == 1);
+        NL_TEST_ASSERT(inSuite, graph.GetOutputList().size() == 2);
+    }
+
+    // And keeps working once the new detector is gone.
+    graph.PushData<PacketTypeA>(PacketTypeA(33));
+    r = graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, r == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, detector.mEvalCount == 3);
+    NL_TEST_ASSERT(inSuite, graph.GetOutputList().size() == 2);
+}
+
+static void Test_DeepGraphToposort(nlTestSuite *inSuite, void *inContext)
+{
+    class TestVertex : public Vertex
+    {
+    public:
+        TestVertex() { }
+        virtual ~TestVertex() { }
+        void ProcessVertex() { } // LCOV_EXCL_LINE
+        VertexType GetVertexType() const { return Vertex::kTestVertex; } // LCOV_EXCL_LINE
+    };
+
+    // Deep enough to overflow the stack with a recursive DFS.
+    const unsigned kChainLength = 200000;
+
+    Graph graph;
+    Vertex* previous = NULL;
+    for (unsigned i = 0; i < kChainLength; ++i)
+    {
+        Vertex* current = new TestVertex();
+        if (previous != NULL)
+        {
+            current->InsertEdge(previous);
+        }
+        graph.AddVertex(current);
+        previous = current;
+    }
+
+    ErrorType r = graph.TopoSortGraph();
+    NL_TEST_ASSERT(inSuite, r == ErrorType_Success);
+
+    // The chain was built backwards, so the last vertex added comes first.
+    NL_TEST_ASSERT(inSuite, graph.GetVertices().front() == previous);
+    NL_TEST_ASSERT(inSuite, graph.GetVertices().size() == kChainLength);
+}
+
+namespace {
+    struct PacketTypeC : public TopicState { PacketTypeC(int aV = 0) : mV(aV) {}; int mV; };
+    struct PacketTypeCToA : public Detector, public SubscriberInterface<PacketTypeC>, public Publisher<PacketTypeA>
+    {
+        PacketTypeCToA(Graph* graph) : Detector(graph)
+        {
+            Subscribe<PacketTypeC>(this);
+            SetupPublishing<PacketTypeA>(this);
+        }
+        virtual void Evaluate(const PacketTypeC& aInData)
+        {
+            Publish(PacketTypeA(aInData.mV));
+        }
+    };
+
+    bool IsTopologicallySorted(const Graph& aGraph)
+    {
+        std::map<const Vertex*, unsigned> positions;
+        unsigned position = 0;
+        for (Graph::VertexPtrContainer::const_iterator vIt = aGraph.GetVertices().begin();
+            vIt != aGraph.GetVertices().end(); ++vIt)
+        {
+            positions[*vIt] = position++;
+        }
+
+        for (Graph::VertexPtrContainer::const_iterator vIt = aGraph.GetVertices().begin();
+            vIt != aGraph.GetVertices().end(); ++vIt)
+        {
+            for (Vertex::VertexPtrContainer::const_iterator outIt = (*vIt)->GetOutEdges().begin();
+                outIt != (*vIt)->GetOutEdges().end(); ++outIt)
+            {
+                if (positions[*outIt] <= positions[*vIt])
+                {
+                    return false; // LCOV_EXCL_LINE
+                }
+            }
+        }
+        return true;
+    }
+}
+
+static void Test_IncrementalToposort(nlTestSuite *inSuite, void *inContext)
+{
+    /*
+     * PacketTypeCToA is added after the graph below was sorted and has to be
+     * placed upstream of everything that was there before:
+     *
+     *   TopicC -> PacketTypeCToA -> TopicA -> TestDetector -> TopicB -> PacketTypeBSubscriber
+     */
+    Graph graph;
+    TestDetector detector(&graph);
+    PacketTypeBSubscriber subscriber(&graph);
+
+    graph.PushData<PacketTypeA>(PacketTypeA(11));
+    ErrorType r = graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, r == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, IsTopologicallySorted(graph));
+
+    {
+        PacketTypeCToA upstreamDetector(&graph);
+
+        graph.PushData<PacketTypeC>(PacketTypeC(22));
+        r = graph.EvaluateGraph();
+        NL_TEST_ASSERT(inSuite, r == ErrorType_Success);
+        NL_TEST_ASSERT(inSuite, IsTopologicallySorted(graph));
+        NL_TEST_ASSERT(inSuite, detector.mEvalCount == 2);
+        NL_TEST_ASSERT(inSuite, detector.mOutData.mV == 22);
+        NL_TEST_ASSERT(inSuite, subscriber.mEvalCount == 2);
+        NL_TEST_ASSERT(inSuite, graph.GetOutputList().size() == 3);
+    }
+
+    graph.PushData<PacketTypeC>(PacketTypeC(33));
+    r = graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, r == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, IsTopologicallySorted(graph));
+    NL_TEST_ASSERT(inSuite, detector.mEvalCount == 2);
+    NL_TEST_ASSERT(inSuite, graph.GetOutputList().size() == 1);
+}
+
+static void Test_OutputView(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    TestDetector detector(&graph);
+    Topic<PacketTypeA>* topicA = graph.ResolveTopic<PacketTypeA>();
+
+    // Before any evaluation
+    NL_TEST_ASSERT(inSuite, graph.GetOutputView().empty());
+
+    graph.PushData<PacketTypeA>(PacketTypeA(7));
+    graph.EvaluateGraph();
+
+    // The view yields the same states as GetOutputList, in the same order,
+    // without copying them.
+    OutputView view = graph.GetOutputView();
+    NL_TEST_ASSERT(inSuite, view.size() == 2);
+    OutputView::const_iterator it = view.begin();
+    NL_TEST_ASSERT(inSuite, it->GetId() == kPacketTypeA);
+    NL_TEST_ASSERT(inSuite, &(*it) == &topicA->GetNewValue());
+    NL_TEST_ASSERT(inSuite, static_cast<const PacketTypeA&>(*it).mV == 7);
+    ++it;
+    NL_TEST_ASSERT(inSuite, it->GetId() == kPacketTypeB);
+    NL_TEST_ASSERT(inSuite, static_cast<const PacketTypeB&>(*it).mV == 7);
+    ++it;
+    NL_TEST_ASSERT(inSuite, it == view.end());
+
+    // Materialized copies outlive the next evaluation.
+    const std::list<ptr::shared_ptr<const TopicState> > outputs = graph.GetOutputList();
+    NL_TEST_ASSERT(inSuite, outputs.size() == 2);
+    NL_TEST_ASSERT(inSuite, outputs.front().get() != &topicA->GetNewValue());
+
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, graph.GetOutputView().empty());
+    NL_TEST_ASSERT(inSuite, graph.GetOutputList().size() == 0);
+    NL_TEST_ASSERT(inSuite, ptr::dynamic_pointer_cast<const PacketTypeA>(outputs.front())->mV == 7);
+}
+
+static void Test_NamedTopicsOnlyOutput(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    graph.SetOutputFilter(Graph::kOutputNamedTopicsOnly);
+
+    graph.PushData<PacketTypeAnonymous>(PacketTypeAnonymous(101));
+    graph.PushData<PacketTypeA>(PacketTypeA(99));
+
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, graph.GetOutputView().empty());
+    NL_TEST_ASSERT(inSuite, graph.GetOutputList().size() == 0);
+
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, graph.GetOutputView().size() == 1);
+    NL_TEST_ASSERT(inSuite, graph.GetOutputList().size() == 1);
+    NL_TEST_ASSERT(inSuite, graph.GetOutputList().front()->GetId() == kPacketTypeA);
+
+    // Switching back applies to the current output too.
+    graph.PushData<PacketTypeAnonymous>(PacketTypeAnonymous(102));
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, graph.GetOutputList().size() == 0);
+    graph.SetOutputFilter(Graph::kOutputAllTopics);
+    NL_TEST_ASSERT(inSuite, graph.GetOutputList().size() == 1);
+    NL_TEST_ASSERT(inSuite, graph.GetOutputView().begin()->GetId() == TopicState::kAnonymousTopicState);
+}
+
+static void Test_BoundedInputQueue(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    graph.SetInputQueueCapacity(2);
+
+    NL_TEST_ASSERT(inSuite, graph.PushData<PacketTypeA>(PacketTypeA(1)) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, graph.PushData<PacketTypeA>(PacketTypeA(2)) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, graph.PushData<PacketTypeA>(PacketTypeA(3)) == ErrorType_NoResource);
+
+    InputQueueStats stats = graph.GetInputQueueStats();
+    NL_TEST_ASSERT(inSuite, stats.depth == 2);
+    NL_TEST_ASSERT(inSuite, stats.highWaterMark == 2);
+    NL_TEST_ASSERT(inSuite, stats.numRejected == 1);
+
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, graph.PushData<PacketTypeA>(PacketTypeA(3)) == ErrorType_Success);
+    graph.EvaluateGraph();
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, graph.ResolveTopic<PacketTypeA>()->GetNewValue().mV == 3);
+
+    graph.ResetInputQueueStats();
+    stats = graph.GetInputQueueStats();
+    NL_TEST_ASSERT(inSuite, stats.depth == 0 && stats.highWaterMark == 0 && stats.numRejected == 0);
+
+    // Back to unbounded.
+    graph.SetInputQueueCapacity(0);
+    for (int i = 0; i < 10; ++i)
+    {
+        NL_TEST_ASSERT(inSuite, graph.PushData<PacketTypeA>(PacketTypeA(i)) == ErrorType_Success);
+    }
+}
+
+static void Test_InputConflation(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    TestDetector detector(&graph);
+    graph.SetInputConflation<PacketTypeA>(true);
+
+    for (int i = 1; i <= 100; ++i)
+    {
+        graph.PushData<PacketTypeA>(PacketTypeA(i));
+        graph.PushData<PacketTypeAnonymous>(PacketTypeAnonymous(i));
+    }
+
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, detector.mEvalCount == 1);
+    NL_TEST_ASSERT(inSuite, detector.mInData.mV == 100);
+
+    int numEvaluations = 1;
+    while (graph.EvaluateIfHasDataPending())
+    {
+        numEvaluations++;
+    }
+    NL_TEST_ASSERT(inSuite, numEvaluations == 101);
+    NL_TEST_ASSERT(inSuite, detector.mEvalCount == 1);
+    NL_TEST_ASSERT(inSuite, graph.GetInputQueueStats().numConflated == 99);
+}
+
+static void Test_InputPriority(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    TestDetector detector(&graph);
+    graph.SetInputPriority<PacketTypeA>(1);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        graph.PushData<PacketTypeAnonymous>(PacketTypeAnonymous(i));
+    }
+    graph.PushData<PacketTypeA>(PacketTypeA(1));
+    graph.PushDataWithDeadline<PacketTypeA>(PacketTypeA(2), 100);
+
+    // Both alarms go ahead of the telemetry backlog, the one with a deadline
+    // first.
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, detector.mEvalCount == 1);
+    NL_TEST_ASSERT(inSuite, detector.mInData.mV == 2);
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, detector.mEvalCount == 2);
+    NL_TEST_ASSERT(inSuite, detector.mInData.mV == 1);
+
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, graph.ResolveTopic<PacketTypeAnonymous>()->GetNewValue().mV == 0);
+    NL_TEST_ASSERT(inSuite, graph.GetInputQueueStats().depth == 999);
+}
+
+static void Test_ResumeFromSharedSnapshot(nlTestSuite *inSuite, void *inContext)
+{
+    struct ResumingDetector : public Detector, public SubscriberInterface<ResumeFromSnapshotTopicState>
+    {
+        ResumingDetector(Graph* graph) : Detector(graph)
+        {
+            Subscribe<ResumeFromSnapshotTopicState>(this);
+        }
+        void Evaluate(const ResumeFromSnapshotTopicState& aResumeFrom)
+        {
+            mpSnapshot = aResumeFrom.snapshot.get();
+        }
+        const StateSnapshot* mpSnapshot = NULL;
+    };
+
+    Graph graph;
+    ResumingDetector detectorA(&graph);
+    ResumingDetector detectorB(&graph);
+
+    std::list< ptr::shared_ptr<const TopicState> > resumeStates;
+    resumeStates.push_back(ptr::shared_ptr<const TopicState>(new PacketTypeA(7)));
+    const ptr::shared_ptr<const StateSnapshot> resumeSnapshot(new StateSnapshot(resumeStates));
+
+    graph.PushData<ResumeFromSnapshotTopicState>(ResumeFromSnapshotTopicState(resumeSnapshot));
+    graph.EvaluateGraph();
+
+    // No copies of the snapshot are made on the way to the detectors.
+    NL_TEST_ASSERT(inSuite, detectorA.mpSnapshot == resumeSnapshot.get());
+    NL_TEST_ASSERT(inSuite, detectorB.mpSnapshot == resumeSnapshot.get());
+    NL_TEST_ASSERT(inSuite, graph.ResolveTopic<ResumeFromSnapshotTopicState>()->GetNewValue().snapshot == resumeSnapshot);
+}
+
 static const nlTest sTests[] = {
     NL_TEST_DEF("Test_Lifetime", Test_Lifetime),
     NL_TEST_DEF("Test_Toposort", Test_Toposort),
@@ -627,6 +1051,17 @@ static const nlTest sTests[] = {
     NL_TEST_DEF("Test_EvaluateGraph", Test_EvaluateGraph),
     NL_TEST_DEF("Test_NonEmptyQueues", Test_NonEmptyQueues),
     NL_TEST_DEF("Test_TopicDataTypes", Test_TopicDataTypes),
+    NL_TEST_DEF("Test_SparseEvaluation", Test_SparseEvaluation),
+    NL_TEST_DEF("Test_StateClearedOnNextEvaluation", Test_StateClearedOnNextEvaluation),
+    NL_TEST_DEF("Test_PlanRecompiledOnTopologyChange", Test_PlanRecompiledOnTopologyChange),
+    NL_TEST_DEF("Test_DeepGraphToposort", Test_DeepGraphToposort),
+    NL_TEST_DEF("Test_IncrementalToposort", Test_IncrementalToposort),
+    NL_TEST_DEF("Test_OutputView", Test_OutputView),
+    NL_TEST_DEF("Test_NamedTopicsOnlyOutput", Test_NamedTopicsOnlyOutput),
+    NL_TEST_DEF("Test_BoundedInputQueue", Test_BoundedInputQueue),
+    NL_TEST_DEF("Test_InputConflation", Test_InputConflation),
+    NL_TEST_DEF("Test_InputPriority", Test_InputPriority),
+    NL_TEST_DEF("Test_ResumeFromSharedSnapshot", Test_ResumeFromSharedSnapshot),
     NL_TEST_SENTINEL()
 };
 
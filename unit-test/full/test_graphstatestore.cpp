@@ -291,6 +291,271 @@ static void Test_GetStateVersion(nlTestSuite *inSuite, void *inContext)
     NL_TEST_ASSERT(inSuite, lastStateSnapshot->GetStateVersion() == 10);
 }
 
+namespace {
+    struct NumberedPacket : public TopicState
+    {
+        NumberedPacket(TopicStateIdType aId = 0, int aV = 0) : mId(aId), mV(aV) {}
+        virtual TopicStateIdType GetId() const { return mId; }
+        TopicStateIdType mId;
+        int mV;
+    };
+
+    int GetNumberedValue(const StateSnapshot& arSnapshot, TopicStateIdType aId)
+    {
+        ptr::shared_ptr<const TopicState> state = arSnapshot.GetState(aId);
+        return state ? ptr::static_pointer_cast<const NumberedPacket>(state)->mV : -1;
+    }
+}
+
+static void Test_SparseTopicStateIds(nlTestSuite *inSuite, void *inContext)
+{
+    const TopicStateIdType ids[] = { 7, 0, 4096, 15, 16, 0x7FFFFFFF, 255 };
+    const size_t numIds = sizeof(ids) / sizeof(ids[0]);
+
+    std::list< ptr::shared_ptr<const TopicState> > primeList;
+    for (size_t i = 0; i < numIds; ++i)
+    {
+        primeList.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(ids[i], (int)i)));
+    }
+    StateSnapshot snapshot(primeList);
+
+    NL_TEST_ASSERT(inSuite, snapshot.GetMapSize() == numIds);
+    for (size_t i = 0; i < numIds; ++i)
+    {
+        NL_TEST_ASSERT(inSuite, GetNumberedValue(snapshot, ids[i]) == (int)i);
+    }
+    NL_TEST_ASSERT(inSuite, !snapshot.GetState(1));
+    NL_TEST_ASSERT(inSuite, !snapshot.GetState(4097));
+    NL_TEST_ASSERT(inSuite, !snapshot.GetState(TopicState::kAnonymousTopicState));
+
+    std::list< ptr::shared_ptr<const TopicState> > outputList;
+    snapshot.GetTopicStates(outputList);
+    NL_TEST_ASSERT(inSuite, outputList.size() == numIds);
+
+    TopicStateIdType previousId = -1;
+    for (std::list< ptr::shared_ptr<const TopicState> >::const_iterator it = outputList.begin();
+        it != outputList.end();
+        ++it)
+    {
+        NL_TEST_ASSERT(inSuite, (*it)->GetId() > previousId);
+        previousId = (*it)->GetId();
+    }
+}
+
+static void Test_SingleZeroTopicStateId(nlTestSuite *inSuite, void *inContext)
+{
+    std::list< ptr::shared_ptr<const TopicState> > primeList;
+    primeList.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(0, 5)));
+    StateSnapshot snapshot(primeList);
+
+    NL_TEST_ASSERT(inSuite, snapshot.GetMapSize() == 1);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(snapshot, 0) == 5);
+    NL_TEST_ASSERT(inSuite, !snapshot.GetState(16));
+}
+
+static void Test_SnapshotsShareUnchangedStates(nlTestSuite *inSuite, void *inContext)
+{
+    const int kNumIds = 300;
+
+    std::list< ptr::shared_ptr<const TopicState> > primeList;
+    for (int id = 0; id < kNumIds; ++id)
+    {
+        primeList.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(id, id)));
+    }
+    StateSnapshot first(primeList);
+
+    // Replace two values, add one far away; same Id twice keeps the last one.
+    std::list< ptr::shared_ptr<const TopicState> > updateList;
+    updateList.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(299, 1000)));
+    updateList.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(3, 1001)));
+    updateList.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(3, 1002)));
+    updateList.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(100000, 1003)));
+    StateSnapshot second(first, updateList);
+
+    NL_TEST_ASSERT(inSuite, second.GetStateVersion() == first.GetStateVersion() + 1);
+    NL_TEST_ASSERT(inSuite, second.GetMapSize() == (size_t)kNumIds + 1);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(second, 299) == 1000);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(second, 3) == 1002);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(second, 100000) == 1003);
+    NL_TEST_ASSERT(inSuite, second.GetState(42) == first.GetState(42));
+
+    // The previous snapshot is untouched.
+    NL_TEST_ASSERT(inSuite, first.GetMapSize() == (size_t)kNumIds);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(first, 299) == 299);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(first, 3) == 3);
+    NL_TEST_ASSERT(inSuite, !first.GetState(100000));
+
+    // Two snapshots derived from the same one don't see each other's values.
+    std::list< ptr::shared_ptr<const TopicState> > otherUpdateList;
+    otherUpdateList.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(3, 2000)));
+    StateSnapshot sibling(first, otherUpdateList);
+
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(sibling, 3) == 2000);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(second, 3) == 1002);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(first, 3) == 3);
+}
+
+static void Test_DenseTopicStateIds(nlTestSuite *inSuite, void *inContext)
+{
+    const size_t kNumTopicStateIds = 8;
+    GraphStateStore stateStore(kNumTopicStateIds);
+
+    NL_TEST_ASSERT(inSuite, stateStore.GetLastState()->GetMapSize() == 0);
+    NL_TEST_ASSERT(inSuite, !stateStore.GetLastState()->GetState(0));
+
+    {
+        std::list< ptr::shared_ptr<const TopicState> > firstEvaluationOutput;
+        firstEvaluationOutput.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(7, 70)));
+        firstEvaluationOutput.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(0, 1)));
+        firstEvaluationOutput.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(0, 2)));
+        // Outside of the bound - kept in the trie.
+        firstEvaluationOutput.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(8, 80)));
+        stateStore.TakeNewSnapshot(firstEvaluationOutput);
+    }
+    ptr::shared_ptr<const StateSnapshot> first = stateStore.GetLastState();
+
+    NL_TEST_ASSERT(inSuite, first->GetMapSize() == 3);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(*first, 0) == 2);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(*first, 7) == 70);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(*first, 8) == 80);
+    NL_TEST_ASSERT(inSuite, !first->GetState(3));
+
+    {
+        std::list< ptr::shared_ptr<const TopicState> > secondEvaluationOutput;
+        secondEvaluationOutput.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(3, 30)));
+        secondEvaluationOutput.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(7, 71)));
+        stateStore.TakeNewSnapshot(secondEvaluationOutput);
+    }
+    ptr::shared_ptr<const StateSnapshot> second = stateStore.GetLastState();
+
+    NL_TEST_ASSERT(inSuite, second->GetMapSize() == 4);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(*second, 3) == 30);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(*second, 7) == 71);
+    NL_TEST_ASSERT(inSuite, second->GetState(0) == first->GetState(0));
+    NL_TEST_ASSERT(inSuite, second->GetState(8) == first->GetState(8));
+
+    // The previous snapshot is untouched.
+    NL_TEST_ASSERT(inSuite, first->GetMapSize() == 3);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(*first, 7) == 70);
+    NL_TEST_ASSERT(inSuite, !first->GetState(3));
+
+    std::list< ptr::shared_ptr<const TopicState> > outputList;
+    second->GetTopicStates(outputList);
+    NL_TEST_ASSERT(inSuite, outputList.size() == 4);
+
+    const TopicStateIdType expectedIds[] = { 0, 3, 7, 8 };
+    size_t index = 0;
+    for (std::list< ptr::shared_ptr<const TopicState> >::const_iterator it = outputList.begin();
+        it != outputList.end();
+        ++it, ++index)
+    {
+        NL_TEST_ASSERT(inSuite, (*it)->GetId() == expectedIds[index]);
+    }
+}
+
+static void Test_DefaultHistory(nlTestSuite *inSuite, void *inContext)
+{
+    GraphStateStore stateStore;
+    NL_TEST_ASSERT(inSuite, stateStore.GetHistoryLength() == 1);
+    NL_TEST_ASSERT(inSuite, stateStore.GetStateByVersion(0) == stateStore.GetLastState());
+
+    std::list< ptr::shared_ptr<const TopicState> > evaluationOutput;
+    for (int i = 0; i < 5; ++i)
+    {
+        stateStore.TakeNewSnapshot(evaluationOutput);
+    }
+
+    // Same look back as before: the last two snapshots.
+    NL_TEST_ASSERT(inSuite, stateStore.GetHistoryLength() == GraphStateStore::kDefaultMaxNumSnapshots);
+    NL_TEST_ASSERT(inSuite, !stateStore.GetStateByVersion(3));
+    NL_TEST_ASSERT(inSuite, stateStore.GetStateByVersion(4)->GetStateVersion() == 4);
+    NL_TEST_ASSERT(inSuite, stateStore.GetStateByVersion(5) == stateStore.GetLastState());
+    NL_TEST_ASSERT(inSuite, !stateStore.GetStateByVersion(6));
+}
+
+static void Test_DeepHistory(nlTestSuite *inSuite, void *inContext)
+{
+    const int kNumIds = 256;
+    const size_t kHistoryLength = 100;
+
+    GraphStateStore stateStore;
+    stateStore.SetHistoryLimits(kHistoryLength);
+
+    {
+        std::list< ptr::shared_ptr<const TopicState> > primeOutput;
+        for (int id = 0; id < kNumIds; ++id)
+        {
+            primeOutput.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(id, 0)));
+        }
+        stateStore.TakeNewSnapshot(primeOutput, 1000);
+    }
+
+    // One value changes every 10ms.
+    for (int i = 1; i <= 250; ++i)
+    {
+        std::list< ptr::shared_ptr<const TopicState> > evaluationOutput;
+        evaluationOutput.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(i % kNumIds, i)));
+        stateStore.TakeNewSnapshot(evaluationOutput, 1000 + 10 * (uint64_t)i);
+    }
+
+    NL_TEST_ASSERT(inSuite, stateStore.GetHistoryLength() == kHistoryLength);
+    NL_TEST_ASSERT(inSuite, stateStore.GetLastState()->GetStateVersion() == 251);
+
+    // By version
+    NL_TEST_ASSERT(inSuite, !stateStore.GetStateByVersion(151));
+    ptr::shared_ptr<const StateSnapshot> snapshot = stateStore.GetStateByVersion(200);
+    NL_TEST_ASSERT(inSuite, snapshot && snapshot->GetStateVersion() == 200);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(*snapshot, 199) == 199);
+    NL_TEST_ASSERT(inSuite, GetNumberedValue(*snapshot, 200) == 0);
+
+    // By time: snapshot i was taken at 1000 + 10 * i and has version i + 1.
+    NL_TEST_ASSERT(inSuite, !stateStore.GetStateAtTime(2500));
+    NL_TEST_ASSERT(inSuite, stateStore.GetStateAtTime(2510)->GetStateVersion() == 152);
+    NL_TEST_ASSERT(inSuite, stateStore.GetStateAtTime(3005)->GetStateVersion() == 201);
+    NL_TEST_ASSERT(inSuite, stateStore.GetStateAtTime(3010)->GetStateVersion() == 202);
+    NL_TEST_ASSERT(inSuite, stateStore.GetStateAtTime(100000) == stateStore.GetLastState());
+
+    // A snapshot that changes one value costs much less than a full copy.
+    const ptr::shared_ptr<const StateSnapshot> last = stateStore.GetLastState();
+    NL_TEST_ASSERT(inSuite, last->GetDeltaSizeInBytes() * 4 < last->GetSizeInBytes());
+    NL_TEST_ASSERT(inSuite, stateStore.GetHistorySizeInBytes() <
+        last->GetSizeInBytes() + kHistoryLength * last->GetDeltaSizeInBytes());
+}
+
+static void Test_HistoryMemoryBudget(nlTestSuite *inSuite, void *inContext)
+{
+    GraphStateStore stateStore;
+    stateStore.SetHistoryLimits(1000);
+
+    std::list< ptr::shared_ptr<const TopicState> > primeOutput;
+    for (int id = 0; id < 64; ++id)
+    {
+        primeOutput.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(id, 0)));
+    }
+    stateStore.TakeNewSnapshot(primeOutput);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        std::list< ptr::shared_ptr<const TopicState> > evaluationOutput;
+        evaluationOutput.push_back(ptr::shared_ptr<const TopicState>(new NumberedPacket(i % 64, i)));
+        stateStore.TakeNewSnapshot(evaluationOutput);
+    }
+    NL_TEST_ASSERT(inSuite, stateStore.GetHistoryLength() == 102);
+
+    const size_t budget = stateStore.GetHistorySizeInBytes() / 2;
+    stateStore.SetHistoryLimits(1000, budget);
+
+    NL_TEST_ASSERT(inSuite, stateStore.GetHistorySizeInBytes() <= budget);
+    NL_TEST_ASSERT(inSuite, stateStore.GetHistoryLength() > 1);
+    NL_TEST_ASSERT(inSuite, stateStore.GetHistoryLength() < 102);
+
+    // A budget smaller than a single snapshot still keeps the last one.
+    stateStore.SetHistoryLimits(1000, 1);
+    NL_TEST_ASSERT(inSuite, stateStore.GetHistoryLength() == 1);
+    NL_TEST_ASSERT(inSuite, stateStore.GetHistorySizeInBytes() == stateStore.GetLastState()->GetSizeInBytes());
+    NL_TEST_ASSERT(inSuite, stateStore.GetLastState()->GetMapSize() == 64);
+}
+
 static const nlTest sTests[] = {
     NL_TEST_DEF("Test_Lifetime", Test_Lifetime),
     NL_TEST_DEF("Test_StoreSimple", Test_StoreSimple),
@@ -299,6 +564,13 @@ static const nlTest sTests[] = {
     NL_TEST_DEF("Test_StoreAccumulation", Test_StoreAccumulation),
     NL_TEST_DEF("Test_StoreReplacement", Test_StoreReplacement),
     NL_TEST_DEF("Test_StateSnapshotLifetime", Test_StateSnapshotLifetime),
+    NL_TEST_DEF("Test_SparseTopicStateIds", Test_SparseTopicStateIds),
+    NL_TEST_DEF("Test_SingleZeroTopicStateId", Test_SingleZeroTopicStateId),
+    NL_TEST_DEF("Test_SnapshotsShareUnchangedStates", Test_SnapshotsShareUnchangedStates),
+    NL_TEST_DEF("Test_DenseTopicStateIds", Test_DenseTopicStateIds),
+    NL_TEST_DEF("Test_DefaultHistory", Test_DefaultHistory),
+    NL_TEST_DEF("Test_DeepHistory", Test_DeepHistory),
+    NL_TEST_DEF("Test_HistoryMemoryBudget", Test_HistoryMemoryBudget),
     NL_TEST_DEF("Test_DuplicatePublicTopicPublish", Test_DuplicatePublicTopicPublish),
     NL_TEST_DEF("Test_GetStateVersion", Test_GetStateVersion),
     NL_TEST_SENTINEL()
@@ -20,12 +20,17 @@
 #include "common_test_list.h"
 
 /* (1) INCLUDE YOUR TEST HERE */
+#include "test_concurrentinput.h"
 #include "test_detector.h"
 #include "test_graph.h"
 #include "test_graphanalyzer.h"
 #include "test_graphstatestore.h"
 #include "test_graphtestutils.h"
 #include "test_nodenameutils.h"
+#include "test_parallelevaluation.h"
+#include "test_snapshotfile.h"
+#include "test_statejournal.h"
+#include "test_timingwheeltimeoutpublisherservice.h"
 #include "test_testsplitterdetector.h"
 #include "test_topicstate.h"
 
@@ -34,12 +39,17 @@ typedef int (*test_fp)(void);
 /* (2) ADD THE FUNCTION TO CALL INTO YOUR TEST HERE */
 #define UNIT_TEST_LIST {\
     COMMON_TEST_LIST \
+    concurrentinput_testsuite, \
     detector_testsuite, \
     graph_testsuite, \
     graphanalyzer_testsuite, \
     graphstatestore_testsuite, \
     graphtestutils_testsuite, \
     nodenameutils_testsuite, \
+    parallelevaluation_testsuite, \
+    snapshotfile_testsuite, \
+    statejournal_testsuite, \
+    timingwheeltimeoutpublisherservice_testsuite, \
     testsplitterdetector_testsuite, \
     topicstate_testsuite, \
 }
@@ -0,0 +1,377 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nltest.h"
+#include "errortype.hpp"
+
+#include "test_parallelevaluation.h"
+
+#include "graph.hpp"
+#include "detector.hpp"
+#include "topicstate.hpp"
+#include "publisher.hpp"
+#include "futurepublisher.hpp"
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <vector>
+#endif
+
+#define SUITE_DECLARATION(name, test_ptr) { #name, test_ptr, setup_##name, teardown_##name }
+
+using namespace DetectorGraph;
+
+static int setup_parallelevaluation(void *inContext)
+{
+    return 0;
+}
+
+static int teardown_parallelevaluation(void *inContext)
+{
+    return 0;
+}
+
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+namespace
+{
+    template<int N>
+    struct IntState : public TopicState
+    {
+        IntState(int aV = 0) : mV(aV) {}
+        TopicStateIdType GetId() const { return (TopicStateIdType)N; }
+        int mV;
+    };
+
+    typedef IntState<0> Trigger;
+    typedef IntState<10> Shared;
+    typedef IntState<20> Sum;
+
+    template<int N>
+    struct Worker : public Detector, public SubscriberInterface<Trigger>, public Publisher< IntState<N> >
+    {
+        Worker(Graph* graph) : Detector(graph)
+        {
+            Subscribe<Trigger>(this);
+            SetupPublishing< IntState<N> >(this);
+        }
+        virtual void Evaluate(const Trigger& aTrigger)
+        {
+            this->Publish(IntState<N>(aTrigger.mV * N));
+        }
+    };
+
+    template<int N>
+    struct SharedWorker : public Detector, public SubscriberInterface<Trigger>, public Publisher<Shared>
+    {
+        SharedWorker(Graph* graph) : Detector(graph)
+        {
+            Subscribe<Trigger>(this);
+            SetupPublishing<Shared>(this);
+        }
+        virtual void Evaluate(const Trigger& aTrigger)
+        {
+            Publish(Shared(aTrigger.mV + N));
+        }
+    };
+
+    template<int N>
+    struct FutureWorker : public Detector, public SubscriberInterface<Trigger>, public FuturePublisher< IntState<N> >
+    {
+        FutureWorker(Graph* graph) : Detector(graph)
+        {
+            Subscribe<Trigger>(this);
+            SetupFuturePublishing< IntState<N> >(this);
+        }
+        virtual void Evaluate(const Trigger& aTrigger)
+        {
+            this->PublishOnFutureEvaluation(IntState<N>(aTrigger.mV - N));
+        }
+    };
+
+    struct Summer : public Detector,
+        public SubscriberInterface< IntState<1> >,
+        public SubscriberInterface< IntState<2> >,
+        public SubscriberInterface<Shared>,
+        public Publisher<Sum>
+    {
+        Summer(Graph* graph) : Detector(graph), mSum(0)
+        {
+            Subscribe< IntState<1> >(this);
+            Subscribe< IntState<2> >(this);
+            Subscribe<Shared>(this);
+            SetupPublishing<Sum>(this);
+        }
+        virtual void BeginEvaluation() { mSum = 0; }
+        virtual void Evaluate(const IntState<1>& aValue) { mSum += aValue.mV; }
+        virtual void Evaluate(const IntState<2>& aValue) { mSum += aValue.mV; }
+        virtual void Evaluate(const Shared& aValue) { mSum += aValue.mV; }
+        virtual void CompleteEvaluation() { Publish(Sum(mSum)); }
+        int mSum;
+    };
+
+    struct TestGraph : public Graph
+    {
+        TestGraph()
+        : mWorker1(this), mWorker2(this), mWorker3(this)
+        , mSharedWorker1(this), mSharedWorker2(this)
+        , mFutureWorker1(this), mFutureWorker2(this)
+        , mSummer(this)
+        {
+        }
+
+        Worker<1> mWorker1;
+        Worker<2> mWorker2;
+        Worker<3> mWorker3;
+        SharedWorker<100> mSharedWorker1;
+        SharedWorker<200> mSharedWorker2;
+        FutureWorker<4> mFutureWorker1;
+        FutureWorker<5> mFutureWorker2;
+        Summer mSummer;
+    };
+
+    typedef std::vector< std::pair<int, int> > OutputTrace;
+
+    void RecordOutputs(const Graph& aGraph, OutputTrace& aTrace)
+    {
+        const std::list< ptr::shared_ptr<const TopicState> >& outputs = aGraph.GetOutputList();
+        for (std::list< ptr::shared_ptr<const TopicState> >::const_iterator it = outputs.begin();
+            it != outputs.end();
+            ++it)
+        {
+            const IntState<0>* state = static_cast<const IntState<0>*>(it->get());
+            aTrace.push_back(std::make_pair((int)(*it)->GetId(), state->mV));
+        }
+    }
+
+    void RunInputs(Graph& aGraph, OutputTrace& aTrace)
+    {
+        for (int input = 1; input <= 5; ++input)
+        {
+            aGraph.PushData<Trigger>(Trigger(input));
+            while (aGraph.HasDataPending())
+            {
+                aGraph.EvaluateGraph();
+                RecordOutputs(aGraph, aTrace);
+            }
+        }
+    }
+}
+
+static void Test_MatchesSerialEvaluation(nlTestSuite *inSuite, void *inContext)
+{
+    OutputTrace serialTrace;
+    {
+        TestGraph graph;
+        RunInputs(graph, serialTrace);
+    }
+
+    for (unsigned numWorkers = 1; numWorkers <= 4; ++numWorkers)
+    {
+        OutputTrace levelTrace;
+        TestGraph levelGraph;
+        levelGraph.SetParallelEvaluation(numWorkers, Graph::kLevelSynchronous);
+        RunInputs(levelGraph, levelTrace);
+        NL_TEST_ASSERT(inSuite, levelTrace == serialTrace);
+
+        OutputTrace stealingTrace;
+        TestGraph stealingGraph;
+        stealingGraph.SetParallelEvaluation(numWorkers, Graph::kWorkStealing);
+        RunInputs(stealingGraph, stealingTrace);
+        NL_TEST_ASSERT(inSuite, stealingTrace == serialTrace);
+    }
+
+    // Trigger, 3 Workers, 2 Shared values, Sum & 2 future evaluations.
+    NL_TEST_ASSERT(inSuite, serialTrace.size() == 5 * (1 + 3 + 2 + 1 + 2));
+}
+
+namespace
+{
+    std::atomic<int> sRendezvousCount;
+
+    // Only returns true if another Rendezvous runs at the same time.
+    bool MeetOtherRendezvous()
+    {
+        sRendezvousCount++;
+        std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (sRendezvousCount.load() < 2)
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+            {
+                return false; // LCOV_EXCL_LINE
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    template<int N>
+    struct Rendezvous : public Detector, public SubscriberInterface<Trigger>, public Publisher< IntState<N> >
+    {
+        Rendezvous(Graph* graph) : Detector(graph), mMet(false)
+        {
+            Subscribe<Trigger>(this);
+            SetupPublishing< IntState<N> >(this);
+        }
+        virtual void Evaluate(const Trigger& aTrigger)
+        {
+            mMet = MeetOtherRendezvous();
+            this->Publish(IntState<N>(aTrigger.mV));
+        }
+        bool mMet;
+    };
+}
+
+static void Test_RunsDetectorsConcurrently(nlTestSuite *inSuite, void *inContext)
+{
+    const Graph::ParallelScheduling schedulings[] = { Graph::kLevelSynchronous, Graph::kWorkStealing };
+    for (unsigned idx = 0; idx < sizeof(schedulings) / sizeof(schedulings[0]); ++idx)
+    {
+        sRendezvousCount = 0;
+
+        Graph graph;
+        Rendezvous<1> rendezvousA(&graph);
+        Rendezvous<2> rendezvousB(&graph);
+        graph.SetParallelEvaluation(1, schedulings[idx]);
+
+        graph.PushData<Trigger>(Trigger(7));
+        ErrorType r = graph.EvaluateGraph();
+        NL_TEST_ASSERT(inSuite, r == ErrorType_Success);
+        NL_TEST_ASSERT(inSuite, rendezvousA.mMet);
+        NL_TEST_ASSERT(inSuite, rendezvousB.mMet);
+        NL_TEST_ASSERT(inSuite, graph.GetOutputList().size() == 3);
+    }
+}
+
+namespace
+{
+    std::atomic<bool> sFastChainDone;
+
+    // Only finishes once a Detector two levels below it has run.
+    struct SlowDetector : public Detector, public SubscriberInterface<Trigger>, public Publisher< IntState<1> >
+    {
+        SlowDetector(Graph* graph) : Detector(graph), mOvertaken(false)
+        {
+            Subscribe<Trigger>(this);
+            SetupPublishing< IntState<1> >(this);
+        }
+        virtual void Evaluate(const Trigger& aTrigger)
+        {
+            std::chrono::steady_clock::time_point deadline =
+                std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (!sFastChainDone.load() && std::chrono::steady_clock::now() < deadline)
+            {
+                std::this_thread::yield();
+            }
+            mOvertaken = sFastChainDone.load();
+            Publish(IntState<1>(aTrigger.mV));
+        }
+        bool mOvertaken;
+    };
+
+    struct FastChainEnd : public Detector, public SubscriberInterface< IntState<2> >
+    {
+        FastChainEnd(Graph* graph) : Detector(graph)
+        {
+            Subscribe< IntState<2> >(this);
+        }
+        virtual void Evaluate(const IntState<2>&)
+        {
+            sFastChainDone = true;
+        }
+    };
+}
+
+static void Test_WorkStealingDoesNotWaitForLevels(nlTestSuite *inSuite, void *inContext)
+{
+    /*
+     *            Trigger
+     *          /         \
+     *   SlowDetector    Worker<2>
+     *         |            |
+     *     IntState<1>  IntState<2>
+     *                      |
+     *                 FastChainEnd
+     */
+    sFastChainDone = false;
+
+    Graph graph;
+    SlowDetector slowDetector(&graph);
+    Worker<2> fastDetector(&graph);
+    FastChainEnd fastChainEnd(&graph);
+    graph.SetParallelEvaluation(1, Graph::kWorkStealing);
+
+    graph.PushData<Trigger>(Trigger(3));
+    ErrorType r = graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, r == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, slowDetector.mOvertaken);
+    NL_TEST_ASSERT(inSuite, graph.GetOutputList().size() == 3);
+}
+
+static void Test_DisableParallelEvaluation(nlTestSuite *inSuite, void *inContext)
+{
+    OutputTrace serialTrace;
+    {
+        TestGraph graph;
+        RunInputs(graph, serialTrace);
+    }
+
+    OutputTrace toggledTrace;
+    TestGraph graph;
+    graph.SetParallelEvaluation(2);
+    graph.PushData<Trigger>(Trigger(1));
+    graph.EvaluateGraph();
+    RecordOutputs(graph, toggledTrace);
+    graph.SetParallelEvaluation(0);
+    while (graph.HasDataPending())
+    {
+        graph.EvaluateGraph();
+        RecordOutputs(graph, toggledTrace);
+    }
+    for (int input = 2; input <= 5; ++input)
+    {
+        graph.SetParallelEvaluation(input % 3, (input % 2) ? Graph::kWorkStealing : Graph::kLevelSynchronous);
+        graph.PushData<Trigger>(Trigger(input));
+        while (graph.HasDataPending())
+        {
+            graph.EvaluateGraph();
+            RecordOutputs(graph, toggledTrace);
+        }
+    }
+
+    NL_TEST_ASSERT(inSuite, toggledTrace == serialTrace);
+}
+#endif
+
+static const nlTest sTests[] = {
+#if defined(BUILD_FEATURE_DETECTORGRAPH_CONFIG_PARALLEL_EVALUATION)
+    NL_TEST_DEF("Test_MatchesSerialEvaluation", Test_MatchesSerialEvaluation),
+    NL_TEST_DEF("Test_RunsDetectorsConcurrently", Test_RunsDetectorsConcurrently),
+    NL_TEST_DEF("Test_WorkStealingDoesNotWaitForLevels", Test_WorkStealingDoesNotWaitForLevels),
+    NL_TEST_DEF("Test_DisableParallelEvaluation", Test_DisableParallelEvaluation),
+#endif
+    NL_TEST_SENTINEL()
+};
+
+//This function creates the Suite (i.e: the name of your test and points to the array of test functions)
+extern "C"
+int parallelevaluation_testsuite(void)
+{
+    nlTestSuite theSuite = SUITE_DECLARATION(parallelevaluation, &sTests[0]);
+    nlTestRunner(&theSuite, NULL);
+    return nlTestRunnerStats(&theSuite);
+}
@@ -0,0 +1,271 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nltest.h"
+#include "errortype.hpp"
+
+#include "test_snapshotfile.h"
+
+#include "snapshotfile.hpp"
+#include "statesnapshot.hpp"
+#include "topicstate.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#define SUITE_DECLARATION(name, test_ptr) { #name, test_ptr, setup_##name, teardown_##name }
+
+using namespace DetectorGraph;
+
+static const char kTestFilePath[] = "test_snapshotfile.bin";
+
+static int setup_snapshotfile(void *inContext)
+{
+    return 0;
+}
+
+static int teardown_snapshotfile(void *inContext)
+{
+    remove(kTestFilePath);
+    return 0;
+}
+
+namespace {
+    struct Position
+    {
+        int32_t x;
+        int32_t y;
+    };
+
+    struct PositionState : public NamedTopicState<10>, public Position
+    {
+        PositionState(int32_t aX = 0, int32_t aY = 0) { x = aX; y = aY; }
+    };
+
+    struct LabelState : public NamedTopicState<11>
+    {
+        LabelState(const std::string& aLabel = "") : mLabel(aLabel) {}
+        std::string mLabel;
+    };
+
+    struct UnregisteredState : public NamedTopicState<12>
+    {
+    };
+
+    struct NumberedState : public TopicState, public Position
+    {
+        NumberedState(TopicStateIdType aId = 0) : mId(aId) { x = aId; y = -aId; }
+        virtual TopicStateIdType GetId() const { return mId; }
+        TopicStateIdType mId;
+    };
+
+    void EncodeLabel(const TopicState& arTopicState, std::string& aOut)
+    {
+        aOut += static_cast<const LabelState&>(arTopicState).mLabel;
+    }
+
+    ptr::shared_ptr<const TopicState> DecodeLabel(const void* apData, size_t aSize)
+    {
+        return ptr::shared_ptr<const TopicState>(
+            new LabelState(std::string(static_cast<const char*>(apData), aSize)));
+    }
+
+    void EncodeNumbered(const TopicState& arTopicState, std::string& aOut)
+    {
+        const Position& position = static_cast<const NumberedState&>(arTopicState);
+        aOut.append(reinterpret_cast<const char*>(&position), sizeof(position));
+    }
+
+    ptr::shared_ptr<const TopicState> DecodeNumbered(const void* apData, size_t aSize)
+    {
+        const Position* position = static_cast<const Position*>(apData);
+        return ptr::shared_ptr<const TopicState>(new NumberedState(position->x));
+    }
+
+    SnapshotFileCodecs MakeCodecs()
+    {
+        SnapshotFileCodecs codecs;
+        codecs.RegisterTrivial<PositionState, Position>();
+        codecs.Register(LabelState::kTopicStateId, &EncodeLabel, &DecodeLabel);
+        return codecs;
+    }
+
+    StateSnapshot MakeSnapshot(int32_t aX, const std::string& aLabel)
+    {
+        std::list< ptr::shared_ptr<const TopicState> > topicStates;
+        topicStates.push_back(ptr::shared_ptr<const TopicState>(new UnregisteredState()));
+        topicStates.push_back(ptr::shared_ptr<const TopicState>(new LabelState(aLabel)));
+        topicStates.push_back(ptr::shared_ptr<const TopicState>(new PositionState(aX, 7)));
+        return StateSnapshot(StateSnapshot(), topicStates);
+    }
+}
+
+static void Test_WriteAndMap(nlTestSuite *inSuite, void *inContext)
+{
+    const SnapshotFileCodecs codecs = MakeCodecs();
+    NL_TEST_ASSERT(inSuite, WriteSnapshotFile(kTestFilePath, MakeSnapshot(42, "forty-two"), codecs) == ErrorType_Success);
+
+    MappedSnapshotFile mappedFile;
+    NL_TEST_ASSERT(inSuite, !mappedFile.IsOpen());
+    NL_TEST_ASSERT(inSuite, mappedFile.Open(kTestFilePath) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, mappedFile.IsOpen());
+    NL_TEST_ASSERT(inSuite, mappedFile.GetStateVersion() == 1);
+    NL_TEST_ASSERT(inSuite, mappedFile.GetNumEntries() == 2);
+
+    // Read in place
+    const Position* position = mappedFile.GetInPlace<PositionState, Position>();
+    NL_TEST_ASSERT(inSuite, position != NULL);
+    NL_TEST_ASSERT(inSuite, position->x == 42 && position->y == 7);
+
+    size_t labelSize = 0;
+    const void* label = mappedFile.GetEntry(LabelState::kTopicStateId, labelSize);
+    NL_TEST_ASSERT(inSuite, label != NULL);
+    NL_TEST_ASSERT(inSuite, std::string(static_cast<const char*>(label), labelSize) == "forty-two");
+
+    NL_TEST_ASSERT(inSuite, mappedFile.GetEntry(UnregisteredState::kTopicStateId, labelSize) == NULL);
+
+    // Decode into a StateSnapshot
+    std::list< ptr::shared_ptr<const TopicState> > topicStates;
+    NL_TEST_ASSERT(inSuite, mappedFile.GetTopicStates(codecs, topicStates) == ErrorType_Success);
+    StateSnapshot snapshot(topicStates);
+
+    NL_TEST_ASSERT(inSuite, snapshot.GetMapSize() == 2);
+    NL_TEST_ASSERT(inSuite, snapshot.GetState<PositionState>()->x == 42);
+    NL_TEST_ASSERT(inSuite, snapshot.GetState<PositionState>()->y == 7);
+    NL_TEST_ASSERT(inSuite, snapshot.GetState<LabelState>()->mLabel == "forty-two");
+    NL_TEST_ASSERT(inSuite, !snapshot.GetState<UnregisteredState>());
+
+    mappedFile.Close();
+    NL_TEST_ASSERT(inSuite, !mappedFile.IsOpen());
+    position = mappedFile.GetInPlace<PositionState, Position>();
+    NL_TEST_ASSERT(inSuite, position == NULL);
+}
+
+static void Test_AtomicReplace(nlTestSuite *inSuite, void *inContext)
+{
+    const SnapshotFileCodecs codecs = MakeCodecs();
+    NL_TEST_ASSERT(inSuite, WriteSnapshotFile(kTestFilePath, MakeSnapshot(1, "first"), codecs) == ErrorType_Success);
+
+    MappedSnapshotFile firstFile;
+    NL_TEST_ASSERT(inSuite, firstFile.Open(kTestFilePath) == ErrorType_Success);
+
+    NL_TEST_ASSERT(inSuite, WriteSnapshotFile(kTestFilePath, MakeSnapshot(2, "second"), codecs) == ErrorType_Success);
+
+    // The file is replaced, not rewritten; existing mappings keep the old one.
+    const Position* firstPosition = firstFile.GetInPlace<PositionState, Position>();
+    NL_TEST_ASSERT(inSuite, firstPosition->x == 1);
+
+    MappedSnapshotFile secondFile;
+    NL_TEST_ASSERT(inSuite, secondFile.Open(kTestFilePath) == ErrorType_Success);
+    const Position* secondPosition = secondFile.GetInPlace<PositionState, Position>();
+    NL_TEST_ASSERT(inSuite, secondPosition->x == 2);
+
+    std::ifstream tempFile((std::string(kTestFilePath) + ".tmp").c_str());
+    NL_TEST_ASSERT(inSuite, !tempFile.is_open());
+
+    // The rename is made durable by flushing its directory.
+    NL_TEST_ASSERT(inSuite, SyncParentDirectory(kTestFilePath) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, SyncParentDirectory("/tmp/file") == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, SyncParentDirectory("no_such_directory/file") == ErrorType_NoResource);
+}
+
+static void Test_ManyStates(nlTestSuite *inSuite, void *inContext)
+{
+    const int kNumStates = 2000;
+
+    // Only the even ones are registered.
+    SnapshotFileCodecs codecs;
+    std::list< ptr::shared_ptr<const TopicState> > topicStates;
+    for (int id = 0; id < kNumStates; ++id)
+    {
+        if (id % 2 == 0)
+        {
+            codecs.Register(id * 3, &EncodeNumbered, &DecodeNumbered);
+        }
+        topicStates.push_back(ptr::shared_ptr<const TopicState>(new NumberedState(id * 3)));
+    }
+
+    NL_TEST_ASSERT(inSuite, WriteSnapshotFile(kTestFilePath, StateSnapshot(topicStates), codecs) == ErrorType_Success);
+
+    MappedSnapshotFile mappedFile;
+    NL_TEST_ASSERT(inSuite, mappedFile.Open(kTestFilePath) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, mappedFile.GetNumEntries() == kNumStates / 2);
+
+    bool allFound = true;
+    for (int id = 0; id < kNumStates; ++id)
+    {
+        size_t size = 0;
+        const Position* position = static_cast<const Position*>(mappedFile.GetEntry(id * 3, size));
+        if (id % 2 == 0)
+        {
+            allFound = allFound && position && size == sizeof(Position) && position->x == id * 3;
+        }
+        else
+        {
+            allFound = allFound && !position;
+        }
+    }
+    NL_TEST_ASSERT(inSuite, allFound);
+
+    std::list< ptr::shared_ptr<const TopicState> > decodedStates;
+    NL_TEST_ASSERT(inSuite, mappedFile.GetTopicStates(codecs, decodedStates) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, decodedStates.size() == kNumStates / 2);
+    NL_TEST_ASSERT(inSuite, decodedStates.back()->GetId() == (kNumStates - 2) * 3);
+}
+
+static void Test_InvalidFiles(nlTestSuite *inSuite, void *inContext)
+{
+    MappedSnapshotFile mappedFile;
+
+    remove(kTestFilePath);
+    NL_TEST_ASSERT(inSuite, mappedFile.Open(kTestFilePath) == ErrorType_NoResource);
+
+    {
+        std::ofstream garbage(kTestFilePath);
+        garbage << "this is definitely not a DetectorGraph snapshot file";
+    }
+    NL_TEST_ASSERT(inSuite, mappedFile.Open(kTestFilePath) == ErrorType_Parse);
+    NL_TEST_ASSERT(inSuite, !mappedFile.IsOpen());
+
+    // A truncated file is rejected
+    NL_TEST_ASSERT(inSuite, WriteSnapshotFile(kTestFilePath, MakeSnapshot(1, "truncated"), MakeCodecs()) == ErrorType_Success);
+    std::string contents;
+    {
+        std::ifstream validFile(kTestFilePath, std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(validFile), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream truncatedFile(kTestFilePath, std::ios::binary | std::ios::trunc);
+        truncatedFile.write(contents.data(), contents.size() - 1);
+    }
+    NL_TEST_ASSERT(inSuite, mappedFile.Open(kTestFilePath) == ErrorType_Parse);
+}
+
+static const nlTest sTests[] = {
+    NL_TEST_DEF("Test_WriteAndMap", Test_WriteAndMap),
+    NL_TEST_DEF("Test_AtomicReplace", Test_AtomicReplace),
+    NL_TEST_DEF("Test_ManyStates", Test_ManyStates),
+    NL_TEST_DEF("Test_InvalidFiles", Test_InvalidFiles),
+    NL_TEST_SENTINEL()
+};
+
+//This function creates the Suite (i.e: the name of your test and points to the array of test functions)
+extern "C"
+int snapshotfile_testsuite(void)
+{
+    nlTestSuite theSuite = SUITE_DECLARATION(snapshotfile, &sTests[0]);
+    nlTestRunner(&theSuite, NULL);
+    return nlTestRunnerStats(&theSuite);
+}
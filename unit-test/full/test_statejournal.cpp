@@ -0,0 +1,297 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nltest.h"
+#include "errortype.hpp"
+
+#include "test_statejournal.h"
+
+#include "statejournal.hpp"
+#include "snapshotfile.hpp"
+#include "statesnapshot.hpp"
+#include "topicstate.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SUITE_DECLARATION(name, test_ptr) { #name, test_ptr, setup_##name, teardown_##name }
+
+using namespace DetectorGraph;
+
+static const std::string kBasePath = "test_statejournal";
+
+static void RemoveJournalFiles()
+{
+    remove((kBasePath + ".snapshot").c_str());
+    remove((kBasePath + ".journal").c_str());
+    remove((kBasePath + ".journal.prev").c_str());
+}
+
+static int setup_statejournal(void *inContext)
+{
+    RemoveJournalFiles();
+    return 0;
+}
+
+static int teardown_statejournal(void *inContext)
+{
+    RemoveJournalFiles();
+    return 0;
+}
+
+namespace {
+    struct Counter
+    {
+        int32_t value;
+    };
+
+    struct CounterA : public NamedTopicState<20>, public Counter
+    {
+        CounterA(int32_t aValue = 0) { value = aValue; }
+    };
+
+    struct CounterB : public NamedTopicState<21>, public Counter
+    {
+        CounterB(int32_t aValue = 0) { value = aValue; }
+    };
+
+    struct NotJournaled : public NamedTopicState<22>
+    {
+    };
+
+    struct Anonymous : public TopicState
+    {
+    };
+
+    SnapshotFileCodecs MakeCodecs()
+    {
+        SnapshotFileCodecs codecs;
+        codecs.RegisterTrivial<CounterA, Counter>();
+        codecs.RegisterTrivial<CounterB, Counter>();
+        return codecs;
+    }
+
+    std::list< ptr::shared_ptr<const TopicState> > MakeOutput(int32_t aA, int32_t aB)
+    {
+        std::list< ptr::shared_ptr<const TopicState> > output;
+        if (aA >= 0)
+        {
+            output.push_back(ptr::shared_ptr<const TopicState>(new CounterA(aA)));
+        }
+        if (aB >= 0)
+        {
+            output.push_back(ptr::shared_ptr<const TopicState>(new CounterB(aB)));
+        }
+        output.push_back(ptr::shared_ptr<const TopicState>(new NotJournaled()));
+        output.push_back(ptr::shared_ptr<const TopicState>(new Anonymous()));
+        return output;
+    }
+
+    int32_t GetValue(const ptr::shared_ptr<const Counter>& arCounter)
+    {
+        return arCounter ? arCounter->value : -1;
+    }
+
+    int32_t GetA(const StateSnapshot& arSnapshot)
+    {
+        return GetValue(arSnapshot.GetState<CounterA>());
+    }
+
+    int32_t GetB(const StateSnapshot& arSnapshot)
+    {
+        return GetValue(arSnapshot.GetState<CounterB>());
+    }
+
+    off_t GetFileSize(const std::string& aPath)
+    {
+        struct stat fileStat;
+        return (stat(aPath.c_str(), &fileStat) == 0) ? fileStat.st_size : -1;
+    }
+}
+
+static void Test_RecoverFromNothing(nlTestSuite *inSuite, void *inContext)
+{
+    const SnapshotFileCodecs codecs = MakeCodecs();
+    StateJournal journal(codecs);
+
+    std::list< ptr::shared_ptr<const TopicState> > primeStates;
+    primeStates.push_back(ptr::shared_ptr<const TopicState>(new CounterB(100)));
+    StateSnapshot recovered;
+
+    NL_TEST_ASSERT(inSuite, journal.Append(MakeOutput(1, 1)) == ErrorType_Init);
+    NL_TEST_ASSERT(inSuite, journal.Open(kBasePath, StateSnapshot(primeStates), recovered) == ErrorType_Success);
+
+    NL_TEST_ASSERT(inSuite, recovered.GetMapSize() == 1);
+    NL_TEST_ASSERT(inSuite, GetA(recovered) == -1);
+    NL_TEST_ASSERT(inSuite, GetB(recovered) == 100);
+    NL_TEST_ASSERT(inSuite, GetFileSize(kBasePath + ".journal") == 0);
+}
+
+static void Test_AppendAndRecover(nlTestSuite *inSuite, void *inContext)
+{
+    const SnapshotFileCodecs codecs = MakeCodecs();
+    StateSnapshot recovered;
+    {
+        StateJournal journal(codecs);
+        NL_TEST_ASSERT(inSuite, journal.Open(kBasePath, StateSnapshot(), recovered) == ErrorType_Success);
+
+        NL_TEST_ASSERT(inSuite, journal.Append(MakeOutput(1, 10)) == ErrorType_Success);
+        NL_TEST_ASSERT(inSuite, journal.Append(MakeOutput(2, -1)) == ErrorType_Success);
+        NL_TEST_ASSERT(inSuite, journal.Append(MakeOutput(-1, -1)) == ErrorType_Success);
+        NL_TEST_ASSERT(inSuite, journal.Append(MakeOutput(3, -1)) == ErrorType_Success);
+
+        // The list without journaled TopicStates wrote nothing.
+        NL_TEST_ASSERT(inSuite, journal.GetNumRecords() == 3);
+    }
+
+    StateJournal journal(codecs);
+    NL_TEST_ASSERT(inSuite, journal.Open(kBasePath, StateSnapshot(), recovered) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, recovered.GetMapSize() == 2);
+    NL_TEST_ASSERT(inSuite, GetA(recovered) == 3);
+    NL_TEST_ASSERT(inSuite, GetB(recovered) == 10);
+    NL_TEST_ASSERT(inSuite, !recovered.GetState<NotJournaled>());
+
+    // Recovery compacted everything into the base snapshot.
+    NL_TEST_ASSERT(inSuite, GetFileSize(kBasePath + ".journal") == 0);
+    NL_TEST_ASSERT(inSuite, GetFileSize(kBasePath + ".snapshot") > 0);
+}
+
+static void Test_TornRecord(nlTestSuite *inSuite, void *inContext)
+{
+    const SnapshotFileCodecs codecs = MakeCodecs();
+    StateSnapshot recovered;
+    off_t intactSize = 0;
+    {
+        StateJournal journal(codecs);
+        journal.SetGroupCommitSize(1);
+        NL_TEST_ASSERT(inSuite, journal.Open(kBasePath, StateSnapshot(), recovered) == ErrorType_Success);
+        NL_TEST_ASSERT(inSuite, journal.Append(MakeOutput(1, 1)) == ErrorType_Success);
+        intactSize = GetFileSize(kBasePath + ".journal");
+        NL_TEST_ASSERT(inSuite, journal.Append(MakeOutput(2, 2)) == ErrorType_Success);
+    }
+
+    // Crash mid-append: the second record is cut short.
+    NL_TEST_ASSERT(inSuite, truncate((kBasePath + ".journal").c_str(), GetFileSize(kBasePath + ".journal") - 4) == 0);
+
+    StateJournal journal(codecs);
+    NL_TEST_ASSERT(inSuite, journal.Open(kBasePath, StateSnapshot(), recovered) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, intactSize > 0);
+    NL_TEST_ASSERT(inSuite, GetA(recovered) == 1);
+    NL_TEST_ASSERT(inSuite, GetB(recovered) == 1);
+
+    // Appending continues cleanly after the discarded tail.
+    NL_TEST_ASSERT(inSuite, journal.Append(MakeOutput(4, -1)) == ErrorType_Success);
+    journal.Close();
+    NL_TEST_ASSERT(inSuite, journal.Open(kBasePath, StateSnapshot(), recovered) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, GetA(recovered) == 4);
+    NL_TEST_ASSERT(inSuite, GetB(recovered) == 1);
+}
+
+static void Test_Compaction(nlTestSuite *inSuite, void *inContext)
+{
+    const SnapshotFileCodecs codecs = MakeCodecs();
+    StateSnapshot recovered;
+    {
+        StateJournal journal(codecs);
+        NL_TEST_ASSERT(inSuite, journal.Open(kBasePath, StateSnapshot(), recovered) == ErrorType_Success);
+
+        // What a GraphStateStore would be folding alongside.
+        ptr::shared_ptr<const StateSnapshot> current(new StateSnapshot());
+        for (int32_t i = 1; i <= 20; ++i)
+        {
+            const std::list< ptr::shared_ptr<const TopicState> > output = MakeOutput(i, i * 10);
+            NL_TEST_ASSERT(inSuite, journal.Append(output) == ErrorType_Success);
+            current.reset(new StateSnapshot(*current, output));
+        }
+        NL_TEST_ASSERT(inSuite, journal.GetNumRecords() == 20);
+
+        NL_TEST_ASSERT(inSuite, journal.StartCompaction(current) == ErrorType_Success);
+        NL_TEST_ASSERT(inSuite, journal.GetNumRecords() == 0);
+
+        // New records go to a fresh journal while compacting.
+        NL_TEST_ASSERT(inSuite, journal.Append(MakeOutput(21, -1)) == ErrorType_Success);
+
+        NL_TEST_ASSERT(inSuite, journal.WaitForCompaction() == ErrorType_Success);
+        NL_TEST_ASSERT(inSuite, !journal.IsCompacting());
+        NL_TEST_ASSERT(inSuite, GetFileSize(kBasePath + ".journal.prev") == -1);
+        NL_TEST_ASSERT(inSuite, journal.GetNumRecords() == 1);
+    }
+
+    StateJournal journal(codecs);
+    NL_TEST_ASSERT(inSuite, journal.Open(kBasePath, StateSnapshot(), recovered) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, GetA(recovered) == 21);
+    NL_TEST_ASSERT(inSuite, GetB(recovered) == 200);
+}
+
+static void Test_FailedCompaction(nlTestSuite *inSuite, void *inContext)
+{
+    const SnapshotFileCodecs codecs = MakeCodecs();
+    const std::string snapshotPath = kBasePath + ".snapshot";
+    const std::string blockerPath = snapshotPath + "/blocker";
+    StateSnapshot recovered;
+    {
+        StateJournal journal(codecs);
+        NL_TEST_ASSERT(inSuite, journal.Open(kBasePath, StateSnapshot(), recovered) == ErrorType_Success);
+
+        // A non-empty directory in place of the base snapshot fails compaction.
+        remove(snapshotPath.c_str());
+        NL_TEST_ASSERT(inSuite, mkdir(snapshotPath.c_str(), 0755) == 0);
+        { std::ofstream blocker(blockerPath.c_str()); }
+
+        NL_TEST_ASSERT(inSuite, journal.Append(MakeOutput(1, 1)) == ErrorType_Success);
+        ptr::shared_ptr<const StateSnapshot> current(new StateSnapshot(StateSnapshot(), MakeOutput(1, 1)));
+        NL_TEST_ASSERT(inSuite, journal.StartCompaction(current) == ErrorType_Success);
+        NL_TEST_ASSERT(inSuite, journal.WaitForCompaction() != ErrorType_Success);
+        NL_TEST_ASSERT(inSuite, GetFileSize(kBasePath + ".journal.prev") > 0);
+
+        // The failed compaction's records are kept along with new ones.
+        NL_TEST_ASSERT(inSuite, journal.Append(MakeOutput(2, -1)) == ErrorType_Success);
+        current.reset(new StateSnapshot(*current, MakeOutput(2, -1)));
+        NL_TEST_ASSERT(inSuite, journal.StartCompaction(current) == ErrorType_Success);
+        NL_TEST_ASSERT(inSuite, journal.WaitForCompaction() != ErrorType_Success);
+
+        remove(blockerPath.c_str());
+        rmdir(snapshotPath.c_str());
+        NL_TEST_ASSERT(inSuite, journal.Append(MakeOutput(-1, 3)) == ErrorType_Success);
+    }
+
+    // Recovery from the leftover previous journal and the journal.
+    StateJournal journal(codecs);
+    NL_TEST_ASSERT(inSuite, journal.Open(kBasePath, StateSnapshot(), recovered) == ErrorType_Success);
+    NL_TEST_ASSERT(inSuite, GetA(recovered) == 2);
+    NL_TEST_ASSERT(inSuite, GetB(recovered) == 3);
+    NL_TEST_ASSERT(inSuite, GetFileSize(kBasePath + ".journal.prev") == -1);
+}
+
+static const nlTest sTests[] = {
+    NL_TEST_DEF("Test_RecoverFromNothing", Test_RecoverFromNothing),
+    NL_TEST_DEF("Test_AppendAndRecover", Test_AppendAndRecover),
+    NL_TEST_DEF("Test_TornRecord", Test_TornRecord),
+    NL_TEST_DEF("Test_Compaction", Test_Compaction),
+    NL_TEST_DEF("Test_FailedCompaction", Test_FailedCompaction),
+    NL_TEST_SENTINEL()
+};
+
+//This function creates the Suite (i.e: the name of your test and points to the array of test functions)
+extern "C"
+int statejournal_testsuite(void)
+{
+    nlTestSuite theSuite = SUITE_DECLARATION(statejournal, &sTests[0]);
+    nlTestRunner(&theSuite, NULL);
+    return nlTestRunnerStats(&theSuite);
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright 2017 Nest Labs, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DETECTORGRAPH_UNIT_TEST_STATEJOURNAL_H_
+#define DETECTORGRAPH_UNIT_TEST_STATEJOURNAL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    int statejournal_testsuite(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DETECTORGRAPH_UNIT_TEST_STATEJOURNAL_H_
@@ -0,0 +1,252 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nltest.h"
+#include "errortype.hpp"
+
+#include "test_timingwheeltimeoutpublisherservice.h"
+
+#include "timingwheeltimeoutpublisherservice.hpp"
+#include "graph.hpp"
+#include "topicstate.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+#define SUITE_DECLARATION(name, test_ptr) { #name, test_ptr, setup_##name, teardown_##name }
+
+using namespace DetectorGraph;
+
+static int setup_timingwheeltimeoutpublisherservice(void *inContext)
+{
+    return 0;
+}
+
+static int teardown_timingwheeltimeoutpublisherservice(void *inContext)
+{
+    return 0;
+}
+
+namespace {
+    class TestWheel : public TimingWheelTimeoutPublisherService
+    {
+    public:
+        TestWheel(Graph& arGraph, TimeOffset aTickPeriod = 1)
+        : TimingWheelTimeoutPublisherService(arGraph, aTickPeriod), mNow(0)
+        {
+        }
+
+        using TimingWheelTimeoutPublisherService::CancelMetronome;
+
+        TimeOffset GetTime() const { return mNow; }
+        TimeOffset GetMonotonicTime() const { return mNow; }
+
+        size_t Forward(TimeOffset aTime)
+        {
+            mNow += aTime;
+            return AdvanceTime(mNow);
+        }
+
+        TimeOffset mNow;
+    };
+
+    struct Expired : public TopicState
+    {
+        Expired(int aId = 0) : mId(aId) {}
+        int mId;
+    };
+
+    struct Beat : public TopicState
+    {
+    };
+
+    // Evaluates all pending inputs and returns the ids published to Expired.
+    std::vector<int> GetExpired(Graph& arGraph)
+    {
+        std::vector<int> expired;
+        while (arGraph.HasDataPending())
+        {
+            arGraph.EvaluateGraph();
+            Topic<Expired>* topic = arGraph.ResolveTopic<Expired>();
+            if (topic->HasNewValue())
+            {
+                expired.push_back(topic->GetNewValue().mId);
+            }
+        }
+        return expired;
+    }
+}
+
+static void Test_ExpiresAtDeadline(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    TestWheel wheel(graph);
+    TimeoutPublisherHandle handle = wheel.GetUniqueTimerHandle();
+
+    wheel.ScheduleTimeout<Expired>(Expired(42), 100, handle);
+    NL_TEST_ASSERT(inSuite, wheel.GetNumPendingTimeouts() == 1);
+    NL_TEST_ASSERT(inSuite, !wheel.HasTimeoutExpired(handle));
+
+    NL_TEST_ASSERT(inSuite, wheel.Forward(99) == 0);
+    NL_TEST_ASSERT(inSuite, !graph.HasDataPending());
+
+    NL_TEST_ASSERT(inSuite, wheel.Forward(1) == 1);
+    std::vector<int> expired = GetExpired(graph);
+    NL_TEST_ASSERT(inSuite, expired.size() == 1 && expired[0] == 42);
+    NL_TEST_ASSERT(inSuite, wheel.HasTimeoutExpired(handle));
+    NL_TEST_ASSERT(inSuite, wheel.GetNumPendingTimeouts() == 0);
+}
+
+static void Test_CancelAndReschedule(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    TestWheel wheel(graph);
+    TimeoutPublisherHandle handleA = wheel.GetUniqueTimerHandle();
+    TimeoutPublisherHandle handleB = wheel.GetUniqueTimerHandle();
+
+    wheel.ScheduleTimeout<Expired>(Expired(1), 50, handleA);
+    wheel.ScheduleTimeout<Expired>(Expired(2), 50, handleB);
+    wheel.CancelPublishOnTimeout(handleA);
+    NL_TEST_ASSERT(inSuite, wheel.GetNumPendingTimeouts() == 1);
+
+    // Rescheduling replaces the pending deadline.
+    wheel.Forward(40);
+    wheel.ScheduleTimeout<Expired>(Expired(3), 5000, handleB);
+    NL_TEST_ASSERT(inSuite, wheel.Forward(4999) == 0);
+    NL_TEST_ASSERT(inSuite, !graph.HasDataPending());
+
+    NL_TEST_ASSERT(inSuite, wheel.Forward(1) == 1);
+    std::vector<int> expired = GetExpired(graph);
+    NL_TEST_ASSERT(inSuite, expired.size() == 1 && expired[0] == 3);
+    NL_TEST_ASSERT(inSuite, wheel.GetNumPendingTimeouts() == 0);
+}
+
+static void Test_TickRounding(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    TestWheel wheel(graph, 10);
+    TimeoutPublisherHandle handle = wheel.GetUniqueTimerHandle();
+
+    wheel.Forward(3);
+    wheel.ScheduleTimeout<Expired>(Expired(1), 15, handle);
+
+    // Due at 18; fires on the tick at 20, never on the one at 10.
+    NL_TEST_ASSERT(inSuite, wheel.Forward(7) == 0);
+    NL_TEST_ASSERT(inSuite, wheel.Forward(9) == 0);
+    NL_TEST_ASSERT(inSuite, wheel.Forward(1) == 1);
+    NL_TEST_ASSERT(inSuite, wheel.GetMonotonicTime() == 20);
+}
+
+static void Test_ManyTimeoutsAcrossLevels(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    TestWheel wheel(graph);
+
+    const int kNumTimeouts = 2000;
+    std::vector<TimeOffset> deadlines;
+    std::vector<TimeoutPublisherHandle> handles;
+    srand(1);
+    for (int i = 0; i < kNumTimeouts; ++i)
+    {
+        // From a few ticks to well past the second level.
+        const TimeOffset timeout = 1 + (TimeOffset)rand() % (1 << (3 * TimingWheelTimeoutPublisherService::kSlotBits));
+        handles.push_back(wheel.GetUniqueTimerHandle());
+        deadlines.push_back(timeout);
+        wheel.ScheduleTimeout<Expired>(Expired(i), timeout, handles.back());
+    }
+
+    int numExpired = 0;
+    bool allOnTime = true;
+    while (wheel.GetNumPendingTimeouts() > 0)
+    {
+        wheel.Forward(1 + rand() % 300);
+        std::vector<int> expired = GetExpired(graph);
+        for (std::vector<int>::const_iterator it = expired.begin(); it != expired.end(); ++it)
+        {
+            // Expired on the first advance past its deadline.
+            allOnTime &= (deadlines[*it] <= wheel.mNow && deadlines[*it] + 300 > wheel.mNow);
+            numExpired++;
+        }
+    }
+
+    NL_TEST_ASSERT(inSuite, numExpired == kNumTimeouts);
+    NL_TEST_ASSERT(inSuite, allOnTime);
+}
+
+static void Test_TimeoutBeyondWheelRange(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    TestWheel wheel(graph, 1000);
+    TimeoutPublisherHandle handle = wheel.GetUniqueTimerHandle();
+
+    const TimeOffset kRange = (TimeOffset)1000 << (TimingWheelTimeoutPublisherService::kNumLevels * TimingWheelTimeoutPublisherService::kSlotBits);
+    wheel.ScheduleTimeout<Expired>(Expired(7), kRange + kRange / 2, handle);
+
+    NL_TEST_ASSERT(inSuite, wheel.Forward(kRange) == 0);
+    NL_TEST_ASSERT(inSuite, wheel.Forward(kRange / 2 - 1000) == 0);
+    NL_TEST_ASSERT(inSuite, wheel.Forward(1000) == 1);
+    std::vector<int> expired = GetExpired(graph);
+    NL_TEST_ASSERT(inSuite, expired.size() == 1 && expired[0] == 7);
+}
+
+static void Test_Metronome(nlTestSuite *inSuite, void *inContext)
+{
+    Graph graph;
+    TestWheel wheel(graph);
+    TimeoutPublisherHandle handle = wheel.GetUniqueTimerHandle();
+
+    wheel.SchedulePeriodicPublishing<Beat>(100);
+    wheel.SchedulePeriodicPublishing<Expired>(250);
+    wheel.StartPeriodicPublishing();
+    wheel.ScheduleTimeout<Expired>(Expired(1), 60, handle);
+
+    // The metronome only beats when a series is due (every 100ms plus 250ms
+    // and 750ms) alongside the timeout.
+    NL_TEST_ASSERT(inSuite, wheel.Forward(1000) == 12 + 1);
+
+    int numBeats = 0;
+    int numPeriodicExpired = 0;
+    while (graph.HasDataPending())
+    {
+        graph.EvaluateGraph();
+        numBeats += graph.ResolveTopic<Beat>()->HasNewValue() ? 1 : 0;
+        numPeriodicExpired += (graph.ResolveTopic<Expired>()->HasNewValue()
+            && graph.ResolveTopic<Expired>()->GetNewValue().mId == 0) ? 1 : 0;
+    }
+    NL_TEST_ASSERT(inSuite, numBeats == 10);
+    NL_TEST_ASSERT(inSuite, numPeriodicExpired == 4);
+
+    wheel.CancelMetronome();
+    NL_TEST_ASSERT(inSuite, wheel.GetNumPendingTimeouts() == 0);
+    NL_TEST_ASSERT(inSuite, wheel.Forward(1000) == 0);
+}
+
+static const nlTest sTests[] = {
+    NL_TEST_DEF("Test_ExpiresAtDeadline", Test_ExpiresAtDeadline),
+    NL_TEST_DEF("Test_CancelAndReschedule", Test_CancelAndReschedule),
+    NL_TEST_DEF("Test_TickRounding", Test_TickRounding),
+    NL_TEST_DEF("Test_ManyTimeoutsAcrossLevels", Test_ManyTimeoutsAcrossLevels),
+    NL_TEST_DEF("Test_TimeoutBeyondWheelRange", Test_TimeoutBeyondWheelRange),
+    NL_TEST_DEF("Test_Metronome", Test_Metronome),
+    NL_TEST_SENTINEL()
+};
+
+//This function creates the Suite (i.e: the name of your test and points to the array of test functions)
+extern "C"
+int timingwheeltimeoutpublisherservice_testsuite(void)
+{
+    nlTestSuite theSuite = SUITE_DECLARATION(timingwheeltimeoutpublisherservice, &sTests[0]);
+    nlTestRunner(&theSuite, NULL);
+    return nlTestRunnerStats(&theSuite);
+}
@@ -18,6 +18,8 @@
 #include "test_topicstate.h"
 
 #include "topicstate.hpp"
+#include "graph.hpp"
+#include "statesnapshot.hpp"
 
 #define SUITE_DECLARATION(name, test_ptr) { #name, test_ptr, setup_##name, teardown_##name }
 
@@ -49,6 +51,18 @@ namespace {
             return PacketTypeAId;
         }
     };
+
+    // Not default-constructible
+    struct PacketTypeB : public NamedTopicState<43>
+    {
+        explicit PacketTypeB(int aV) : mV(aV) {}; int mV;
+    };
+
+    struct PacketTypeC : public TopicState
+    {
+        static const TopicStateIdType kTopicStateId = 44;
+        virtual TopicStateIdType GetId() const { return kTopicStateId; }
+    };
 }
 
 static void Test_GetId(nlTestSuite *inSuite, void *inContext)
@@ -70,8 +84,35 @@ static void Test_GetId(nlTestSuite *inSuite, void *inContext)
     NL_TEST_ASSERT(inSuite, TopicState::GetId<PacketTypeA>() == PacketTypeA::PacketTypeAId);
 }
 
+static void Test_StaticId(nlTestSuite *inSuite, void *inContext)
+{
+    NL_TEST_ASSERT(inSuite, HasStaticTopicStateId<PacketTypeB>::value);
+    NL_TEST_ASSERT(inSuite, HasStaticTopicStateId<PacketTypeC>::value);
+    NL_TEST_ASSERT(inSuite, !HasStaticTopicStateId<PacketTypeA>::value);
+    NL_TEST_ASSERT(inSuite, !HasStaticTopicStateId<AnonymousPacketType>::value);
+
+    // Usable as a constant expression.
+    char sized[TopicStateIdOf<PacketTypeB>::value];
+    NL_TEST_ASSERT(inSuite, sizeof(sized) == 43);
+
+    NL_TEST_ASSERT(inSuite, TopicState::GetId<PacketTypeB>() == 43);
+    NL_TEST_ASSERT(inSuite, TopicState::GetId<PacketTypeC>() == 44);
+    NL_TEST_ASSERT(inSuite, PacketTypeB(1).GetId() == 43);
+
+    Graph graph;
+    graph.SetOutputFilter(Graph::kOutputNamedTopicsOnly);
+    NL_TEST_ASSERT(inSuite, graph.ResolveTopic<PacketTypeB>()->GetId() == 43);
+    graph.PushData<PacketTypeB>(PacketTypeB(7));
+    graph.EvaluateGraph();
+    NL_TEST_ASSERT(inSuite, graph.GetOutputList().size() == 1);
+
+    StateSnapshot snapshot(graph.GetOutputList());
+    NL_TEST_ASSERT(inSuite, snapshot.GetState<PacketTypeB>()->mV == 7);
+}
+
 static const nlTest sTests[] = {
     NL_TEST_DEF("Test_GetId", Test_GetId),
+    NL_TEST_DEF("Test_StaticId", Test_StaticId),
     NL_TEST_SENTINEL()
 };
 
@@ -36,6 +36,7 @@ enum DetectorGraphConfigEnum
     kMaxNumberOfOutEdges = 20,
     kMaxNumberOfInEdges = 20,
     kMaxNumberOfTopicStates = 2,
+    kMaxPendingInputsPerTopicState = 4,
     kMaxNumberOfTimeouts = 10,
     kMaxNumberOfPeriodicTimers = 4,
 };
@@ -0,0 +1,353 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "snapshotfile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dglogging.hpp"
+
+namespace DetectorGraph
+{
+
+namespace
+{
+    const char kMagic[4] = { 'D', 'G', 'S', 'S' };
+    const uint16_t kFormatVersion = 1;
+    const uint16_t kByteOrderMark = 0x0102;
+
+    struct FileHeader
+    {
+        char mMagic[4];
+        uint16_t mFormatVersion;
+        uint16_t mByteOrderMark;
+        uint32_t mStateVersion;
+        uint32_t mNumEntries;
+        uint64_t mFileSize;
+    };
+
+    size_t AlignUp(size_t aOffset)
+    {
+        const size_t alignment = MappedSnapshotFile::kPayloadAlignment;
+        return (aOffset + alignment - 1) & ~(alignment - 1);
+    }
+
+    bool WriteAll(int aFd, const char* apData, size_t aSize)
+    {
+        while (aSize > 0)
+        {
+            const ssize_t written = write(aFd, apData, aSize);
+            if (written < 0)
+            {
+                return false;
+            }
+            apData += written;
+            aSize -= (size_t)written;
+        }
+        return true;
+    }
+}
+
+struct MappedSnapshotFile::IndexEntry
+{
+    int32_t mId;
+    uint32_t mSize;
+    uint64_t mOffset;
+
+    bool operator<(const IndexEntry& aOther) const { return mId < aOther.mId; }
+};
+
+void SnapshotFileCodecs::Register(TopicStateIdType aId, EncodeFunction aEncode, DecodeFunction aDecode)
+{
+    Codec codec = { aEncode, aDecode };
+    mCodecs[aId] = codec;
+}
+
+SnapshotFileCodecs::EncodeFunction SnapshotFileCodecs::GetEncoder(TopicStateIdType aId) const
+{
+    std::map<TopicStateIdType, Codec>::const_iterator codecIt = mCodecs.find(aId);
+    return (codecIt != mCodecs.end()) ? codecIt->second.mEncode : NULL;
+}
+
+SnapshotFileCodecs::DecodeFunction SnapshotFileCodecs::GetDecoder(TopicStateIdType aId) const
+{
+    std::map<TopicStateIdType, Codec>::const_iterator codecIt = mCodecs.find(aId);
+    return (codecIt != mCodecs.end()) ? codecIt->second.mDecode : NULL;
+}
+
+ErrorType WriteSnapshotFile(
+    const std::string& aPath,
+    const StateSnapshot& arSnapshot,
+    const SnapshotFileCodecs& arCodecs)
+{
+    typedef MappedSnapshotFile::IndexEntry IndexEntry;
+
+    std::list< ptr::shared_ptr<const TopicState> > topicStates;
+    arSnapshot.GetTopicStates(topicStates);
+
+    // Payloads are encoded back to back (aligned) into a single buffer; their
+    // offsets are fixed up once the index size is known.
+    std::vector<IndexEntry> index;
+    index.reserve(topicStates.size());
+    std::string payloads;
+
+    typedef std::list< ptr::shared_ptr<const TopicState> >::const_iterator TopicStateIterator;
+    for (TopicStateIterator stateIt = topicStates.begin(); stateIt != topicStates.end(); ++stateIt)
+    {
+        const TopicStateIdType id = (*stateIt)->GetId();
+        SnapshotFileCodecs::EncodeFunction encode = arCodecs.GetEncoder(id);
+        if (!encode)
+        {
+            continue;
+        }
+
+        payloads.resize(AlignUp(payloads.size()), '\0');
+        const size_t payloadOffset = payloads.size();
+        encode(**stateIt, payloads);
+
+        IndexEntry entry = { (int32_t)id, (uint32_t)(payloads.size() - payloadOffset), payloadOffset };
+        index.push_back(entry);
+    }
+
+    std::sort(index.begin(), index.end());
+
+    const size_t payloadsStart = AlignUp(sizeof(FileHeader) + index.size() * sizeof(IndexEntry));
+    for (size_t i = 0; i < index.size(); ++i)
+    {
+        index[i].mOffset += payloadsStart;
+    }
+
+    FileHeader header;
+    memcpy(header.mMagic, kMagic, sizeof(kMagic));
+    header.mFormatVersion = kFormatVersion;
+    header.mByteOrderMark = kByteOrderMark;
+    header.mStateVersion = arSnapshot.GetStateVersion();
+    header.mNumEntries = (uint32_t)index.size();
+    header.mFileSize = payloadsStart + payloads.size();
+
+    const std::string tempPath = aPath + ".tmp";
+    const int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        DG_LOG("Failed to create %s", tempPath.c_str());
+        return ErrorType_NoResource;
+    }
+
+    const std::string padding(payloadsStart - sizeof(FileHeader) - index.size() * sizeof(IndexEntry), '\0');
+    bool written =
+        WriteAll(fd, reinterpret_cast<const char*>(&header), sizeof(header)) &&
+        WriteAll(fd, reinterpret_cast<const char*>(index.data()), index.size() * sizeof(IndexEntry)) &&
+        WriteAll(fd, padding.data(), padding.size()) &&
+        WriteAll(fd, payloads.data(), payloads.size());
+
+    // The data must be on disk before the rename makes it visible.
+    written = written && (fsync(fd) == 0);
+    written = (close(fd) == 0) && written;
+
+    if (!written || rename(tempPath.c_str(), aPath.c_str()) != 0)
+    {
+        DG_LOG("Failed to write %s", aPath.c_str());
+        unlink(tempPath.c_str());
+        return ErrorType_Failure;
+    }
+
+    return SyncParentDirectory(aPath);
+}
+
+ErrorType SyncParentDirectory(const std::string& aPath)
+{
+    const size_t separator = aPath.rfind('/');
+    const std::string directory =
+        (separator == std::string::npos) ? std::string(".") :
+        (separator == 0) ? std::string("/") : aPath.substr(0, separator);
+
+    const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+    {
+        DG_LOG("Failed to open %s", directory.c_str());
+        return ErrorType_NoResource;
+    }
+
+    const bool synced = (fsync(fd) == 0);
+    close(fd);
+    if (!synced)
+    {
+        DG_LOG("Failed to sync %s", directory.c_str());
+        return ErrorType_Failure;
+    }
+
+    return ErrorType_Success;
+}
+
+MappedSnapshotFile::MappedSnapshotFile()
+: mpData(NULL)
+, mSize(0)
+, mStateVersion(0)
+, mNumEntries(0)
+{
+}
+
+MappedSnapshotFile::~MappedSnapshotFile()
+{
+    Close();
+}
+
+ErrorType MappedSnapshotFile::Open(const std::string& aPath)
+{
+    Close();
+
+    const int fd = open(aPath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return ErrorType_NoResource;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0)
+    {
+        close(fd);
+        return ErrorType_NoResource;
+    }
+
+    if ((size_t)fileStat.st_size < sizeof(FileHeader))
+    {
+        close(fd);
+        return ErrorType_Parse;
+    }
+
+    void* mapping = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after closing its descriptor.
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        return ErrorType_NoResource;
+    }
+
+    mpData = static_cast<const uint8_t*>(mapping);
+    mSize = (size_t)fileStat.st_size;
+
+    // Validate everything GetEntry relies on, so lookups need no checks.
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(mpData);
+    bool valid =
+        memcmp(header->mMagic, kMagic, sizeof(kMagic)) == 0 &&
+        header->mFormatVersion == kFormatVersion &&
+        header->mByteOrderMark == kByteOrderMark &&
+        header->mFileSize == mSize &&
+        header->mNumEntries <= (mSize - sizeof(FileHeader)) / sizeof(IndexEntry);
+
+    const IndexEntry* index = reinterpret_cast<const IndexEntry*>(mpData + sizeof(FileHeader));
+    for (uint32_t i = 0; valid && i < header->mNumEntries; ++i)
+    {
+        valid =
+            index[i].mOffset % kPayloadAlignment == 0 &&
+            index[i].mOffset <= mSize &&
+            index[i].mSize <= mSize - index[i].mOffset &&
+            (i == 0 || index[i - 1].mId < index[i].mId);
+    }
+
+    if (!valid)
+    {
+        DG_LOG("%s is not a valid snapshot file", aPath.c_str());
+        Close();
+        return ErrorType_Parse;
+    }
+
+    mStateVersion = header->mStateVersion;
+    mNumEntries = header->mNumEntries;
+    return ErrorType_Success;
+}
+
+void MappedSnapshotFile::Close()
+{
+    if (mpData)
+    {
+        munmap(const_cast<uint8_t*>(mpData), mSize);
+    }
+    mpData = NULL;
+    mSize = 0;
+    mStateVersion = 0;
+    mNumEntries = 0;
+}
+
+bool MappedSnapshotFile::IsOpen() const
+{
+    return mpData != NULL;
+}
+
+unsigned int MappedSnapshotFile::GetStateVersion() const
+{
+    return mStateVersion;
+}
+
+size_t MappedSnapshotFile::GetNumEntries() const
+{
+    return mNumEntries;
+}
+
+const MappedSnapshotFile::IndexEntry* MappedSnapshotFile::GetIndex() const
+{
+    return reinterpret_cast<const IndexEntry*>(mpData + sizeof(FileHeader));
+}
+
+const void* MappedSnapshotFile::GetEntry(TopicStateIdType aId, size_t& aOutSize) const
+{
+    if (!mpData)
+    {
+        return NULL;
+    }
+
+    const IndexEntry key = { (int32_t)aId, 0, 0 };
+    const IndexEntry* indexEnd = GetIndex() + mNumEntries;
+    const IndexEntry* entry = std::lower_bound(GetIndex(), indexEnd, key);
+    if (entry == indexEnd || entry->mId != key.mId)
+    {
+        return NULL;
+    }
+
+    aOutSize = entry->mSize;
+    return mpData + entry->mOffset;
+}
+
+ErrorType MappedSnapshotFile::GetTopicStates(
+    const SnapshotFileCodecs& arCodecs,
+    std::list< ptr::shared_ptr<const TopicState> >& aOutTopicStateList) const
+{
+    const IndexEntry* index = GetIndex();
+    for (size_t i = 0; i < mNumEntries; ++i)
+    {
+        SnapshotFileCodecs::DecodeFunction decode = arCodecs.GetDecoder(index[i].mId);
+        if (!decode)
+        {
+            continue;
+        }
+
+        ptr::shared_ptr<const TopicState> topicState = decode(mpData + index[i].mOffset, index[i].mSize);
+        if (!topicState)
+        {
+            return ErrorType_Parse;
+        }
+        aOutTopicStateList.push_back(topicState);
+    }
+
+    return ErrorType_Success;
+}
+
+}
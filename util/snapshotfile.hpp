@@ -0,0 +1,253 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DETECTORGRAPH_UTIL_SNAPSHOTFILE_HPP_
+#define DETECTORGRAPH_UTIL_SNAPSHOTFILE_HPP_
+
+#include "errortype.hpp"
+#include "sharedptr.hpp"
+#include "statesnapshot.hpp"
+#include "topicstate.hpp"
+
+#include <list>
+#include <map>
+#include <string>
+#include <stdint.h>
+#include <type_traits>
+
+namespace DetectorGraph
+{
+
+/**
+ * @brief Per-TopicState encoders/decoders used by the snapshot file format.
+ *
+ * Only TopicStates with a registered codec are written to / read from a
+ * snapshot file - any other TopicStates in a StateSnapshot are skipped.
+ *
+ * TopicStates can't be copied byte-wise themselves (they're polymorphic) but
+ * their data can: a TopicState that inherits its data from a trivially
+ * copyable struct can be registered with RegisterTrivial; its payload is then
+ * stored as-is and can be read in place from a MappedSnapshotFile.
+ * @code
+struct Position { int32_t x; int32_t y; };
+struct PositionState : public DetectorGraph::TopicState, public Position
+{
+    virtual DetectorGraph::TopicStateIdType GetId() const { return kPositionId; }
+};
+
+codecs.RegisterTrivial<PositionState, Position>();
+ * @endcode
+ */
+class SnapshotFileCodecs
+{
+public:
+    /**
+     * @brief Appends the serialized form of a TopicState to aOut.
+     */
+    typedef void (*EncodeFunction)(const TopicState& arTopicState, std::string& aOut);
+
+    /**
+     * @brief Builds a TopicState from its serialized form.
+     *
+     * Returns an empty ptr::shared_ptr if the data is malformed.
+     */
+    typedef ptr::shared_ptr<const TopicState> (*DecodeFunction)(const void* apData, size_t aSize);
+
+    /**
+     * @brief Registers a codec for the TopicState with Id \p aId.
+     */
+    void Register(TopicStateIdType aId, EncodeFunction aEncode, DecodeFunction aDecode);
+
+    /**
+     * @brief Registers a codec that stores T's \p TPayload base byte-wise.
+     *
+     * \p TPayload must be trivially copyable and T default-constructible.
+     */
+    template<class T, class TPayload>
+    void RegisterTrivial()
+    {
+        static_assert(std::is_base_of<TopicState, T>::value, "T must inherit from TopicState");
+        static_assert(std::is_base_of<TPayload, T>::value, "T must inherit from TPayload");
+        static_assert(std::is_trivially_copyable<TPayload>::value, "TPayload must be trivially copyable");
+
+        Register(TopicState::GetId<T>(), &EncodeTrivial<T, TPayload>, &DecodeTrivial<T, TPayload>);
+    }
+
+    /**
+     * @brief Returns the encoder for \p aId or NULL if none was registered.
+     */
+    EncodeFunction GetEncoder(TopicStateIdType aId) const;
+
+    /**
+     * @brief Returns the decoder for \p aId or NULL if none was registered.
+     */
+    DecodeFunction GetDecoder(TopicStateIdType aId) const;
+
+private:
+    template<class T, class TPayload>
+    static void EncodeTrivial(const TopicState& arTopicState, std::string& aOut)
+    {
+        const TPayload& payload = static_cast<const T&>(arTopicState);
+        aOut.append(reinterpret_cast<const char*>(&payload), sizeof(TPayload));
+    }
+
+    template<class T, class TPayload>
+    static ptr::shared_ptr<const TopicState> DecodeTrivial(const void* apData, size_t aSize)
+    {
+        if (aSize != sizeof(TPayload))
+        {
+            return ptr::shared_ptr<const TopicState>();
+        }
+
+        T* topicState = new T();
+        static_cast<TPayload&>(*topicState) = *static_cast<const TPayload*>(apData);
+        return ptr::shared_ptr<const TopicState>(topicState);
+    }
+
+    struct Codec
+    {
+        EncodeFunction mEncode;
+        DecodeFunction mDecode;
+    };
+
+    std::map<TopicStateIdType, Codec> mCodecs;
+};
+
+/**
+ * @brief Writes the TopicStates of a StateSnapshot to a binary snapshot file.
+ *
+ * The file is written to a temporary file next to \p aPath, flushed to disk
+ * and then renamed over \p aPath - so readers (and a reboot mid-write) see
+ * either the previous file or the complete new one. The directory is flushed
+ * after the rename so the new file also survives a power loss.
+ *
+ * # Format #
+ * A versioned header (magic, format version, byte order mark, state version,
+ * entry count, file size) followed by an index of {TopicStateId, size,
+ * offset} entries sorted by Id and then the payloads, each aligned to
+ * MappedSnapshotFile::kPayloadAlignment. All positions are file offsets so
+ * the file is relocatable; it's meant to be read back by a build of the same
+ * architecture (the byte order mark rejects the others).
+ */
+ErrorType WriteSnapshotFile(
+    const std::string& aPath,
+    const StateSnapshot& arSnapshot,
+    const SnapshotFileCodecs& arCodecs);
+
+/**
+ * @brief Flushes the directory containing \p aPath to disk.
+ *
+ * Files created, renamed or removed there only survive a power loss once
+ * their directory entry is on disk too.
+ */
+ErrorType SyncParentDirectory(const std::string& aPath);
+
+/**
+ * @brief A read-only, memory-mapped view of a snapshot file.
+ *
+ * Opening a file maps it and validates its header and index but doesn't
+ * decode anything. Payloads of trivially-coded TopicStates can then be read in
+ * place with GetInPlace - with no per-entry allocation or copy - and
+ * GetTopicStates decodes TopicStates for building a StateSnapshot (e.g. for
+ * ResumeFromSnapshotTopicState).
+ *
+ * Pointers returned by GetInPlace/GetEntry are valid until Close() or
+ * destruction.
+ */
+class MappedSnapshotFile
+{
+public:
+    MappedSnapshotFile();
+    ~MappedSnapshotFile();
+
+    /**
+     * @brief Maps and validates the snapshot file at \p aPath.
+     *
+     * Returns ErrorType_NoResource if the file can't be opened or mapped and
+     * ErrorType_Parse if it isn't a valid snapshot file of this format version.
+     */
+    ErrorType Open(const std::string& aPath);
+
+    /**
+     * @brief Unmaps the file (if any).
+     */
+    void Close();
+
+    bool IsOpen() const;
+
+    /**
+     * @brief Returns the version of the StateSnapshot that was written.
+     */
+    unsigned int GetStateVersion() const;
+
+    /**
+     * @brief Returns the number of TopicStates in the file.
+     */
+    size_t GetNumEntries() const;
+
+    /**
+     * @brief Returns the serialized data for \p aId in place
+     *
+     * Or NULL if there's no such entry. Runs in O(log n).
+     */
+    const void* GetEntry(TopicStateIdType aId, size_t& aOutSize) const;
+
+    /**
+     * @brief Returns the payload of a trivially-coded T in place
+     *
+     * Or NULL if there's no entry for T or its size doesn't match TPayload.
+     * @sa SnapshotFileCodecs::RegisterTrivial
+     */
+    template<class T, class TPayload>
+    const TPayload* GetInPlace() const
+    {
+        static_assert(std::is_trivially_copyable<TPayload>::value, "TPayload must be trivially copyable");
+        static_assert(alignof(TPayload) <= kPayloadAlignment, "TPayload is over-aligned");
+
+        size_t size = 0;
+        const void* data = GetEntry(TopicState::GetId<T>(), size);
+        return (data && size == sizeof(TPayload)) ? static_cast<const TPayload*>(data) : NULL;
+    }
+
+    /**
+     * @brief Decodes all TopicStates with a registered decoder into
+     * aOutTopicStateList, ordered by TopicStateId.
+     *
+     * Returns ErrorType_Parse if a decoder rejects its data.
+     */
+    ErrorType GetTopicStates(
+        const SnapshotFileCodecs& arCodecs,
+        std::list< ptr::shared_ptr<const TopicState> >& aOutTopicStateList) const;
+
+    static const size_t kPayloadAlignment = 16;
+
+    // On-disk index entry; defined with the format in snapshotfile.cpp.
+    struct IndexEntry;
+
+private:
+    // Non-copyable
+    MappedSnapshotFile(const MappedSnapshotFile&);
+    MappedSnapshotFile& operator=(const MappedSnapshotFile&);
+
+    const IndexEntry* GetIndex() const;
+
+    const uint8_t* mpData;
+    size_t mSize;
+    unsigned int mStateVersion;
+    size_t mNumEntries;
+};
+
+}
+
+#endif // DETECTORGRAPH_UTIL_SNAPSHOTFILE_HPP_
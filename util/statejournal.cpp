@@ -0,0 +1,498 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "statejournal.hpp"
+
+#include <cstring>
+#include <map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dglogging.hpp"
+
+namespace DetectorGraph
+{
+
+namespace
+{
+    const uint32_t kRecordMagic = 0x4447524A; // "DGRJ"
+    const size_t kEntryAlignment = 16;
+
+    // A record is a RecordHeader followed by mNumEntries entries, each an
+    // EntryHeader followed by the encoded TopicState padded to kEntryAlignment.
+    struct RecordHeader
+    {
+        uint32_t mMagic;
+        uint32_t mPayloadSize;
+        uint32_t mChecksum;
+        uint32_t mNumEntries;
+    };
+
+    struct EntryHeader
+    {
+        int32_t mId;
+        uint32_t mSize;
+        uint64_t mReserved;
+    };
+
+    size_t AlignUp(size_t aOffset)
+    {
+        return (aOffset + kEntryAlignment - 1) & ~(kEntryAlignment - 1);
+    }
+
+    // FNV-1a; enough to detect a torn or partially written record.
+    uint32_t Checksum(const uint8_t* apData, size_t aSize)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < aSize; ++i)
+        {
+            hash = (hash ^ apData[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    bool WriteAll(int aFd, const char* apData, size_t aSize)
+    {
+        while (aSize > 0)
+        {
+            const ssize_t written = write(aFd, apData, aSize);
+            if (written < 0)
+            {
+                return false;
+            }
+            apData += written;
+            aSize -= (size_t)written;
+        }
+        return true;
+    }
+
+    bool FileExists(const std::string& aPath)
+    {
+        return access(aPath.c_str(), F_OK) == 0;
+    }
+}
+
+StateJournal::StateJournal(const SnapshotFileCodecs& arCodecs)
+: mrCodecs(arCodecs)
+, mSnapshotPath()
+, mJournalPath()
+, mPreviousJournalPath()
+, mJournalFd(-1)
+, mGroupCommitSize(kDefaultGroupCommitSize)
+, mNumUnsyncedRecords(0)
+, mNumRecords(0)
+, mRecordBuffer()
+, mCompactionThread()
+, mCompacting(false)
+, mCompactionResult(ErrorType_Success)
+{
+}
+
+StateJournal::~StateJournal()
+{
+    Close();
+}
+
+ErrorType StateJournal::Open(
+    const std::string& aBasePath,
+    const StateSnapshot& arPrimeSnapshot,
+    StateSnapshot& arOutSnapshot)
+{
+    Close();
+
+    mSnapshotPath = aBasePath + ".snapshot";
+    mJournalPath = aBasePath + ".journal";
+    mPreviousJournalPath = aBasePath + ".journal.prev";
+
+    // Oldest to newest: base snapshot, journal rotated by an interrupted
+    // compaction, journal.
+    std::list< ptr::shared_ptr<const TopicState> > topicStates;
+
+    MappedSnapshotFile baseSnapshot;
+    ErrorType result = baseSnapshot.Open(mSnapshotPath);
+    if (result == ErrorType_Success)
+    {
+        result = baseSnapshot.GetTopicStates(mrCodecs, topicStates);
+    }
+    else if (result == ErrorType_NoResource && !FileExists(mSnapshotPath))
+    {
+        result = ErrorType_Success;
+    }
+
+    if (result == ErrorType_Success)
+    {
+        result = ReplayJournalFile(mPreviousJournalPath, topicStates);
+    }
+
+    if (result == ErrorType_Success)
+    {
+        result = ReplayJournalFile(mJournalPath, topicStates);
+    }
+
+    if (result != ErrorType_Success)
+    {
+        DG_LOG("Failed to recover state from %s", aBasePath.c_str());
+        return result;
+    }
+
+    // Fold into one TopicState per Id (latest wins) as StateSnapshot expects.
+    std::map< TopicStateIdType, ptr::shared_ptr<const TopicState> > latestTopicStates;
+    typedef std::list< ptr::shared_ptr<const TopicState> >::const_iterator TopicStateIterator;
+    for (TopicStateIterator stateIt = topicStates.begin(); stateIt != topicStates.end(); ++stateIt)
+    {
+        latestTopicStates[(*stateIt)->GetId()] = *stateIt;
+    }
+
+    std::list< ptr::shared_ptr<const TopicState> > recoveredTopicStates;
+    typedef std::map< TopicStateIdType, ptr::shared_ptr<const TopicState> >::const_iterator LatestIterator;
+    for (LatestIterator latestIt = latestTopicStates.begin(); latestIt != latestTopicStates.end(); ++latestIt)
+    {
+        recoveredTopicStates.push_back(latestIt->second);
+    }
+
+    arOutSnapshot = StateSnapshot(arPrimeSnapshot, recoveredTopicStates);
+
+    // Compact what was recovered so the journals (including any torn record)
+    // can be discarded.
+    result = WriteSnapshotFile(mSnapshotPath, arOutSnapshot, mrCodecs);
+    if (result != ErrorType_Success)
+    {
+        return result;
+    }
+
+    unlink(mPreviousJournalPath.c_str());
+    result = SyncParentDirectory(mPreviousJournalPath);
+    if (result != ErrorType_Success)
+    {
+        return result;
+    }
+
+    return OpenJournalFile();
+}
+
+void StateJournal::Close()
+{
+    WaitForCompaction();
+
+    if (mJournalFd >= 0)
+    {
+        Sync();
+        close(mJournalFd);
+        mJournalFd = -1;
+    }
+}
+
+void StateJournal::SetGroupCommitSize(size_t aNumRecords)
+{
+    mGroupCommitSize = (aNumRecords > 0) ? aNumRecords : 1;
+}
+
+ErrorType StateJournal::Append(const std::list< ptr::shared_ptr<const TopicState> >& arTopicStates)
+{
+    if (mJournalFd < 0)
+    {
+        return ErrorType_Init;
+    }
+
+    mRecordBuffer.assign(sizeof(RecordHeader), '\0');
+    uint32_t numEntries = 0;
+
+    typedef std::list< ptr::shared_ptr<const TopicState> >::const_iterator TopicStateIterator;
+    for (TopicStateIterator stateIt = arTopicStates.begin(); stateIt != arTopicStates.end(); ++stateIt)
+    {
+        const TopicStateIdType id = (*stateIt)->GetId();
+        SnapshotFileCodecs::EncodeFunction encode = mrCodecs.GetEncoder(id);
+        if (id == TopicState::kAnonymousTopicState || !encode)
+        {
+            continue;
+        }
+
+        const size_t entryOffset = mRecordBuffer.size();
+        mRecordBuffer.append(sizeof(EntryHeader), '\0');
+        encode(**stateIt, mRecordBuffer);
+
+        EntryHeader entryHeader = { (int32_t)id, (uint32_t)(mRecordBuffer.size() - entryOffset - sizeof(EntryHeader)), 0 };
+        memcpy(&mRecordBuffer[entryOffset], &entryHeader, sizeof(entryHeader));
+        mRecordBuffer.resize(AlignUp(mRecordBuffer.size()), '\0');
+        ++numEntries;
+    }
+
+    if (numEntries == 0)
+    {
+        return ErrorType_Success;
+    }
+
+    const size_t payloadSize = mRecordBuffer.size() - sizeof(RecordHeader);
+    RecordHeader recordHeader = {
+        kRecordMagic,
+        (uint32_t)payloadSize,
+        Checksum(reinterpret_cast<const uint8_t*>(mRecordBuffer.data()) + sizeof(RecordHeader), payloadSize),
+        numEntries };
+    memcpy(&mRecordBuffer[0], &recordHeader, sizeof(recordHeader));
+
+    if (!WriteAll(mJournalFd, mRecordBuffer.data(), mRecordBuffer.size()))
+    {
+        return ErrorType_Failure;
+    }
+
+    ++mNumRecords;
+    if (++mNumUnsyncedRecords >= mGroupCommitSize)
+    {
+        return Sync();
+    }
+
+    return ErrorType_Success;
+}
+
+ErrorType StateJournal::Sync()
+{
+    if (mJournalFd < 0)
+    {
+        return ErrorType_Init;
+    }
+
+    if (mNumUnsyncedRecords > 0)
+    {
+        if (fsync(mJournalFd) != 0)
+        {
+            return ErrorType_Failure;
+        }
+        mNumUnsyncedRecords = 0;
+    }
+
+    return ErrorType_Success;
+}
+
+ErrorType StateJournal::StartCompaction(const ptr::shared_ptr<const StateSnapshot>& aSnapshot)
+{
+    if (mJournalFd < 0)
+    {
+        return ErrorType_Init;
+    }
+
+    if (IsCompacting())
+    {
+        return ErrorType_NoResource;
+    }
+    WaitForCompaction();
+
+    ErrorType result = Sync();
+    if (result != ErrorType_Success)
+    {
+        return result;
+    }
+
+    // If the previous compaction failed its journal is still needed; keep
+    // adding to it instead of replacing it.
+    if (FileExists(mPreviousJournalPath))
+    {
+        result = MergeIntoPreviousJournal();
+    }
+    else
+    {
+        close(mJournalFd);
+        mJournalFd = -1;
+        result = (rename(mJournalPath.c_str(), mPreviousJournalPath.c_str()) == 0) ?
+            SyncParentDirectory(mPreviousJournalPath) : ErrorType_Failure;
+    }
+
+    // Even on failure a journal must be open to keep appending.
+    const ErrorType openResult = (mJournalFd < 0) ? OpenJournalFile() : ErrorType_Success;
+    if (result != ErrorType_Success || openResult != ErrorType_Success)
+    {
+        return (result != ErrorType_Success) ? result : openResult;
+    }
+
+    mNumRecords = 0;
+    mCompacting = true;
+    mCompactionThread = std::thread(&StateJournal::CompactInBackground, this, aSnapshot);
+    return ErrorType_Success;
+}
+
+bool StateJournal::IsCompacting() const
+{
+    return mCompacting;
+}
+
+ErrorType StateJournal::WaitForCompaction()
+{
+    if (mCompactionThread.joinable())
+    {
+        mCompactionThread.join();
+    }
+    return mCompactionResult;
+}
+
+size_t StateJournal::GetNumRecords() const
+{
+    return mNumRecords;
+}
+
+ErrorType StateJournal::OpenJournalFile()
+{
+    mJournalFd = open(mJournalPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    mNumUnsyncedRecords = 0;
+    mNumRecords = 0;
+    if (mJournalFd < 0)
+    {
+        return ErrorType_NoResource;
+    }
+
+    // Both the truncation and, if it was just created, the file itself must
+    // be on disk before records appended to it are.
+    if (fsync(mJournalFd) != 0)
+    {
+        return ErrorType_Failure;
+    }
+    return SyncParentDirectory(mJournalPath);
+}
+
+ErrorType StateJournal::MergeIntoPreviousJournal()
+{
+    const int previousFd = open(mPreviousJournalPath.c_str(), O_WRONLY | O_APPEND);
+    const int currentFd = open(mJournalPath.c_str(), O_RDONLY);
+    bool merged = previousFd >= 0 && currentFd >= 0;
+
+    char buffer[4096];
+    ssize_t numRead = 0;
+    while (merged && (numRead = read(currentFd, buffer, sizeof(buffer))) > 0)
+    {
+        merged = WriteAll(previousFd, buffer, (size_t)numRead);
+    }
+    merged = merged && numRead == 0 && fsync(previousFd) == 0;
+
+    if (previousFd >= 0)
+    {
+        close(previousFd);
+    }
+    if (currentFd >= 0)
+    {
+        close(currentFd);
+    }
+
+    if (!merged)
+    {
+        return ErrorType_Failure;
+    }
+
+    // The records are now safely in the previous journal.
+    close(mJournalFd);
+    mJournalFd = -1;
+    return ErrorType_Success;
+}
+
+ErrorType StateJournal::ReplayJournalFile(
+    const std::string& aPath,
+    std::list< ptr::shared_ptr<const TopicState> >& aOutTopicStateList) const
+{
+    const int fd = open(aPath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return FileExists(aPath) ? ErrorType_NoResource : ErrorType_Success;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0)
+    {
+        close(fd);
+        return ErrorType_NoResource;
+    }
+
+    const size_t size = (size_t)fileStat.st_size;
+    if (size == 0)
+    {
+        close(fd);
+        return ErrorType_Success;
+    }
+
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        return ErrorType_NoResource;
+    }
+
+    const uint8_t* data = static_cast<const uint8_t*>(mapping);
+    ErrorType result = ErrorType_Success;
+    size_t offset = 0;
+    while (result == ErrorType_Success && size - offset >= sizeof(RecordHeader))
+    {
+        const RecordHeader* record = reinterpret_cast<const RecordHeader*>(data + offset);
+        const uint8_t* payload = data + offset + sizeof(RecordHeader);
+        if (record->mMagic != kRecordMagic ||
+            record->mPayloadSize > size - offset - sizeof(RecordHeader) ||
+            record->mChecksum != Checksum(payload, record->mPayloadSize))
+        {
+            // A crash mid-append leaves a torn record; everything before it
+            // is intact and nothing can follow it.
+            DG_LOG("Ignoring torn record at offset %zu of %s", offset, aPath.c_str());
+            break;
+        }
+
+        size_t entryOffset = 0;
+        for (uint32_t entry = 0; entry < record->mNumEntries; ++entry)
+        {
+            if (record->mPayloadSize - entryOffset < sizeof(EntryHeader))
+            {
+                result = ErrorType_Parse;
+                break;
+            }
+
+            const EntryHeader* entryHeader = reinterpret_cast<const EntryHeader*>(payload + entryOffset);
+            const size_t dataOffset = entryOffset + sizeof(EntryHeader);
+            SnapshotFileCodecs::DecodeFunction decode = mrCodecs.GetDecoder(entryHeader->mId);
+            if (entryHeader->mSize > record->mPayloadSize - dataOffset)
+            {
+                result = ErrorType_Parse;
+                break;
+            }
+
+            if (decode)
+            {
+                ptr::shared_ptr<const TopicState> topicState = decode(payload + dataOffset, entryHeader->mSize);
+                if (!topicState)
+                {
+                    result = ErrorType_Parse;
+                    break;
+                }
+                aOutTopicStateList.push_back(topicState);
+            }
+
+            entryOffset = AlignUp(dataOffset + entryHeader->mSize);
+        }
+
+        offset += sizeof(RecordHeader) + record->mPayloadSize;
+    }
+
+    munmap(mapping, size);
+    return result;
+}
+
+void StateJournal::CompactInBackground(ptr::shared_ptr<const StateSnapshot> aSnapshot)
+{
+    ErrorType result = WriteSnapshotFile(mSnapshotPath, *aSnapshot, mrCodecs);
+    if (result == ErrorType_Success)
+    {
+        result = (unlink(mPreviousJournalPath.c_str()) == 0) ?
+            SyncParentDirectory(mPreviousJournalPath) : ErrorType_Failure;
+    }
+
+    mCompactionResult = result;
+    mCompacting = false;
+}
+
+}
@@ -0,0 +1,168 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DETECTORGRAPH_UTIL_STATEJOURNAL_HPP_
+#define DETECTORGRAPH_UTIL_STATEJOURNAL_HPP_
+
+#include "errortype.hpp"
+#include "sharedptr.hpp"
+#include "snapshotfile.hpp"
+#include "statesnapshot.hpp"
+#include "topicstate.hpp"
+
+#include <atomic>
+#include <list>
+#include <string>
+#include <thread>
+
+namespace DetectorGraph
+{
+
+/**
+ * @brief An append-only journal of named TopicState changes for crash recovery.
+ *
+ * Instead of writing a full snapshot file after every evaluation, each
+ * evaluation's named outputs (e.g. Graph::GetOutputList() with
+ * kOutputNamedTopicsOnly - the same delta StateSnapshot folds in) are appended
+ * to a journal as a single checksummed record. Every record is written to the
+ * file right away - so it survives the process crashing - and `fsync`s are
+ * batched every SetGroupCommitSize() records (or on Sync()) - bounding what a
+ * power loss can take.
+ *
+ * Compaction folds the journal into a base snapshot file (see
+ * WriteSnapshotFile): StartCompaction rotates the journal aside and writes
+ * the given StateSnapshot in the background while new records go to a fresh
+ * journal.
+ *
+ * On Open the base snapshot, a journal left aside by an interrupted
+ * compaction and the journal are replayed in order - stopping at a torn
+ * trailing record - and the result is compacted before appending resumes.
+ * The recovered StateSnapshot is then meant to be fed to the graph as a
+ * ResumeFromSnapshotTopicState.
+ *
+ * Files used, for a given base path `P`: `P.snapshot`, `P.journal` and
+ * `P.journal.prev` (while a compaction is pending). Their directory is
+ * flushed after every rename, removal or (re)creation of these files so the
+ * on-disk set stays consistent across a power loss.
+ *
+ * Only TopicStates with a codec in the given SnapshotFileCodecs are journaled.
+ * A StateJournal must be used from a single thread; compactions run on a
+ * thread of their own.
+ */
+class StateJournal
+{
+public:
+    static const size_t kDefaultGroupCommitSize = 16;
+
+    /**
+     * @brief Creates a closed journal using \p arCodecs (which must outlive it).
+     */
+    StateJournal(const SnapshotFileCodecs& arCodecs);
+
+    /**
+     * @brief Waits for any ongoing compaction and closes the journal.
+     */
+    ~StateJournal();
+
+    /**
+     * @brief Recovers the state stored at \p aBasePath and opens the journal.
+     *
+     * Fills \p arOutSnapshot with \p arPrimeSnapshot updated by the base
+     * snapshot and then every journaled record. The recovered state is then
+     * compacted so the journal starts out empty.
+     */
+    ErrorType Open(
+        const std::string& aBasePath,
+        const StateSnapshot& arPrimeSnapshot,
+        StateSnapshot& arOutSnapshot);
+
+    /**
+     * @brief Syncs and closes the journal.
+     */
+    void Close();
+
+    /**
+     * @brief Sets after how many appended records the journal is `fsync`ed.
+     *
+     * 1 syncs every record; larger values trade a (power loss only) window of
+     * records for fewer `fsync`s.
+     */
+    void SetGroupCommitSize(size_t aNumRecords);
+
+    /**
+     * @brief Appends the named TopicStates in \p arTopicStates as one record.
+     *
+     * Lists with no journaled TopicStates write nothing.
+     */
+    ErrorType Append(const std::list< ptr::shared_ptr<const TopicState> >& arTopicStates);
+
+    /**
+     * @brief Flushes all appended records to disk.
+     */
+    ErrorType Sync();
+
+    /**
+     * @brief Folds the journal into the base snapshot in the background.
+     *
+     * \p aSnapshot must contain every change appended so far (e.g. the
+     * GraphStateStore's last state). Returns ErrorType_NoResource if a
+     * compaction is still running.
+     */
+    ErrorType StartCompaction(const ptr::shared_ptr<const StateSnapshot>& aSnapshot);
+
+    /**
+     * @brief Returns whether a compaction started by StartCompaction is running.
+     */
+    bool IsCompacting() const;
+
+    /**
+     * @brief Waits for the last compaction to finish and returns its result.
+     */
+    ErrorType WaitForCompaction();
+
+    /**
+     * @brief Returns the number of records appended since the last compaction.
+     */
+    size_t GetNumRecords() const;
+
+private:
+    // Non-copyable
+    StateJournal(const StateJournal&);
+    StateJournal& operator=(const StateJournal&);
+
+    ErrorType OpenJournalFile();
+    ErrorType MergeIntoPreviousJournal();
+    ErrorType ReplayJournalFile(
+        const std::string& aPath,
+        std::list< ptr::shared_ptr<const TopicState> >& aOutTopicStateList) const;
+    void CompactInBackground(ptr::shared_ptr<const StateSnapshot> aSnapshot);
+
+    const SnapshotFileCodecs& mrCodecs;
+    std::string mSnapshotPath;
+    std::string mJournalPath;
+    std::string mPreviousJournalPath;
+    int mJournalFd;
+    size_t mGroupCommitSize;
+    size_t mNumUnsyncedRecords;
+    size_t mNumRecords;
+    std::string mRecordBuffer;
+
+    std::thread mCompactionThread;
+    std::atomic<bool> mCompacting;
+    ErrorType mCompactionResult;
+};
+
+}
+
+#endif // DETECTORGRAPH_UTIL_STATEJOURNAL_HPP_
@@ -0,0 +1,266 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "timingwheeltimeoutpublisherservice.hpp"
+
+#include "dgassert.hpp"
+
+namespace DetectorGraph
+{
+
+namespace
+{
+    const uint64_t kSlotMask = TimingWheelTimeoutPublisherService::kSlotsPerLevel - 1;
+}
+
+TimingWheelTimeoutPublisherService::TimingWheelTimeoutPublisherService(
+    Graph& arGraph,
+    TimeOffset aTickPeriodInMilliseconds)
+: TimeoutPublisherService(arGraph)
+, mTickPeriod(aTickPeriodInMilliseconds)
+, mNow(0)
+, mCurrentTick(0)
+, mExpiring(false)
+, mNumPending(0)
+, mNodes(1)
+{
+    DG_ASSERT(mTickPeriod > 0);
+    for (unsigned slot = 0; slot < kNumLevels * kSlotsPerLevel; ++slot)
+    {
+        mSlots[slot] = kNullNode;
+    }
+    for (unsigned level = 0; level < kNumLevels; ++level)
+    {
+        mNumPendingPerLevel[level] = 0;
+    }
+}
+
+size_t TimingWheelTimeoutPublisherService::AdvanceTime(TimeOffset aMonotonicTime)
+{
+    DG_ASSERT(aMonotonicTime >= mNow);
+
+    size_t numFired = 0;
+    const uint64_t targetTick = aMonotonicTime / mTickPeriod;
+    mExpiring = true;
+    while (mCurrentTick < targetTick)
+    {
+        // Nothing can happen before the next slot of the lowest occupied
+        // level comes due - skip straight to it.
+        unsigned lowestLevel = 0;
+        while (lowestLevel < kNumLevels && mNumPendingPerLevel[lowestLevel] == 0)
+        {
+            ++lowestLevel;
+        }
+        if (lowestLevel == kNumLevels)
+        {
+            mCurrentTick = targetTick;
+            break;
+        }
+        if (lowestLevel > 0)
+        {
+            const unsigned shift = lowestLevel * kSlotBits;
+            const uint64_t nextSlotTick = ((mCurrentTick >> shift) + 1) << shift;
+            if (nextSlotTick > targetTick)
+            {
+                mCurrentTick = targetTick;
+                break;
+            }
+            mCurrentTick = nextSlotTick - 1;
+        }
+
+        ++mCurrentTick;
+
+        // Cascade from the top so timeouts moved down a level can be
+        // cascaded again (or expire) on this same tick.
+        for (unsigned level = kNumLevels - 1; level > 0; --level)
+        {
+            const uint64_t lowerTicksMask = (uint64_t(1) << (level * kSlotBits)) - 1;
+            if ((mCurrentTick & lowerTicksMask) == 0)
+            {
+                Cascade(level);
+            }
+        }
+
+        numFired += ExpireSlot(mCurrentTick & kSlotMask);
+    }
+
+    mExpiring = false;
+    mNow = aMonotonicTime;
+    return numFired;
+}
+
+TimeOffset TimingWheelTimeoutPublisherService::GetTickPeriod() const
+{
+    return mTickPeriod;
+}
+
+size_t TimingWheelTimeoutPublisherService::GetNumPendingTimeouts() const
+{
+    return mNumPending;
+}
+
+void TimingWheelTimeoutPublisherService::SetTimeout(const TimeOffset aMillisecondsFromNow, const TimeoutPublisherHandle aTimerHandle)
+{
+    DG_ASSERT(aTimerHandle >= 0);
+    const NodeIndex node = aTimerHandle + 1;
+    Unlink(node);
+    GetNode(node).mExpiryTick = GetExpiryTick(aMillisecondsFromNow);
+}
+
+void TimingWheelTimeoutPublisherService::Start(const TimeoutPublisherHandle aTimerHandle)
+{
+    DG_ASSERT(aTimerHandle >= 0);
+    const NodeIndex node = aTimerHandle + 1;
+    if (GetNode(node).mSlot == kNullNode)
+    {
+        Link(node);
+    }
+}
+
+void TimingWheelTimeoutPublisherService::Cancel(const TimeoutPublisherHandle aTimerHandle)
+{
+    DG_ASSERT(aTimerHandle >= 0);
+    Unlink(aTimerHandle + 1);
+}
+
+void TimingWheelTimeoutPublisherService::ArmMetronome(const TimeOffset aMillisecondsFromNow)
+{
+    Unlink(kMetronomeNode);
+    mNodes[kMetronomeNode].mExpiryTick = GetExpiryTick(aMillisecondsFromNow);
+    Link(kMetronomeNode);
+}
+
+void TimingWheelTimeoutPublisherService::CancelMetronome()
+{
+    Unlink(kMetronomeNode);
+}
+
+uint64_t TimingWheelTimeoutPublisherService::GetExpiryTick(TimeOffset aMillisecondsFromNow) const
+{
+    // While expiring, now is the tick being expired - so the metronome
+    // re-armed from MetronomeFired doesn't skip beats on large time jumps.
+    const TimeOffset now = mExpiring ? mCurrentTick * mTickPeriod : GetMonotonicTime();
+
+    // Round up so a timeout never fires before its deadline.
+    const uint64_t expiryTick = (now + aMillisecondsFromNow + mTickPeriod - 1) / mTickPeriod;
+    return (expiryTick > mCurrentTick) ? expiryTick : mCurrentTick + 1;
+}
+
+TimingWheelTimeoutPublisherService::TimerNode& TimingWheelTimeoutPublisherService::GetNode(NodeIndex aNode)
+{
+    if ((size_t)aNode >= mNodes.size())
+    {
+        mNodes.resize(aNode + 1);
+    }
+    return mNodes[aNode];
+}
+
+void TimingWheelTimeoutPublisherService::Link(NodeIndex aNode)
+{
+    TimerNode& node = mNodes[aNode];
+
+    // The lowest level at which the deadline and now only differ in that
+    // level's slot (or the top level for deadlines beyond the wheel's range).
+    const uint64_t differingTicks = node.mExpiryTick ^ mCurrentTick;
+    unsigned level = 0;
+    while (level < kNumLevels - 1 && (differingTicks >> ((level + 1) * kSlotBits)) != 0)
+    {
+        ++level;
+    }
+    const int32_t slot = level * kSlotsPerLevel + ((node.mExpiryTick >> (level * kSlotBits)) & kSlotMask);
+
+    node.mSlot = slot;
+    node.mPrev = kNullNode;
+    node.mNext = mSlots[slot];
+    if (node.mNext != kNullNode)
+    {
+        mNodes[node.mNext].mPrev = aNode;
+    }
+    mSlots[slot] = aNode;
+    mNumPending++;
+    mNumPendingPerLevel[level]++;
+}
+
+void TimingWheelTimeoutPublisherService::Unlink(NodeIndex aNode)
+{
+    if ((size_t)aNode >= mNodes.size() || mNodes[aNode].mSlot == kNullNode)
+    {
+        return;
+    }
+
+    TimerNode& node = mNodes[aNode];
+    if (node.mPrev != kNullNode)
+    {
+        mNodes[node.mPrev].mNext = node.mNext;
+    }
+    else
+    {
+        mSlots[node.mSlot] = node.mNext;
+    }
+    if (node.mNext != kNullNode)
+    {
+        mNodes[node.mNext].mPrev = node.mPrev;
+    }
+
+    mNumPendingPerLevel[node.mSlot / kSlotsPerLevel]--;
+    node.mSlot = kNullNode;
+    node.mPrev = kNullNode;
+    node.mNext = kNullNode;
+    mNumPending--;
+}
+
+void TimingWheelTimeoutPublisherService::Cascade(unsigned aLevel)
+{
+    const unsigned slot = aLevel * kSlotsPerLevel + ((mCurrentTick >> (aLevel * kSlotBits)) & kSlotMask);
+
+    // Detach the whole list first: deadlines beyond the wheel's range are
+    // linked right back into this slot.
+    NodeIndex nodeIdx = mSlots[slot];
+    mSlots[slot] = kNullNode;
+    while (nodeIdx != kNullNode)
+    {
+        TimerNode& node = mNodes[nodeIdx];
+        const NodeIndex nextIdx = node.mNext;
+        node.mSlot = kNullNode;
+        mNumPending--;
+        mNumPendingPerLevel[aLevel]--;
+        Link(nodeIdx);
+        nodeIdx = nextIdx;
+    }
+}
+
+size_t TimingWheelTimeoutPublisherService::ExpireSlot(unsigned aSlot)
+{
+    size_t numFired = 0;
+    while (mSlots[aSlot] != kNullNode)
+    {
+        const NodeIndex nodeIdx = mSlots[aSlot];
+        Unlink(nodeIdx);
+        DG_ASSERT(mNodes[nodeIdx].mExpiryTick <= mCurrentTick);
+
+        if (nodeIdx == kMetronomeNode)
+        {
+            // Re-arms the metronome through ArmMetronome.
+            MetronomeFired();
+        }
+        else
+        {
+            TimeoutExpired(nodeIdx - 1);
+        }
+        numFired++;
+    }
+    return numFired;
+}
+
+} // namespace DetectorGraph
@@ -0,0 +1,135 @@
+// Copyright 2017 Nest Labs, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DETECTORGRAPH_UTIL_TIMINGWHEELTIMEOUTPUBLISHERSERVICE_HPP_
+#define DETECTORGRAPH_UTIL_TIMINGWHEELTIMEOUTPUBLISHERSERVICE_HPP_
+
+#include "graph.hpp"
+#include "timeoutpublisherservice.hpp"
+
+#include <stdint.h>
+#include <vector>
+
+namespace DetectorGraph
+{
+
+/**
+ * @brief A TimeoutPublisherService that keeps all its timers in a
+ * hierarchical timing wheel.
+ *
+ * Instead of one platform timer per TimeoutPublisherHandle, all timeouts (and
+ * the metronome) are kept in a wheel driven by a single time source: the
+ * subclass only implements GetTime/GetMonotonicTime and calls AdvanceTime()
+ * with the monotonic time - e.g. from one periodic platform timer firing every
+ * GetTickPeriod() milliseconds.
+ *
+ * Scheduling and canceling a timeout are O(1) regardless of how many are
+ * pending; AdvanceTime costs amortized O(1) per elapsed tick plus O(1) per
+ * expired timeout - and skips stretches of time with nothing due.
+ *
+ * # Internals #
+ * Time is counted in ticks. The wheel has kNumLevels levels of kSlotsPerLevel
+ * slots; level `l` slots are `kSlotsPerLevel^l` ticks wide. A timeout is
+ * filed in the lowest level whose slot can tell its deadline apart from now
+ * and, whenever a level's slot comes due, its timeouts are cascaded down to
+ * the levels below. Each slot is an intrusive doubly-linked list threaded
+ * through a per-handle node array, so no allocation happens while timeouts
+ * are scheduled, canceled or expire.
+ *
+ * Deadlines are taken relative to GetMonotonicTime() and rounded up to the
+ * next tick so timeouts never fire early.
+ * Deadlines beyond the wheel's range (kSlotsPerLevel^kNumLevels ticks) wait in
+ * the top level and are cascaded again until they come within range.
+ */
+class TimingWheelTimeoutPublisherService : public TimeoutPublisherService
+{
+public:
+    static const unsigned kSlotBits = 6;
+    static const unsigned kSlotsPerLevel = 1u << kSlotBits;
+    static const unsigned kNumLevels = 6;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] arGraph The graph to which timed out TopicStates will be posted
+     * @param[in] aTickPeriodInMilliseconds The wheel's time resolution.
+     */
+    TimingWheelTimeoutPublisherService(Graph& arGraph, TimeOffset aTickPeriodInMilliseconds = 1);
+
+    /**
+     * @brief Expires all timeouts (and metronome beats) due at or before
+     * \p aMonotonicTime.
+     *
+     * \p aMonotonicTime is in the same time base as GetMonotonicTime() and
+     * must not go back. Returns the number of timeouts and metronome beats
+     * fired.
+     */
+    size_t AdvanceTime(TimeOffset aMonotonicTime);
+
+    /**
+     * @brief Returns the wheel's time resolution.
+     */
+    TimeOffset GetTickPeriod() const;
+
+    /**
+     * @brief Returns the number of pending timeouts (including the metronome).
+     */
+    size_t GetNumPendingTimeouts() const;
+
+protected:
+    virtual void SetTimeout(const TimeOffset aMillisecondsFromNow, const TimeoutPublisherHandle aTimerHandle);
+    virtual void Start(const TimeoutPublisherHandle aTimerHandle);
+    virtual void Cancel(const TimeoutPublisherHandle aTimerHandle);
+    virtual void ArmMetronome(const TimeOffset aMillisecondsFromNow);
+    virtual void CancelMetronome();
+
+private:
+    typedef int32_t NodeIndex;
+    static const NodeIndex kNullNode = -1;
+
+    // Node 0 is the metronome; handle `h` uses node `h + 1`.
+    static const NodeIndex kMetronomeNode = 0;
+
+    struct TimerNode
+    {
+        uint64_t mExpiryTick;
+        NodeIndex mPrev;
+        NodeIndex mNext;
+        // Slot list the node is linked in, or kNullNode.
+        int32_t mSlot;
+
+        TimerNode() : mExpiryTick(0), mPrev(kNullNode), mNext(kNullNode), mSlot(kNullNode) {}
+    };
+
+    uint64_t GetExpiryTick(TimeOffset aMillisecondsFromNow) const;
+    TimerNode& GetNode(NodeIndex aNode);
+    void Link(NodeIndex aNode);
+    void Unlink(NodeIndex aNode);
+    void Cascade(unsigned aLevel);
+    size_t ExpireSlot(unsigned aSlot);
+
+    const TimeOffset mTickPeriod;
+    TimeOffset mNow;
+    uint64_t mCurrentTick;
+    bool mExpiring;
+    size_t mNumPending;
+    size_t mNumPendingPerLevel[kNumLevels];
+
+    std::vector<TimerNode> mNodes;
+    NodeIndex mSlots[kNumLevels * kSlotsPerLevel];
+};
+
+} // namespace DetectorGraph
+
+#endif // DETECTORGRAPH_UTIL_TIMINGWHEELTIMEOUTPUBLISHERSERVICE_HPP_